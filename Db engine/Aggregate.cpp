@@ -0,0 +1,331 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <charconv>
+#include "aggregate.h"
+#include "storage.h"
+#include "rowview.h"
+using namespace std;
+
+static bool isNumeric(ColType type)
+{
+    return type == COL_INT || type == COL_FLOAT || type == COL_DOUBLE;
+}
+
+ColType aggregateType(const AggregateSpec& spec, const TableData& schema)
+{
+    if (spec.kind == AGG_COUNT)
+        return COL_INT;
+    ColType type = typeCode(schema.types[spec.column]);
+    if (spec.kind == AGG_AVG || (spec.kind == AGG_SUM && type != COL_INT))
+        return COL_DOUBLE;
+    return type;
+}
+
+uint64_t hashKey(const char* p, size_t n)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ n;
+    while (n >= 8)
+    {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 32;
+        p += 8;
+        n -= 8;
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    h = (h ^ w) * 0xC4CEB9FE1A85EC53ull;
+    return h ^ (h >> 29);
+}
+
+HashAggregator::HashAggregator(const TableData& schema, const vector<int>& groupColumns,
+    const vector<AggregateSpec>& aggregates)
+    : groupColumns(groupColumns), aggregates(aggregates)
+{
+    for (auto& t : schema.types)
+        types.push_back(typeCode(t));
+    slots.resize(AGG_INITIAL_SLOTS);
+
+    // Without GROUP BY there is exactly one group, even for no rows.
+    if (groupColumns.empty()) {
+        groupKeys.push_back({ hashKey("", 0), 0, 0 });
+        states.resize(aggregates.size());
+    }
+}
+
+template <class Row>
+void HashAggregator::encodeKey(Row& row)
+{
+    key.clear();
+    for (int c : groupColumns)
+    {
+        if (row.isNull(c)) {
+            key += '\0';
+            continue;
+        }
+        key += '\1';
+        if (types[c] == COL_INT) {
+            int64_t v = row.integer(c);
+            key.append((const char*)&v, sizeof v);
+        }
+        else if (isNumeric(types[c])) {
+            double v = row.real(c);
+            if (v == 0)
+                v = 0;      // -0.0 groups with 0.0
+            key.append((const char*)&v, sizeof v);
+        }
+        else {
+            string_view s = row.text(c);
+            uint32_t len = (uint32_t)s.size();
+            key.append((const char*)&len, sizeof len);
+            key.append(s.data(), s.size());
+        }
+    }
+}
+
+void HashAggregator::grow()
+{
+    vector<Slot> bigger(slots.size() * 2);
+    size_t mask = bigger.size() - 1;
+    for (size_t g = 0; g < groupKeys.size(); g++)
+    {
+        size_t i = groupKeys[g].hash & mask;
+        while (bigger[i].group)
+            i = (i + 1) & mask;
+        bigger[i] = { (uint32_t)(groupKeys[g].hash >> 32), (uint32_t)g + 1 };
+    }
+    slots.swap(bigger);
+}
+
+size_t HashAggregator::findGroup(string_view k, uint64_t hash)
+{
+    size_t mask = slots.size() - 1;
+    uint32_t tag = (uint32_t)(hash >> 32);
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        Slot& s = slots[i];
+        if (!s.group)
+            break;
+        const GroupKey& g = groupKeys[s.group - 1];
+        if (s.tag == tag && g.length == k.size() && memcmp(keys.data() + g.offset, k.data(), k.size()) == 0)
+            return s.group - 1;
+    }
+
+    // A new group; the table stays at most half full.
+    if ((groupKeys.size() + 1) * 2 > slots.size()) {
+        grow();
+        mask = slots.size() - 1;
+    }
+    size_t i = hash & mask;
+    while (slots[i].group)
+        i = (i + 1) & mask;
+    groupKeys.push_back({ hash, (uint32_t)keys.size(), (uint32_t)k.size() });
+    keys.append(k.data(), k.size());
+    slots[i] = { tag, (uint32_t)groupKeys.size() };
+    states.resize(states.size() + aggregates.size());
+    return groupKeys.size() - 1;
+}
+
+template <class Row>
+void HashAggregator::addRow(Row& row)
+{
+    size_t group = 0;
+    if (!groupColumns.empty()) {
+        encodeKey(row);
+        group = findGroup(key, hashKey(key.data(), key.size()));
+    }
+    accumulate(group, row);
+}
+
+template <class Row>
+void HashAggregator::accumulate(size_t group, Row& row)
+{
+    State* state = &states[group * aggregates.size()];
+    for (size_t a = 0; a < aggregates.size(); a++)
+    {
+        const AggregateSpec& spec = aggregates[a];
+        State& s = state[a];
+        int col = spec.column;
+        if (col == -1) {
+            s.count++;
+            continue;
+        }
+        if (row.isNull(col))
+            continue;
+
+        bool first = s.count++ == 0;
+        if (spec.kind == AGG_COUNT)
+            continue;
+        if (spec.kind == AGG_SUM || spec.kind == AGG_AVG)
+        {
+            if (types[col] == COL_INT && spec.kind == AGG_SUM)
+                s.integer += row.integer(col);
+            else
+                s.real += row.real(col);
+        }
+        else if (types[col] == COL_INT)
+        {
+            int64_t v = row.integer(col);
+            if (first || (spec.kind == AGG_MIN ? v < s.integer : v > s.integer))
+                s.integer = v;
+        }
+        else if (isNumeric(types[col]))
+        {
+            double v = row.real(col);
+            if (first || (spec.kind == AGG_MIN ? v < s.real : v > s.real))
+                s.real = v;
+        }
+        else
+        {
+            string_view v = row.text(col);
+            if (first || (spec.kind == AGG_MIN ? v < string_view(s.text) : v > string_view(s.text)))
+                s.text.assign(v.data(), v.size());
+        }
+    }
+}
+
+void HashAggregator::add(TableScanner& cursor)
+{
+    CursorRow row{ cursor };
+    const DictionarySegment* d = groupColumns.size() == 1 ? cursor.dictionary(groupColumns[0]) : nullptr;
+    if (!d || cursor.isNull(groupColumns[0])) {
+        addRow(row);
+        return;
+    }
+
+    // Grouped on one dictionary-encoded column, a row's code stands for its
+    // key, so each code of the block's dictionary is hashed only once.
+    if (d->dictionary != codeDictionary) {
+        codeDictionary = d->dictionary;
+        codeGroups.assign(d->entries, UINT32_MAX);
+    }
+    uint32_t& group = codeGroups[cursor.code(groupColumns[0])];
+    if (group == UINT32_MAX) {
+        encodeKey(row);
+        group = (uint32_t)findGroup(key, hashKey(key.data(), key.size()));
+    }
+    accumulate(group, row);
+}
+
+void HashAggregator::add(const vector<string>& row)
+{
+    TextRow text{ row };
+    addRow(text);
+}
+
+void HashAggregator::add(const JoinedRow& row)
+{
+    JoinedRow joined = row;
+    addRow(joined);
+}
+
+void HashAggregator::merge(const HashAggregator& other)
+{
+    for (size_t og = 0; og < other.groupKeys.size(); og++)
+    {
+        const GroupKey& k = other.groupKeys[og];
+        size_t group = groupColumns.empty() ? 0
+            : findGroup(string_view(other.keys).substr(k.offset, k.length), k.hash);
+
+        for (size_t a = 0; a < aggregates.size(); a++)
+        {
+            const State& from = other.states[og * aggregates.size() + a];
+            State& to = states[group * aggregates.size() + a];
+            const AggregateSpec& spec = aggregates[a];
+            if (from.count == 0)
+                continue;
+
+            bool first = to.count == 0;
+            to.count += from.count;
+            int col = spec.column;
+            if (spec.kind == AGG_COUNT)
+                continue;
+            if (spec.kind == AGG_SUM || spec.kind == AGG_AVG) {
+                to.integer += from.integer;
+                to.real += from.real;
+            }
+            else if (types[col] == COL_INT) {
+                if (first || (spec.kind == AGG_MIN ? from.integer < to.integer : from.integer > to.integer))
+                    to.integer = from.integer;
+            }
+            else if (isNumeric(types[col])) {
+                if (first || (spec.kind == AGG_MIN ? from.real < to.real : from.real > to.real))
+                    to.real = from.real;
+            }
+            else if (first || (spec.kind == AGG_MIN ? from.text < to.text : from.text > to.text))
+                to.text = from.text;
+        }
+    }
+}
+
+// Numbers print like stored values of the column: FLOAT columns in float precision.
+string HashAggregator::formatNumber(int col, double value) const
+{
+    char buf[TBL_VALUE_SCRATCH];
+    char* end = col != -1 && types[col] == COL_FLOAT
+        ? to_chars(buf, buf + sizeof buf, (float)value).ptr
+        : to_chars(buf, buf + sizeof buf, value).ptr;
+    return string(buf, end);
+}
+
+void HashAggregator::results(vector<vector<string>>& rows) const
+{
+    rows.clear();
+    rows.reserve(groupKeys.size());
+    for (size_t g = 0; g < groupKeys.size(); g++)
+    {
+        vector<string> out;
+        out.reserve(groupColumns.size() + aggregates.size());
+
+        const char* p = keys.data() + groupKeys[g].offset;
+        for (int c : groupColumns)
+        {
+            if (*p++ == '\0') {
+                out.push_back("NULL");
+                continue;
+            }
+            if (types[c] == COL_INT) {
+                int64_t v;
+                memcpy(&v, p, sizeof v);
+                p += sizeof v;
+                out.push_back(to_string(v));
+            }
+            else if (isNumeric(types[c])) {
+                double v;
+                memcpy(&v, p, sizeof v);
+                p += sizeof v;
+                out.push_back(formatNumber(c, v));
+            }
+            else {
+                uint32_t len;
+                memcpy(&len, p, sizeof len);
+                p += sizeof len;
+                out.emplace_back(p, len);
+                p += len;
+            }
+        }
+
+        for (size_t a = 0; a < aggregates.size(); a++)
+        {
+            const State& s = states[g * aggregates.size() + a];
+            const AggregateSpec& spec = aggregates[a];
+            int col = spec.column;
+            if (spec.kind == AGG_COUNT)
+                out.push_back(to_string(s.count));
+            else if (s.count == 0)
+                out.push_back("NULL");
+            else if (spec.kind == AGG_AVG)
+                out.push_back(formatNumber(col, s.real / s.count));
+            else if (types[col] == COL_INT)
+                out.push_back(to_string(s.integer));
+            else if (isNumeric(types[col]))
+                out.push_back(formatNumber(col, s.real));
+            else
+                out.push_back(s.text);
+        }
+        rows.push_back(move(out));
+    }
+}
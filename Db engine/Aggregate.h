@@ -0,0 +1,101 @@
+#pragma once
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+#include "parser.h"
+#include "tablescanner.h"
+#include "rowview.h"
+using namespace std;
+
+// Hash aggregation for SELECT with aggregate functions and GROUP BY.
+//
+// Rows are grouped on the typed values of the GROUP BY columns. Each row's
+// key is encoded into a short byte string: per column a null flag, then an
+// int64, a double or a length-prefixed string. The key is looked up in an
+// open-addressing table with linear probing. Its slots hold only part of the
+// key hash and a group number, so a probe usually touches one cache line.
+// Group keys are stored end to end in one buffer, and the aggregate states
+// of a group sit next to each other in a flat array. Numeric columns are read
+// straight from the table's binary slots, without being formatted as text.
+// Grouped on a single dictionary-encoded column (see Storage.h), a block's
+// rows are mapped to groups by their codes, and a key is only built and
+// hashed for the first row with each code.
+//
+// A parallel scan gives every morsel its own aggregator. They are merged into
+// one in table order, so groups come out in the order they are first seen.
+
+const size_t AGG_INITIAL_SLOTS = 64;
+
+struct AggregateSpec
+{
+    AggregateKind kind = AGG_COUNT;
+    int column = -1;            // -1 for COUNT(*)
+};
+
+// Hash of an encoded key, also used by the hash join.
+uint64_t hashKey(const char* p, size_t n);
+
+// The type of an aggregate's values, as ordered by ORDER BY.
+ColType aggregateType(const AggregateSpec& spec, const TableData& schema);
+
+class HashAggregator
+{
+public:
+    HashAggregator(const TableData& schema, const vector<int>& groupColumns, const vector<AggregateSpec>& aggregates);
+
+    // The current row of a cursor, a decoded row or a row of a join.
+    void add(TableScanner& cursor);
+    void add(const vector<string>& row);
+    void add(const JoinedRow& row);
+    void merge(const HashAggregator& other);
+
+    size_t groups() const { return groupKeys.size(); }
+    // One row per group: its GROUP BY values, then its aggregates, as text.
+    void results(vector<vector<string>>& rows) const;
+
+private:
+    struct Slot
+    {
+        uint32_t tag = 0;
+        uint32_t group = 0;     // group number + 1, 0 for an empty slot
+    };
+    struct GroupKey
+    {
+        uint64_t hash;
+        uint32_t offset;
+        uint32_t length;
+    };
+    struct State
+    {
+        int64_t count = 0;      // rows, or non-NULL values for column aggregates
+        int64_t integer = 0;    // SUM, MIN and MAX of INT columns
+        double real = 0;        // SUM, MIN and MAX of other numbers, AVG
+        string text;            // MIN and MAX of strings
+    };
+
+    vector<int> groupColumns;
+    vector<AggregateSpec> aggregates;
+    vector<ColType> types;      // by table column
+
+    vector<Slot> slots;
+    vector<GroupKey> groupKeys;
+    string keys;
+    vector<State> states;       // groups() x aggregates.size()
+    string key;                 // scratch
+    const char* codeDictionary = nullptr;   // the block dictionary codeGroups is for
+    vector<uint32_t> codeGroups;            // group of each code, UINT32_MAX until seen
+
+    template <class Row> void addRow(Row& row);
+    template <class Row> void accumulate(size_t group, Row& row);
+    template <class Row> void encodeKey(Row& row);
+    size_t findGroup(string_view k, uint64_t hash);
+    void grow();
+    string formatNumber(int col, double value) const;
+};
+
+#endif
@@ -0,0 +1,536 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "bplustree.h"
+#include "storage.h"
+#include "utils.h"
+using namespace std;
+
+size_t BPlusTree::leafCapacity() const
+{
+    return (pageSize - BPT_NODE_HEADER_SIZE) / (keyWidth + sizeof(uint64_t));
+}
+
+size_t BPlusTree::internalCapacity() const
+{
+    return (pageSize - BPT_NODE_HEADER_SIZE - sizeof(uint32_t)) / (keyWidth + sizeof(uint32_t));
+}
+
+bool BPlusTree::encodeKey(const string& value, string& key) const
+{
+    key.assign(keyWidth, '\0');
+    if (isNullValue(value))
+        return false;
+
+    string err;
+    if (keyType == COL_CHAR || keyType == COL_VARCHAR)
+        return encodeValue(COL_CHAR, (int)keyWidth, value, &key[0], err);
+    return encodeValue(keyType, keyLength, value, &key[0], err);
+}
+
+int BPlusTree::compare(const string& a, const string& b) const
+{
+    switch (keyType)
+    {
+    case COL_INT:
+    {
+        int32_t x, y;
+        memcpy(&x, a.data(), sizeof x);
+        memcpy(&y, b.data(), sizeof y);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    case COL_FLOAT:
+    {
+        float x, y;
+        memcpy(&x, a.data(), sizeof x);
+        memcpy(&y, b.data(), sizeof y);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    case COL_DOUBLE:
+    {
+        double x, y;
+        memcpy(&x, a.data(), sizeof x);
+        memcpy(&y, b.data(), sizeof y);
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    default:
+        return memcmp(a.data(), b.data(), keyWidth);
+    }
+}
+
+size_t BPlusTree::lowerBound(const vector<string>& keys, const string& key) const
+{
+    return lower_bound(keys.begin(), keys.end(), key,
+        [this](const string& a, const string& b) { return compare(a, b) < 0; }) - keys.begin();
+}
+
+size_t BPlusTree::upperBound(const vector<string>& keys, const string& key) const
+{
+    return upper_bound(keys.begin(), keys.end(), key,
+        [this](const string& a, const string& b) { return compare(a, b) < 0; }) - keys.begin();
+}
+
+bool BPlusTree::writeMeta()
+{
+    string page(pageSize, '\0');
+    memcpy(&page[0], BPT_MAGIC, 4);
+    memcpy(&page[4], &BPT_VERSION, 4);
+    page[8] = (char)keyType;
+    memcpy(&page[12], &keyLength, 4);
+    memcpy(&page[16], &keyWidth, 4);
+    memcpy(&page[20], &pageSize, 4);
+    memcpy(&page[24], &root, 4);
+    memcpy(&page[28], &pageCount, 4);
+    memcpy(&page[32], &entryCount, 8);
+    memcpy(&page[40], &tableBytes, 8);
+    file.seekp(0);
+    file.write(page.data(), page.size());
+    file.flush();
+    return file.good();
+}
+
+bool BPlusTree::create(const string& path, ColType type, int length)
+{
+    close();
+    file.open(path, ios::binary | ios::in | ios::out | ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    keyType = type;
+    keyLength = length;
+    if (type == COL_CHAR || type == COL_VARCHAR)
+        keyWidth = (uint32_t)max(length, 1);
+    else
+        keyWidth = (uint32_t)columnWidth(type, length);
+
+    // Wide string keys get bigger pages so a leaf still holds a useful fan-out.
+    pageSize = BPT_PAGE_SIZE;
+    while (leafCapacity() < 8)
+        pageSize *= 2;
+
+    root = 1;
+    pageCount = 2;
+    entryCount = 0;
+    tableBytes = 0;
+    Node leaf;
+    return writeMeta() && writeNode(root, leaf);
+}
+
+bool BPlusTree::open(const string& path)
+{
+    close();
+    file.open(path, ios::binary | ios::in | ios::out);
+    if (!file.is_open())
+        return false;
+
+    char meta[48];
+    if (!file.read(meta, sizeof meta) || memcmp(meta, BPT_MAGIC, 4) != 0) {
+        close();
+        return false;
+    }
+    uint32_t version;
+    memcpy(&version, meta + 4, 4);
+    if (version != BPT_VERSION) {
+        close();
+        return false;
+    }
+    keyType = (ColType)(uint8_t)meta[8];
+    memcpy(&keyLength, meta + 12, 4);
+    memcpy(&keyWidth, meta + 16, 4);
+    memcpy(&pageSize, meta + 20, 4);
+    memcpy(&root, meta + 24, 4);
+    memcpy(&pageCount, meta + 28, 4);
+    memcpy(&entryCount, meta + 32, 8);
+    memcpy(&tableBytes, meta + 40, 8);
+    return true;
+}
+
+void BPlusTree::close()
+{
+    if (file.is_open())
+        file.close();
+    file.clear();
+}
+
+void BPlusTree::setSyncedTableBytes(uint64_t bytes)
+{
+    tableBytes = bytes;
+    writeMeta();
+}
+
+bool BPlusTree::readNode(uint32_t page, Node& node)
+{
+    string buf(pageSize, '\0');
+    file.seekg((uint64_t)page * pageSize);
+    if (!file.read(&buf[0], pageSize))
+        return false;
+
+    uint32_t count;
+    node.leaf = buf[0] != 0;
+    memcpy(&count, &buf[4], 4);
+    memcpy(&node.next, &buf[8], 4);
+
+    const char* p = buf.data() + BPT_NODE_HEADER_SIZE;
+    size_t capacity = node.leaf ? leafCapacity() : internalCapacity();
+    if (count > capacity)
+        return false;
+
+    node.keys.resize(count);
+    for (uint32_t i = 0; i < count; i++)
+        node.keys[i].assign(p + (size_t)i * keyWidth, keyWidth);
+    p += capacity * keyWidth;
+
+    if (node.leaf) {
+        node.locations.resize(count);
+        memcpy(node.locations.data(), p, count * sizeof(uint64_t));
+        node.children.clear();
+    }
+    else {
+        node.children.resize(count + 1);
+        memcpy(node.children.data(), p, (count + 1) * sizeof(uint32_t));
+        node.locations.clear();
+    }
+    return true;
+}
+
+bool BPlusTree::writeNode(uint32_t page, const Node& node)
+{
+    string buf(pageSize, '\0');
+    uint32_t count = (uint32_t)node.keys.size();
+    buf[0] = node.leaf ? 1 : 0;
+    memcpy(&buf[4], &count, 4);
+    memcpy(&buf[8], &node.next, 4);
+
+    char* p = &buf[BPT_NODE_HEADER_SIZE];
+    for (uint32_t i = 0; i < count; i++)
+        memcpy(p + (size_t)i * keyWidth, node.keys[i].data(), keyWidth);
+    p += (node.leaf ? leafCapacity() : internalCapacity()) * keyWidth;
+
+    if (node.leaf)
+        memcpy(p, node.locations.data(), count * sizeof(uint64_t));
+    else
+        memcpy(p, node.children.data(), node.children.size() * sizeof(uint32_t));
+
+    file.seekp((uint64_t)page * pageSize);
+    file.write(buf.data(), buf.size());
+    return file.good();
+}
+
+uint32_t BPlusTree::allocatePage()
+{
+    return pageCount++;
+}
+
+bool BPlusTree::findLeaf(const string& key, uint32_t& page, Node& node, vector<uint32_t>* path)
+{
+    page = root;
+    while (true)
+    {
+        if (!readNode(page, node))
+            return false;
+        if (node.leaf)
+            return true;
+        if (path)
+            path->push_back(page);
+        page = node.children[upperBound(node.keys, key)];
+    }
+}
+
+bool BPlusTree::find(const string& key, uint64_t& location)
+{
+    uint32_t page;
+    Node node;
+    if (!findLeaf(key, page, node, nullptr))
+        return false;
+
+    size_t i = lowerBound(node.keys, key);
+    if (i == node.keys.size() || compare(node.keys[i], key) != 0)
+        return false;
+    location = node.locations[i];
+    return true;
+}
+
+bool BPlusTree::range(const string* lower, bool lowerInclusive, const string* upper, bool upperInclusive,
+    vector<uint64_t>& locations)
+{
+    uint32_t page = root;
+    Node node;
+    size_t i = 0;
+
+    if (lower) {
+        if (!findLeaf(*lower, page, node, nullptr))
+            return false;
+        i = lowerInclusive ? lowerBound(node.keys, *lower) : upperBound(node.keys, *lower);
+    }
+    else {
+        while (true) {
+            if (!readNode(page, node))
+                return false;
+            if (node.leaf)
+                break;
+            page = node.children[0];
+        }
+    }
+
+    while (true)
+    {
+        for (; i < node.keys.size(); i++)
+        {
+            if (upper) {
+                int c = compare(node.keys[i], *upper);
+                if (c > 0 || (c == 0 && !upperInclusive))
+                    return true;
+            }
+            locations.push_back(node.locations[i]);
+        }
+        if (node.next == 0)
+            return true;
+        if (!readNode(node.next, node))
+            return false;
+        i = 0;
+    }
+}
+
+bool BPlusTree::insert(const string& key, uint64_t location)
+{
+    vector<uint32_t> path;
+    uint32_t page;
+    Node node;
+    if (!findLeaf(key, page, node, &path))
+        return false;
+
+    size_t i = lowerBound(node.keys, key);
+    if (i < node.keys.size() && compare(node.keys[i], key) == 0)
+        return false;
+
+    node.keys.insert(node.keys.begin() + i, key);
+    node.locations.insert(node.locations.begin() + i, location);
+    entryCount++;
+
+    if (node.keys.size() <= leafCapacity())
+        return writeNode(page, node) && writeMeta();
+
+    // Split the leaf and push the separator up until a parent has room.
+    size_t mid = node.keys.size() / 2;
+    Node right;
+    right.leaf = true;
+    right.keys.assign(node.keys.begin() + mid, node.keys.end());
+    right.locations.assign(node.locations.begin() + mid, node.locations.end());
+    right.next = node.next;
+    node.keys.resize(mid);
+    node.locations.resize(mid);
+
+    uint32_t rightPage = allocatePage();
+    node.next = rightPage;
+    if (!writeNode(page, node) || !writeNode(rightPage, right))
+        return false;
+
+    string separator = right.keys[0];
+    uint32_t leftPage = page;
+
+    while (!path.empty())
+    {
+        uint32_t parentPage = path.back();
+        path.pop_back();
+        Node parent;
+        if (!readNode(parentPage, parent))
+            return false;
+
+        size_t at = upperBound(parent.keys, separator);
+        parent.keys.insert(parent.keys.begin() + at, separator);
+        parent.children.insert(parent.children.begin() + at + 1, rightPage);
+
+        if (parent.keys.size() <= internalCapacity())
+            return writeNode(parentPage, parent) && writeMeta();
+
+        size_t half = parent.keys.size() / 2;
+        Node sibling;
+        sibling.leaf = false;
+        separator = parent.keys[half];
+        sibling.keys.assign(parent.keys.begin() + half + 1, parent.keys.end());
+        sibling.children.assign(parent.children.begin() + half + 1, parent.children.end());
+        parent.keys.resize(half);
+        parent.children.resize(half + 1);
+
+        rightPage = allocatePage();
+        if (!writeNode(parentPage, parent) || !writeNode(rightPage, sibling))
+            return false;
+        leftPage = parentPage;
+    }
+
+    Node newRoot;
+    newRoot.leaf = false;
+    newRoot.keys.push_back(separator);
+    newRoot.children.push_back(leftPage);
+    newRoot.children.push_back(rightPage);
+    root = allocatePage();
+    return writeNode(root, newRoot) && writeMeta();
+}
+
+bool BPlusTree::erase(const string& key)
+{
+    uint32_t page;
+    Node node;
+    if (!findLeaf(key, page, node, nullptr))
+        return false;
+
+    size_t i = lowerBound(node.keys, key);
+    if (i == node.keys.size() || compare(node.keys[i], key) != 0)
+        return false;
+
+    node.keys.erase(node.keys.begin() + i);
+    node.locations.erase(node.locations.begin() + i);
+    entryCount--;
+    return writeNode(page, node) && writeMeta();
+}
+
+bool BPlusTree::bulkLoad(vector<pair<string, uint64_t>>& entries)
+{
+    sort(entries.begin(), entries.end(),
+        [this](const pair<string, uint64_t>& a, const pair<string, uint64_t>& b) { return compare(a.first, b.first) < 0; });
+    for (size_t i = 1; i < entries.size(); i++)
+        if (compare(entries[i - 1].first, entries[i].first) == 0)
+            return false;
+
+    pageCount = 1;
+    entryCount = entries.size();
+
+    // Leaves are packed full and written left to right so each one links to the next page.
+    vector<pair<string, uint32_t>> level;
+    size_t perLeaf = leafCapacity();
+    size_t leafCount = max((size_t)1, (entries.size() + perLeaf - 1) / perLeaf);
+    for (size_t l = 0; l < leafCount; l++)
+    {
+        Node leaf;
+        size_t begin = l * perLeaf, end = min(entries.size(), begin + perLeaf);
+        for (size_t i = begin; i < end; i++) {
+            leaf.keys.push_back(entries[i].first);
+            leaf.locations.push_back(entries[i].second);
+        }
+        uint32_t page = allocatePage();
+        leaf.next = l + 1 < leafCount ? page + 1 : 0;
+        if (!writeNode(page, leaf))
+            return false;
+        level.push_back({ leaf.keys.empty() ? string(keyWidth, '\0') : leaf.keys[0], page });
+    }
+
+    size_t fanOut = internalCapacity() + 1;
+    while (level.size() > 1)
+    {
+        vector<pair<string, uint32_t>> parents;
+        for (size_t begin = 0; begin < level.size(); begin += fanOut)
+        {
+            Node inner;
+            inner.leaf = false;
+            size_t end = min(level.size(), begin + fanOut);
+            for (size_t i = begin; i < end; i++) {
+                if (i > begin)
+                    inner.keys.push_back(level[i].first);
+                inner.children.push_back(level[i].second);
+            }
+            uint32_t page = allocatePage();
+            if (!writeNode(page, inner))
+                return false;
+            parents.push_back({ level[begin].first, page });
+        }
+        level = parents;
+    }
+
+    root = level[0].second;
+    return writeMeta();
+}
+
+string primaryIndexFile(string tableName)
+{
+    return tableName + ".pk";
+}
+
+bool rebuildPrimaryIndex(string tableName, const TableData& schema, const vector<string>& keys, const vector<uint64_t>& locations)
+{
+    if (schema.primaryKeyIndex == -1) {
+        remove(primaryIndexFile(tableName).c_str());
+        return true;
+    }
+
+    int pk = schema.primaryKeyIndex;
+    BPlusTree tree;
+    if (!tree.create(primaryIndexFile(tableName), typeCode(schema.types[pk]), schema.lengths[pk]))
+        return false;
+
+    vector<pair<string, uint64_t>> entries;
+    entries.reserve(keys.size());
+    string key;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (!tree.encodeKey(keys[i], key))
+            return false;
+        entries.push_back({ key, locations[i] });
+    }
+
+    if (!tree.bulkLoad(entries))
+        return false;
+    tree.setSyncedTableBytes(tableFileSize(tableName));
+    return true;
+}
+
+bool openPrimaryIndex(string tableName, const TableData& schema, BPlusTree& tree)
+{
+    if (schema.primaryKeyIndex == -1)
+        return false;
+
+    // The index remembers the table size it was synced with; anything else
+    // (a missing file, a table written by an older build) triggers a rebuild.
+    string path = primaryIndexFile(tableName);
+    if (tree.open(path) && tree.syncedTableBytes() == tableFileSize(tableName))
+        return true;
+
+    vector<string> keys;
+    vector<uint64_t> locations;
+    if (!readTableColumn(tableName, schema, schema.primaryKeyIndex, keys, &locations))
+        return false;
+
+    if (!rebuildPrimaryIndex(tableName, schema, keys, locations)) {
+        setColor(12); cout << "Error: Cannot build PRIMARY KEY index for table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+    return tree.open(path);
+}
+
+bool lookupPrimaryKey(string tableName, const TableData& schema, const string& op, string value,
+    vector<uint64_t>& locations)
+{
+    if (schema.primaryKeyIndex == -1 || op == "!=" || op.empty())
+        return false;
+
+    if (value.size() >= 2 && (value.front() == '\'' || value.front() == '"') && value.back() == value.front())
+        value = value.substr(1, value.size() - 2);
+
+    BPlusTree tree;
+    string key;
+    if (!openPrimaryIndex(tableName, schema, tree) || !tree.encodeKey(value, key))
+        return false;
+
+    bool ok;
+    if (op == "=") {
+        uint64_t location;
+        ok = true;
+        if (tree.find(key, location))
+            locations.push_back(location);
+    }
+    else if (op == "<")
+        ok = tree.range(nullptr, false, &key, false, locations);
+    else if (op == "<=")
+        ok = tree.range(nullptr, false, &key, true, locations);
+    else if (op == ">")
+        ok = tree.range(&key, false, nullptr, false, locations);
+    else if (op == ">=")
+        ok = tree.range(&key, true, nullptr, false, locations);
+    else
+        return false;
+
+    sort(locations.begin(), locations.end());
+    return ok;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+using namespace std;
+
+// Paged B+tree stored in <table>.pk, keyed on the primary key column and
+// mapping each key to the row location (see makeRowLocation) of its row.
+//
+//   page 0 : "ITBT", version, key type, key length, key width, page size,
+//            root page, page count, entry count, table file size at last sync
+//   nodes  : leaf flag, key count, next leaf, then keys followed by either
+//            row locations (leaf) or child page numbers (internal)
+//
+// Keys are stored fixed-width: INT/FLOAT/DOUBLE in their binary form and
+// CHAR/VARCHAR zero padded to the declared length, so string keys compare
+// with memcmp. Erased keys leave leaves underfull; they are not rebalanced.
+
+const char BPT_MAGIC[4] = { 'I', 'T', 'B', 'T' };
+const uint32_t BPT_VERSION = 1;
+const uint32_t BPT_PAGE_SIZE = 4096;
+const size_t BPT_NODE_HEADER_SIZE = 16;
+
+class BPlusTree
+{
+public:
+    bool create(const string& path, ColType keyType, int keyLength);
+    bool open(const string& path);
+    void close();
+
+    bool encodeKey(const string& value, string& key) const;
+
+    bool find(const string& key, uint64_t& location);
+    bool range(const string* lower, bool lowerInclusive, const string* upper, bool upperInclusive,
+        vector<uint64_t>& locations);
+    bool insert(const string& key, uint64_t location);
+    bool erase(const string& key);
+    bool bulkLoad(vector<pair<string, uint64_t>>& entries);
+
+    uint64_t entries() const { return entryCount; }
+    uint64_t syncedTableBytes() const { return tableBytes; }
+    void setSyncedTableBytes(uint64_t bytes);
+
+private:
+    struct Node
+    {
+        bool leaf = true;
+        uint32_t next = 0;
+        vector<string> keys;
+        vector<uint64_t> locations;
+        vector<uint32_t> children;
+    };
+
+    fstream file;
+    ColType keyType = COL_INT;
+    int keyLength = -1;
+    uint32_t keyWidth = 0;
+    uint32_t pageSize = BPT_PAGE_SIZE;
+    uint32_t root = 0;
+    uint32_t pageCount = 0;
+    uint64_t entryCount = 0;
+    uint64_t tableBytes = 0;
+
+    size_t leafCapacity() const;
+    size_t internalCapacity() const;
+    int compare(const string& a, const string& b) const;
+    size_t lowerBound(const vector<string>& keys, const string& key) const;
+    size_t upperBound(const vector<string>& keys, const string& key) const;
+
+    bool readNode(uint32_t page, Node& node);
+    bool writeNode(uint32_t page, const Node& node);
+    uint32_t allocatePage();
+    bool writeMeta();
+    bool findLeaf(const string& key, uint32_t& page, Node& node, vector<uint32_t>* path);
+};
+
+string primaryIndexFile(string tableName);
+bool openPrimaryIndex(string tableName, const TableData& schema, BPlusTree& tree);
+bool rebuildPrimaryIndex(string tableName, const TableData& schema, const vector<string>& keys,
+    const vector<uint64_t>& locations);
+bool lookupPrimaryKey(string tableName, const TableData& schema, const string& op, string value,
+    vector<uint64_t>& locations);
+
+#endif
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include "batch.h"
+#include "utils.h"
+using namespace std;
+
+static map<string, vector<double>> latencies;   // statement kind -> seconds
+
+bool StatementReader::next(string& statement)
+{
+    statement.clear();
+    string line;
+    char quote = 0;
+    while (true)
+    {
+        if (hasPending) {
+            line.swap(pending);
+            hasPending = false;
+        }
+        else if (!getline(in, line))
+            break;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        // Continuation lines are joined with a single space, as if the
+        // statement had been typed on one line.
+        if (!statement.empty() && !quote) {
+            line.erase(0, line.find_first_not_of(" \t"));
+            statement += ' ';
+        }
+
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            char c = line[i];
+            if (quote) {
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '\'' || c == '"')
+                quote = c;
+            else if (c == '-' && i + 1 < line.size() && line[i + 1] == '-')
+                break;
+            else if (c == ';') {
+                statement = trim(statement);
+                if (statement.empty())
+                    continue;
+                pending = line.substr(i + 1);
+                hasPending = true;
+                return true;
+            }
+            statement += c;
+        }
+    }
+    statement = trim(statement);
+    return !statement.empty();
+}
+
+static string statementKind(const string& statement)
+{
+    istringstream words(statement);
+    string kind, second;
+    words >> kind;
+    toUpper(kind);
+    if (kind == "CREATE" || kind == "DROP")
+    {
+        words >> second;
+        toUpper(second);
+        kind += " " + second;
+    }
+    return kind;
+}
+
+void recordStatement(const string& statement, double seconds)
+{
+    latencies[statementKind(statement)].push_back(seconds);
+}
+
+static double percentile(const vector<double>& sorted, double p)
+{
+    size_t at = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[at];
+}
+
+void printBatchSummary(double seconds)
+{
+    size_t total = 0;
+    for (auto& kv : latencies)
+        total += kv.second.size();
+
+    setColor(14);
+    cout << "\n" << total << " statement(s) in " << fixed << setprecision(3) << seconds << " s";
+    if (seconds > 0)
+        cout << " (" << setprecision(0) << total / seconds << " statements/s)";
+    cout << "\n\n";
+    cout << left << setw(14) << "Statement" << right << setw(10) << "Count" << setw(12) << "Total ms"
+        << setw(10) << "Avg ms" << setw(10) << "p50 ms" << setw(10) << "p99 ms" << setw(10) << "Max ms" << "\n";
+    setColor(15);
+
+    for (auto& kv : latencies)
+    {
+        vector<double>& times = kv.second;
+        sort(times.begin(), times.end());
+        double sum = 0;
+        for (double t : times)
+            sum += t;
+        cout << left << setw(14) << kv.first << right << setw(10) << times.size() << setprecision(3)
+            << setw(12) << sum * 1e3 << setw(10) << sum * 1e3 / times.size()
+            << setw(10) << percentile(times, 0.50) * 1e3 << setw(10) << percentile(times, 0.99) * 1e3
+            << setw(10) << times.back() * 1e3 << "\n";
+    }
+    cout.unsetf(ios::fixed);
+    cout << setprecision(6);
+}
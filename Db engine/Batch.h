@@ -0,0 +1,35 @@
+#pragma once
+#ifndef BATCH_H
+#define BATCH_H
+#include <string>
+#include <istream>
+using namespace std;
+
+// Batch mode: "Db engine.exe --file script.sql" runs a script, and
+// "Db engine.exe --batch" runs one read from stdin, without prompts.
+//
+// Statements end at a ';' outside quotes and may span several lines; text
+// after "--" outside quotes is a comment. A statement left unterminated at
+// the end of the input still runs.
+//
+// Commits are not forced to disk statement by statement. The log and every
+// table written are forced to disk together at each COMMIT and at the end of
+// the script (see WriteAheadLog.h). On exit the run prints its throughput and,
+// per statement kind, the statement count and latency percentiles.
+
+class StatementReader
+{
+public:
+    explicit StatementReader(istream& in) : in(in) {}
+    bool next(string& statement);
+
+private:
+    istream& in;
+    string pending;         // rest of the line after the last ';'
+    bool hasPending = false;
+};
+
+void recordStatement(const string& statement, double seconds);
+void printBatchSummary(double seconds);
+
+#endif
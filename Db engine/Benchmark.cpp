@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <functional>
+#include "benchmark.h"
+#include "filterkernels.h"
+#include "predicate.h"
+#include "storage.h"
+#include "utils.h"
+using namespace std;
+
+static const char* opNames[] = { "=", "!=", "<", "<=", ">", ">=" };
+
+// Best of a few runs, in million rows per second.
+static double measure(uint64_t rows, const function<void()>& run)
+{
+    double best = 0;
+    for (int rep = 0; rep < 3; rep++)
+    {
+        auto start = chrono::steady_clock::now();
+        run();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (seconds > 0)
+            best = max(best, rows / seconds / 1e6);
+    }
+    return best;
+}
+
+// Counting matches keeps the compiler from discarding the kernels' work.
+static uint64_t countSelected(const vector<uint64_t>& selection)
+{
+    uint64_t n = 0;
+    for (uint64_t w : selection)
+        while (w) {
+            w &= w - 1;
+            n++;
+        }
+    return n;
+}
+
+template <typename T>
+static void benchmarkType(const string& typeName, const vector<T>& values, T literal,
+    void (*kernel)(const T*, uint32_t, CompareOp, T, uint64_t*, SimdLevel))
+{
+    // Per-row baseline: the comparator Predicate uses when testing one slot at a time.
+    TableData schema;
+    schema.columns = { "v" };
+    schema.types = { typeName };
+    schema.lengths = { -1 };
+    schema.notNull = { false };
+
+    uint64_t rows = values.size();
+    vector<uint64_t> selection(selectionWords(TBL_BLOCK_ROWS));
+    volatile uint64_t sink = 0;
+
+    for (int op = CMP_EQ; op <= CMP_GE; op++)
+    {
+        cout << left << setw(8) << typeName << setw(4) << opNames[op] << right;
+
+        Predicate p;
+        string err;
+        p.compile(schema, "v", opNames[op], to_string(literal), err);
+        cout << setw(12) << fixed << setprecision(0) << measure(rows, [&]() {
+            uint64_t n = 0;
+            for (uint64_t r = 0; r < rows; r++)
+                n += p.matchesSlot((const char*)&values[r], sizeof(T));
+            sink = sink + n;
+        });
+
+        for (int level = SIMD_SCALAR; level <= SIMD_AVX2; level++)
+        {
+            if (level > detectSimdLevel()) {
+                cout << setw(12) << "-";
+                continue;
+            }
+            cout << setw(12) << measure(rows, [&]() {
+                for (uint64_t at = 0; at < rows; at += TBL_BLOCK_ROWS)
+                {
+                    uint32_t count = (uint32_t)min<uint64_t>(TBL_BLOCK_ROWS, rows - at);
+                    kernel(&values[at], count, (CompareOp)op, literal, selection.data(), (SimdLevel)level);
+                    sink = sink + countSelected(selection);
+                }
+            });
+        }
+        cout << "\n";
+    }
+}
+
+bool executeBenchmark(const BenchmarkQuery& q)
+{
+    uint64_t rows = q.rows;
+    mt19937 rng(42);
+    uniform_int_distribution<int32_t> ints(0, 999999);
+    vector<int32_t> intValues(rows);
+    vector<float> floatValues(rows);
+    vector<double> doubleValues(rows);
+    for (uint64_t r = 0; r < rows; r++)
+    {
+        intValues[r] = ints(rng);
+        floatValues[r] = intValues[r] / 8.0f;
+        doubleValues[r] = intValues[r] / 8.0;
+    }
+
+    setColor(14);
+    cout << "Filter kernels over " << rows << " rows, million rows/second (active: "
+        << simdLevelName(activeSimdLevel()) << ")\n";
+    cout << left << setw(12) << "column" << right << setw(12) << "per-row" << setw(12) << "scalar"
+        << setw(12) << "SSE4.2" << setw(12) << "AVX2" << "\n";
+    setColor(15);
+
+    benchmarkType<int32_t>("INT", intValues, 500000, filterInt32);
+    benchmarkType<float>("FLOAT", floatValues, 62500.0f, filterFloat);
+    benchmarkType<double>("DOUBLE", doubleValues, 62500.0, filterDouble);
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+#include <string>
+#include "parser.h"
+using namespace std;
+
+// BENCHMARK FILTER [rows]
+//   Runs every filter kernel available on this CPU over random INT, FLOAT
+//   and DOUBLE columns and prints throughput in million rows per second,
+//   next to the per-row comparator the kernels replace.
+bool executeBenchmark(const BenchmarkQuery& q);
+
+#endif
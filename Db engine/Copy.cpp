@@ -0,0 +1,331 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "copy.h"
+#include "insert.h"
+#include "storage.h"
+#include "index.h"
+#include "threadpool.h"
+#include "writeaheadlog.h"
+#include "utils.h"
+using namespace std;
+
+// First problem found in a run of rows; the one with the lowest line wins.
+struct CopyError
+{
+    uint64_t line = UINT64_MAX;
+    string message;
+
+    void note(uint64_t at, const string& what)
+    {
+        if (at < line) {
+            line = at;
+            message = what;
+        }
+    }
+};
+
+// Where a run of TBL_BLOCK_ROWS rows starts in the file.
+struct RowRun
+{
+    size_t offset = 0;
+    uint64_t line = 0;
+};
+
+static bool isBlankLine(string_view line)
+{
+    for (char c : line)
+        if (c != ' ' && c != '\t' && c != '\r')
+            return false;
+    return true;
+}
+
+// Calls visit(start, end) for each line that starts in [from, to).
+static void forEachLine(const string& data, size_t bodyStart, size_t from, size_t to,
+    const function<void(size_t, size_t)>& visit)
+{
+    size_t start = from;
+    if (from > bodyStart) {
+        const char* nl = (const char*)memchr(data.data() + from - 1, '\n', data.size() - from + 1);
+        start = nl ? nl - data.data() + 1 : data.size();
+    }
+    while (start < to && start < data.size())
+    {
+        const char* nl = (const char*)memchr(data.data() + start, '\n', data.size() - start);
+        size_t end = nl ? nl - data.data() : data.size();
+        visit(start, end);
+        start = end + 1;
+    }
+}
+
+static void splitCsvLine(string_view line, vector<string>& fields)
+{
+    fields.clear();
+    size_t i = 0;
+    while (true)
+    {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t'))
+            i++;
+        string field;
+        if (i < line.size() && line[i] == '"')
+        {
+            for (i++; i < line.size(); i++)
+            {
+                if (line[i] == '"') {
+                    if (i + 1 < line.size() && line[i + 1] == '"')
+                        i++;
+                    else {
+                        i++;
+                        break;
+                    }
+                }
+                field += line[i];
+            }
+            while (i < line.size() && line[i] != ',')
+                i++;
+        }
+        else
+        {
+            size_t end = line.find(',', i);
+            if (end == string_view::npos)
+                end = line.size();
+            size_t last = end;
+            while (last > i && isspace((unsigned char)line[last - 1]))
+                last--;
+            field.assign(line.data() + i, last - i);
+            i = end;
+        }
+        fields.push_back(move(field));
+        if (i >= line.size())
+            break;
+        i++;
+    }
+}
+
+bool copyTableFromFile(string tableName, string path, bool header, uint64_t& loaded)
+{
+    TableData schema;
+    if (!readTableSchema(tableName, schema) || schema.columns.empty()) {
+        setColor(12); cout << "Error: Cannot read table structure.\n"; setColor(15);
+        return false;
+    }
+
+    string data;
+    {
+        ifstream in(path, ios::binary | ios::ate);
+        if (!in.is_open()) {
+            setColor(12); cout << "Error: Cannot open file '" << path << "'.\n"; setColor(15);
+            return false;
+        }
+        data.resize((size_t)in.tellg());
+        in.seekg(0);
+        if (!in.read(&data[0], data.size())) {
+            setColor(12); cout << "Error: Cannot read file '" << path << "'.\n"; setColor(15);
+            return false;
+        }
+    }
+
+    size_t bodyStart = 0;
+    if (header) {
+        size_t nl = data.find('\n');
+        bodyStart = nl == string::npos ? data.size() : nl + 1;
+    }
+
+    // Count the rows (non-blank lines) of each chunk, then note where every
+    // run of TBL_BLOCK_ROWS rows starts, so each block can be parsed on its own.
+    ThreadPool& pool = ThreadPool::instance();
+    size_t chunkCount = max<size_t>(1, pool.size() * 4);
+    size_t chunkBytes = (data.size() - bodyStart + chunkCount - 1) / chunkCount + 1;
+    vector<uint64_t> chunkRows(chunkCount), chunkLines(chunkCount);
+    auto chunkFrom = [&](size_t k) { return min(data.size(), bodyStart + k * chunkBytes); };
+
+    pool.parallelFor(chunkCount, [&](size_t k) {
+        forEachLine(data, bodyStart, chunkFrom(k), chunkFrom(k + 1), [&](size_t s, size_t e) {
+            chunkLines[k]++;
+            if (!isBlankLine(string_view(data).substr(s, e - s)))
+                chunkRows[k]++;
+        });
+    });
+
+    uint64_t totalRows = 0;
+    vector<uint64_t> rowBase(chunkCount), lineBase(chunkCount);
+    for (size_t k = 0, line = header ? 2 : 1; k < chunkCount; k++)
+    {
+        rowBase[k] = totalRows;
+        lineBase[k] = line;
+        totalRows += chunkRows[k];
+        line += chunkLines[k];
+    }
+
+    size_t blockCount = (size_t)((totalRows + TBL_BLOCK_ROWS - 1) / TBL_BLOCK_ROWS);
+    vector<RowRun> runs(blockCount);
+    pool.parallelFor(chunkCount, [&](size_t k) {
+        uint64_t row = rowBase[k], line = lineBase[k];
+        forEachLine(data, bodyStart, chunkFrom(k), chunkFrom(k + 1), [&](size_t s, size_t e) {
+            if (!isBlankLine(string_view(data).substr(s, e - s))) {
+                if (row % TBL_BLOCK_ROWS == 0)
+                    runs[(size_t)(row / TBL_BLOCK_ROWS)] = { s, line };
+                row++;
+            }
+            line++;
+        });
+    });
+
+    // The new rows go after a copy of the current file.
+    string tablePath = tableFile(tableName);
+    string temp = tablePath + ".tmp";
+    ofstream out(temp, ios::binary | ios::trunc);
+    {
+        ifstream current(tablePath, ios::binary);
+        if (!out.is_open() || !current.is_open() || !(out << current.rdbuf())) {
+            out.close();
+            remove(temp.c_str());
+            setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
+            return false;
+        }
+    }
+
+    // Existing keys seed the shards that catch duplicate primary keys.
+    int pk = schema.primaryKeyIndex;
+    size_t shardCount = pool.size();
+    vector<unordered_set<string>> shards(shardCount);
+    hash<string> keyHash;
+    if (pk != -1)
+    {
+        vector<string> existing;
+        if (!readTableColumn(tableName, schema, pk, existing)) {
+            out.close();
+            remove(temp.c_str());
+            setColor(12); cout << "Error: Cannot read table '" << tableName << "'.\n"; setColor(15);
+            return false;
+        }
+        for (auto& shard : shards)
+            shard.reserve((size_t)((existing.size() + totalRows) / shardCount + 1));
+        for (auto& key : existing)
+            shards[keyHash(key) % shardCount].insert(key);
+    }
+
+    size_t wave = max<size_t>(1, pool.size() * COPY_BLOCKS_PER_THREAD);
+    vector<string> blocks(wave);
+    vector<CopyError> errors(wave);
+    // Per block and shard: the keys and the lines they came from.
+    vector<vector<vector<pair<string, uint64_t>>>> keys(wave, vector<vector<pair<string, uint64_t>>>(shardCount));
+    CopyError failure;
+
+    for (size_t first = 0; first < blockCount && failure.line == UINT64_MAX; first += wave)
+    {
+        size_t count = min(wave, blockCount - first);
+        pool.parallelFor(count, [&](size_t w) {
+            size_t b = first + w;
+            uint32_t rowCount = (uint32_t)min<uint64_t>(TBL_BLOCK_ROWS, totalRows - (uint64_t)b * TBL_BLOCK_ROWS);
+            vector<vector<string>> rows;
+            rows.reserve(rowCount);
+            for (auto& shard : keys[w])
+                shard.clear();
+            blocks[w].clear();
+            errors[w] = CopyError();
+
+            size_t at = runs[b].offset;
+            uint64_t line = runs[b].line;
+            vector<string> fields;
+            string err;
+            while (rows.size() < rowCount && at < data.size())
+            {
+                const char* nl = (const char*)memchr(data.data() + at, '\n', data.size() - at);
+                size_t end = nl ? nl - data.data() : data.size();
+                string_view text = string_view(data).substr(at, end - at);
+                at = end + 1;
+                if (isBlankLine(text)) {
+                    line++;
+                    continue;
+                }
+                if (!text.empty() && text.back() == '\r')
+                    text.remove_suffix(1);
+
+                splitCsvLine(text, fields);
+                if (fields.size() != schema.columns.size()) {
+                    errors[w].note(line, "Expected " + to_string(schema.columns.size()) + " values, got " + to_string(fields.size()));
+                    return;
+                }
+                if (!prepareInsertRow(schema, fields, err)) {
+                    errors[w].note(line, err);
+                    return;
+                }
+                if (pk != -1) {
+                    string key = trim(fields[pk]);
+                    size_t shard = keyHash(key) % shardCount;
+                    keys[w][shard].push_back({ move(key), line });
+                }
+                rows.push_back(move(fields));
+                line++;
+            }
+            if (!appendTableBlock(schema, rows, 0, rows.size(), blocks[w], err))
+                errors[w].note(runs[b].line, err);
+        });
+
+        vector<CopyError> duplicates(shardCount);
+        if (pk != -1)
+            pool.parallelFor(shardCount, [&](size_t s) {
+                for (size_t w = 0; w < count; w++)
+                    for (auto& entry : keys[w][s])
+                        if (!shards[s].insert(entry.first).second)
+                            duplicates[s].note(entry.second, "Duplicate PRIMARY KEY value '" + entry.first
+                                + "' in column '" + schema.columns[pk] + "'");
+            });
+
+        for (size_t w = 0; w < count; w++)
+            failure.note(errors[w].line, errors[w].message);
+        for (auto& d : duplicates)
+            failure.note(d.line, d.message);
+        if (failure.line != UINT64_MAX)
+            break;
+        for (size_t w = 0; w < count; w++)
+            out.write(blocks[w].data(), blocks[w].size());
+    }
+
+    // The copy holds every change logged so far.
+    uint64_t lsn = walLastLsn();
+    out.seekp(TBL_LSN_OFFSET);
+    out.write((const char*)&lsn, sizeof lsn);
+    out.flush();
+    bool written = out.good();
+    out.close();
+
+    if (failure.line != UINT64_MAX) {
+        remove(temp.c_str());
+        setColor(12); cout << "Error: " << failure.message << " (line " << failure.line << ").\n"; setColor(15);
+        return false;
+    }
+    if (!written || !syncFile(temp) || !replaceFile(temp, tablePath)) {
+        remove(temp.c_str());
+        setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+
+    loaded = totalRows;
+    return rebuildIndexesFromFile(tableName, schema);
+}
+
+bool executeCopy(const CopyQuery& q)
+{
+    const string& tableName = q.tableName;
+    if (!tableExists(tableName)) {
+        reportMissingTable(tableName);
+        return false;
+    }
+
+    uint64_t loaded = 0;
+    if (!copyTableFromFile(tableName, q.path, q.header, loaded))
+        return false;
+    setColor(10);
+    cout << loaded << " row(s) copied into table '" << tableName << "'.\n";
+    setColor(15);
+    return true;
+}
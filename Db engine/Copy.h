@@ -0,0 +1,32 @@
+#pragma once
+#ifndef COPY_H
+#define COPY_H
+#include <string>
+#include <cstdint>
+#include "parser.h"
+using namespace std;
+
+// COPY table_name FROM 'file.csv' [HEADER]
+//
+// Bulk loads comma-separated rows, one per line, into an existing table.
+// Fields are trimmed, may be enclosed in double quotes ("" for a quote) and
+// follow INSERT's rules: an empty field takes the column's default and NULL
+// is a null value. HEADER skips the first line.
+//
+// The file is cut into runs of TBL_BLOCK_ROWS rows that are parsed, checked
+// against the table's constraints and encoded into blocks on the thread pool,
+// COPY_BLOCKS_PER_THREAD at a time. Primary keys are checked for duplicates in
+// hash sets sharded by key hash, one shard per thread, so no set is shared.
+// The blocks are then written in one sequential pass to a copy of the table
+// file that replaces it, so a failed load leaves the table untouched, and the
+// table's indexes are rebuilt.
+//
+// COPY does not go through the write-ahead log: like VACUUM, the new file is
+// on disk before it is renamed over the old one.
+
+const size_t COPY_BLOCKS_PER_THREAD = 2;
+
+bool copyTableFromFile(string tableName, string path, bool header, uint64_t& loaded);
+bool executeCopy(const CopyQuery& q);
+
+#endif
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "create.h"
+#include "storage.h"
 #include <string>
 #include<vector>
 #include <fstream>
@@ -9,10 +10,7 @@
 using namespace std;
 
 
-
-struct ColumnDef { string name; string type; int length; bool isPK; bool isNN; };
-
-static bool writeEmptyTableFile(string& tableName, vector<ColumnDef>& cols)
+static bool writeEmptyTableFile(const string& tableName, const vector<ColumnDef>& cols)
 {
 
     TableData t;
@@ -25,13 +23,12 @@ static bool writeEmptyTableFile(string& tableName, vector<ColumnDef>& cols)
         if (cols[i].isPK) t.primaryKeyIndex = (int)i;
     }
 
-    return writeTable(tableName, t);
+    return saveTable(tableName, t);
 }
 
-bool createTable(string name, vector<ColumnDef> cols)
+bool createTable(string name, const vector<ColumnDef>& cols)
 {
-    ifstream check(name + ".csv");
-    if (check.good()) {
+    if (tableExists(name)) {
         setColor(12); cout << "Error: Table already exists.\n"; setColor(15);
         return false;
     }
@@ -61,136 +58,26 @@ bool createTable(string name, vector<ColumnDef> cols)
     return ok;
 }
 
-void parseCreateQuery(string cmd)
+bool executeCreate(const CreateQuery& cq)
 {
-    if (!trim(cmd).empty() && trim(cmd).back() == ';')
-        cmd.pop_back();
-    string upper = cmd;
-
-    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-
-    upper = trim_Middle(upper);
-    if (upper.find("CREATE TABLE") != 0) {
-        setColor(12); cout << "Error: Command must start with CREATE TABLE.\n"; setColor(15);
-        return;
-    }
-
-    int tablePos = upper.find("TABLE") + 5;
-    int parenPos = upper.find("(");
-
-    if (parenPos == string::npos) {
-        setColor(12); cout << "Error: Missing '('.\n"; setColor(15);
-        return;
-    }
-    string tableName = trim(cmd.substr(tablePos, parenPos - tablePos));
-
-    if (tableName.empty()) {
-        setColor(12); cout << "Error: Missing table name.\n"; setColor(15);
-        return;
-    }
-    int endParen = upper.rfind(")");
-    if (endParen == string::npos || endParen < parenPos) {
-        setColor(12); cout << "Error: Missing ')'.\n"; setColor(15);
-        return;
-    }
-
-    string colSection = trim(cmd.substr(parenPos + 1, endParen - parenPos - 1));
-    if (colSection.empty()) {
-        setColor(12); cout << "Error: No columns defined.\n"; setColor(15);
-        return;
-    }
-
-    vector<string> rawCols = split(colSection, ',');
-    vector<ColumnDef> cols;
-
-    for (string colDef : rawCols)
+    vector<string> allowed = { "INT","FLOAT","DOUBLE","VARCHAR","CHAR" };
+    for (auto& c : cq.columns)
     {
-        colDef = trim(colDef);
-
-        stringstream ss(colDef);
-        string colName;
-        if (!(ss >> colName)) {
-            setColor(12); cout << "Error: Invalid column definition: " << colDef << "\n"; setColor(15);
-            return;
-        }
-
-        string typeToken;
-        if (!(ss >> typeToken)) {
-            setColor(12); cout << "Error: Missing type for column: " << colName << "\n"; setColor(15);
-            return;
-        }
-
-
-        string baseType = typeToken;
-        int length = -1;
-        int p = typeToken.find('(');
-        if (p != string::npos) {
-            int q = typeToken.find(')', p);
-            if (q == string::npos) {
-                setColor(12); cout << "Error: Invalid type size syntax in " << typeToken << "\n"; setColor(15);
-                return;
-            }
-            string lenStr = typeToken.substr(p + 1, q - p - 1);
-            try { length = stoi(lenStr); }
-            catch (...) {
-                setColor(12); cout << "Error: Invalid length '" << lenStr << "'\n"; setColor(15); return;
-            }
-            baseType = typeToken.substr(0, p);
+        if (find(allowed.begin(), allowed.end(), c.type) == allowed.end()) {
+            setColor(12); cout << "Error: Unsupported type '" << c.type << "'\n"; setColor(15);
+            return false;
         }
 
-        for (auto& ch : baseType) ch = toupper(ch);
-
-
-        vector<string> allowed = { "INT","FLOAT","DOUBLE","VARCHAR","CHAR" };
-        if (find(allowed.begin(), allowed.end(), baseType) == allowed.end()) {
-            setColor(12); cout << "Error: Unsupported type '" << baseType << "'\n"; setColor(15);
-            return;
+        if ((c.type == "VARCHAR" || c.type == "CHAR") && c.length == -1) {
+            setColor(12); cout << "Error: Type '" << c.type << "' requires size, e.g. " << c.type << "(20)\n"; setColor(15);
+            return false;
         }
 
-        if ((baseType == "VARCHAR" || baseType == "CHAR") && length == -1) {
-            setColor(12); cout << "Error: Type '" << baseType << "' requires size, e.g. " << baseType << "(20)\n"; setColor(15);
-            return;
+        if ((c.type == "VARCHAR" || c.type == "CHAR") && (c.length < 1 || c.length > TBL_MAX_STRING_LENGTH)) {
+            setColor(12); cout << "Error: Size of '" << c.type << "' must be between 1 and " << TBL_MAX_STRING_LENGTH << "\n"; setColor(15);
+            return false;
         }
-
-
-        bool isPK = false, isNN = false;
-        string token;
-        while (ss >> token)
-        {
-            string up = token;
-            transform(up.begin(), up.end(), up.begin(), ::toupper);
-            if (up == "PRIMARY") {
-
-                string next;
-                if (ss >> next) {
-                    string upn = next; transform(upn.begin(), upn.end(), upn.begin(), ::toupper);
-                    if (upn == "KEY") isPK = true;
-                    else {
-                        setColor(12); cout << "Error: Expected KEY after PRIMARY.\n"; setColor(15); return;
-                    }
-                }
-                else {
-                    setColor(12); cout << "Error: Expected KEY after PRIMARY.\n"; setColor(15); return;
-                }
-            }
-            else if (up == "NOT") {
-
-                string next; if (ss >> next) {
-                    string upn = next; transform(upn.begin(), upn.end(), upn.begin(), ::toupper);
-                    if (upn == "NULL") isNN = true;
-                    else { setColor(12); cout << "Error: Expected NULL after NOT.\n"; setColor(15); return; }
-                }
-                else { setColor(12); cout << "Error: Expected NULL after NOT.\n"; setColor(15); return; }
-            }
-            else {
-
-                setColor(12); cout << "Warning: Unknown token '" << token << "' in column def\n"; setColor(15);
-            }
-        }
-
-        cols.push_back({ colName, baseType, length, isPK, isNN });
     }
 
-    vector<ColumnDef> coldefs = cols;
-    createTable(tableName, coldefs);
+    return createTable(cq.tableName, cq.columns);
 }
@@ -3,13 +3,14 @@
 #define CREATE_H
 #include <string>
 #include "utils.h"
+#include "parser.h"
 
 using namespace std;
 
 
-bool createTable(string name, vector<Column> cols);
+bool createTable(string name, const vector<ColumnDef>& cols);
 
-void parseCreateQuery(string cmd);
+bool executeCreate(const CreateQuery& cq);
 
 
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <iostream>
 #include <string>
+#include <fstream>
+#include <chrono>
 #include "utils.h"
 #include "helper.h"
 #include "create.h"
@@ -8,6 +10,18 @@
 #include "insert.h" 
 #include "delete.h"
 #include "drop.h"
+#include "storage.h"
+#include "index.h"
+#include "settings.h"
+#include "benchmark.h"
+#include "writeaheadlog.h"
+#include "vacuum.h"
+#include "statistics.h"
+#include "batch.h"
+#include "copy.h"
+#include "lexer.h"
+#include "parser.h"
+#include "prepare.h"
 using namespace std;
 
 void printPrompt()
@@ -17,67 +31,182 @@ void printPrompt()
     setColor(15);
 }
 
-int main()
+// Every statement but EXIT and HELP goes through the parser and its
+// statement cache (see Parser.h).
+static void runStatement(const string& cmd)
 {
-    setColor(10);
-    cout << "Welcome to ITI-SQL Database Engine\n";
-    cout << "Type 'HELP' for a list of commands.\n\n";
-    setColor(15);
-
-    while (true)
+    string err;
+    shared_ptr<const Statement> stmt = parseStatement(cmd, err);
+    if (!stmt)
     {
-        string cmd;
-        printPrompt();
-        getline(cin, cmd);
+        setColor(12);
+        cout << "Error: " << err << ".\n";
+        setColor(15);
+        return;
+    }
 
-        if (cmd.empty())
-            continue;
+    switch (stmt->kind)
+    {
+    case STMT_SELECT: executeSelect(stmt->select); break;
+    case STMT_INSERT: executeInsert(stmt->insert); break;
+    case STMT_UPDATE: executeUpdate(stmt->update); break;
+    case STMT_DELETE: executeDelete(stmt->remove); break;
+    case STMT_CREATE_TABLE: executeCreate(stmt->create); invalidatePreparedPlans(); break;
+    case STMT_DROP_TABLE: executeDrop(stmt->drop); invalidatePreparedPlans(); break;
+    case STMT_PREPARE: prepareStatement(stmt->prepare); break;
+    case STMT_EXECUTE: executePrepared(stmt->execute); break;
+    case STMT_DEALLOCATE: deallocatePrepared(stmt->deallocate); break;
+    case STMT_CREATE_INDEX: executeCreateIndex(stmt->createIndex); invalidatePreparedPlans(); break;
+    case STMT_DROP_INDEX: executeDropIndex(stmt->dropIndex); invalidatePreparedPlans(); break;
+    case STMT_COPY: executeCopy(stmt->copy); break;
+    case STMT_VACUUM: executeVacuum(stmt->vacuum); break;
+    case STMT_CONVERT: executeConvert(stmt->convert); invalidatePreparedPlans(); break;
+    case STMT_COMMIT: executeCommit(); break;
+    case STMT_CHECKPOINT: executeCheckpoint(); break;
+    case STMT_SET: executeSet(stmt->set); break;
+    case STMT_BENCHMARK: executeBenchmark(stmt->benchmark); break;
+    case STMT_ANALYZE: executeAnalyze(stmt->analyze); invalidatePreparedPlans(); break;
+    }
+}
 
-        string upper = cmd;
-        toUpper(upper);
+// Runs one statement; returns false for EXIT.
+static bool runCommand(const string& cmd)
+{
+    // The first word picks the handler.
+    Lexer lexer(cmd);
+    Token first;
+    string err;
+    if (!lexer.next(first, err))
+    {
+        setColor(12);
+        cout << "Error: " << err << ".\n";
+        setColor(15);
+        return true;
+    }
+    string verb = upperWord(first.text);
+    static const char* statements[] = { "SELECT", "INSERT", "UPDATE", "DELETE", "CREATE", "DROP", "PREPARE",
+        "EXECUTE", "DEALLOCATE", "COPY", "VACUUM", "CONVERT", "COMMIT", "CHECKPOINT", "SET", "BENCHMARK",
+        "ANALYZE" };
+    bool parsed = false;
+    for (const char* s : statements)
+        if (verb == s)
+            parsed = true;
 
-		upper = trim_Middle(upper);
+    if (verb == "EXIT" || verb == "QUIT")
+    {
+        return false;
+    }
+    else if (verb == "HELP")
+    {
+        printHelp();
+    }
+    else if (parsed)
+    {
+        runStatement(cmd);
+    }
+    else
+    {
+        setColor(12);
+        cout << "Unknown command. Type 'HELP' for available commands.\n";
+        setColor(15);
+    }
 
+    if (!compactSparseTables() || !checkpointIfLogFull())
+    {
+        setColor(12);
+        cout << "Error: Some tables could not be written to disk.\n";
+        setColor(15);
+    }
+    return true;
+}
 
-        if (upper == "EXIT" || upper == "QUIT")
-        {
-            break;
-        }
-        else if (upper == "HELP")
-        {
-            printHelp();
-        }
-        else if (upper.find("CREATE TABLE") == 0)
-        {
-            parseCreateQuery(cmd);
-        }
-        else if (upper.find("SELECT") == 0)
-        {
-            parseSelect(cmd);
-        }
-        else if (upper.find("INSERT") == 0)
-        {
-            handleInsert(cmd);
+int main(int argc, char* argv[])
+{
+    // "--file script.sql" runs a script and "--batch" one read from stdin,
+    // without prompts (see Batch.h).
+    string scriptPath;
+    bool batch = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--file" && i + 1 < argc) {
+            scriptPath = argv[++i];
+            batch = true;
         }
-        else if (upper.find("UPDATE") == 0)
-        {
-            handleUpdate(cmd);
+        else if (arg == "--batch")
+            batch = true;
+        else {
+            setColor(12); cout << "Error: Unknown option '" << arg << "'. Use: --file script.sql | --batch\n"; setColor(15);
+            return 1;
         }
-        else if (upper.find("DELETE") == 0)
-        {
-            parseDeleteQuery(cmd);
+    }
+
+    ifstream script;
+    if (!scriptPath.empty()) {
+        script.open(scriptPath);
+        if (!script) {
+            setColor(12); cout << "Error: Cannot open script '" << scriptPath << "'.\n"; setColor(15);
+            return 1;
         }
-        else if (upper.find("DROP TABLE") == 0)
+    }
+
+    if (!batch)
+    {
+        setColor(10);
+        cout << "Welcome to ITI-SQL Database Engine\n";
+        cout << "Type 'HELP' for a list of commands.\n\n";
+        setColor(15);
+    }
+
+    // Bring tables up to date with changes logged before an unclean exit.
+    if (!recoverDatabase())
+        return 1;
+
+    auto start = chrono::steady_clock::now();
+    if (batch)
+    {
+        // Logged changes reach the disk at COMMIT and at the end of the script.
+        setWalDeferredCommits(true);
+        StatementReader reader(scriptPath.empty() ? cin : script);
+        string cmd;
+        while (reader.next(cmd))
         {
-            parseDrop(cmd);
+            auto began = chrono::steady_clock::now();
+            if (!runCommand(cmd))
+                break;
+            recordStatement(cmd, chrono::duration<double>(chrono::steady_clock::now() - began).count());
         }
-        else
+    }
+    else
+    {
+        while (true)
         {
-            setColor(12);
-            cout << "Unknown command. Type 'HELP' for available commands.\n";
-            setColor(15);
+            string cmd;
+            printPrompt();
+            if (!getline(cin, cmd))
+                break;
+
+            if (cmd.empty())
+                continue;
+
+            if (!runCommand(cmd))
+                break;
         }
     }
 
+    // Force tables that changed since the last checkpoint to disk and empty the log.
+    if (!checkpointDatabase())
+    {
+        setColor(12);
+        cout << "Error: Some tables could not be written to disk.\n";
+        setColor(15);
+        closeDatabase();
+        return 1;
+    }
+    closeDatabase();
+
+    if (batch)
+        printBatchSummary(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
     return 0;
 }
\ No newline at end of file
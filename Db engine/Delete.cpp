@@ -6,146 +6,147 @@
 #include <map>
 #include "utils.h"
 #include "delete.h"
-
-void parseDeleteQuery(string cmd)
+#include "storage.h"
+#include "index.h"
+#include "tablescanner.h"
+#include "parallelscan.h"
+#include "filter.h"
+#include "writeaheadlog.h"
+#include "vacuum.h"
+#include "parser.h"
+
+// Every row goes at once: the live rows are counted from the block headers
+// and the table is rewritten as its header alone.
+static int deleteAllRows(const DeletePlan& plan)
 {
-    if (!trim(cmd).empty() && trim(cmd).back() == ';')
-        cmd.pop_back();
-
-    cmd = trim(cmd);
-    string upper = cmd;
-    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-
-	upper = trim_Middle(upper);
-    if (upper.find("DELETE") != 0)
+    const string& tableName = plan.tableName;
+    vector<TableBlock> blocks;
+    if (!readBlockDirectory(tableName, plan.schema, blocks))
     {
         setColor(12);
-        cout << "Error: Command must start with DELETE.\n";
+        cout << "Error: Unable to read table structure.\n";
         setColor(15);
-        return;
+        return -1;
     }
+    uint64_t deletedCount = 0;
+    for (auto& b : blocks)
+        deletedCount += b.rowCount - b.deadRows;
+    if (deletedCount == 0)
+        return 0;
 
-    int fromPos = upper.find("FROM");
-    if (fromPos == string::npos)
+    TableData empty = plan.schema;
+    empty.rows.clear();
+    if (!walLogDelete(tableName, {}, true))
+        return -1;
+    if (!saveTable(tableName, empty))
     {
         setColor(12);
-        cout << "Error: Missing FROM clause.\n";
+        cout << "Error: Unable to write to table file.\n";
         setColor(15);
-        return;
+        return -1;
     }
+    return (int)deletedCount;
+}
 
-    int wherePos = upper.find("WHERE");
-    string tableName;
-    string whereClause = "";
-
-    if (wherePos != string::npos)
-    {
-        tableName = trim(cmd.substr(fromPos + 4, wherePos - fromPos - 4));
-        whereClause = trim(cmd.substr(wherePos + 5));
-    }
-    else
-    {
-        tableName = trim(cmd.substr(fromPos + 4));
+static int deleteMatchingRows(const DeletePlan& plan)
+{
+    const string& tableName = plan.tableName;
+    const TableData& schema = plan.schema;
+    const WhereClause& where = plan.where;
+
+    // A condition with an indexed comparison is answered by the index, otherwise
+    // by a scan of the mapped file. Only the matching rows are read, to take
+    // them out of the indexes, and then marked deleted in place.
+    vector<uint64_t> locations;
+    vector<vector<string>> matched;
+    if (!fetchWhereRows(tableName, schema, where, locations, matched))
+    {
+        TableScanner scan;
+        if (!scan.open(tableName))
+            return -1;
+        vector<vector<uint64_t>> found(scan.morsels(SCAN_MORSEL_ROWS).size());
+        parallelScan(scan, &where.filter,
+            [&](TableScanner& cursor, size_t m) {
+                while (cursor.next())
+                    found[m].push_back(cursor.location());
+            },
+            [&](size_t m) {
+                locations.insert(locations.end(), found[m].begin(), found[m].end());
+                vector<uint64_t>().swap(found[m]);
+            });
+        scan.close();
+
+        if (!locations.empty() && !readRowsAt(tableName, schema, locations, matched))
+        {
+            setColor(12);
+            cout << "Error: Cannot read rows of table '" << tableName << "'.\n";
+            setColor(15);
+            return -1;
+        }
     }
 
-    int deleteEnd = fromPos;
-    string betweenDeleteFrom = trim(cmd.substr(6, deleteEnd - 6));
-    if (betweenDeleteFrom == "*")
-    {
-    }
-    else if (!betweenDeleteFrom.empty())
+    if (locations.empty())
+        return 0;
+
+    if (!walLogDelete(tableName, locations, false))
+        return -1;
+    if (!deleteRowsAt(tableName, schema, locations))
     {
         setColor(12);
-        cout << "Error: Invalid DELETE syntax. Use 'DELETE FROM table' or 'DELETE * FROM table'.\n";
+        cout << "Error: Unable to write to table file.\n";
         setColor(15);
-        return;
+        return -1;
     }
-
-    if (tableName.empty())
+    bool durable = stampTableLsn(tableName, walLastLsn());
+    indexDeletedRows(tableName, schema, locations, matched);
+    noteDeletedRows(tableName);
+    if (!durable)
     {
         setColor(12);
-        cout << "Error: Missing table name.\n";
+        cout << "Error: Cannot force table '" << tableName << "' to disk.\n";
         setColor(15);
-        return;
+        return -1;
     }
-
-    deleteFromTable(tableName, whereClause);
+    return (int)locations.size();
 }
 
-bool deleteFromTable(string tableName, string whereClause)
+bool planDelete(const DeleteQuery& dq, DeletePlan& plan)
 {
-    TableData tableData = readTable(tableName);
-    if (tableData.columns.empty())
+    plan = DeletePlan();
+    plan.tableName = dq.tableName;
+    if (!readTableSchema(dq.tableName, plan.schema))
     {
-        setColor(12);
-        cout << "Error: Unable to read table structure.\n";
-        setColor(15);
+        reportMissingTable(dq.tableName);
         return false;
     }
 
-    ifstream inFile(tableName + ".csv");
-    if (!inFile.good())
+    string err;
+    plan.hasWhere = dq.hasWhere;
+    if (dq.hasWhere && !planWhere(dq.tableName, plan.schema, dq.where, plan.where, err))
     {
         setColor(12);
-        cout << "Error: Table '" << tableName << "' not found.\n";
+        cout << "Error: " << err << " in WHERE clause.\n";
         setColor(15);
         return false;
     }
+    return true;
+}
 
-    vector<string> lines;
-    string line;
-
-    getline(inFile, line);
-    lines.push_back(line);
-
-    int deletedCount = 0;
-    int totalRows = 0;
-    bool deleteAll = whereClause.empty();
-
-    while (getline(inFile, line))
-    {
-        line = trim(line);
-        if (line.empty())
-            continue;
-
-        totalRows++;
-        bool shouldDelete = deleteAll;
-
-        if (!deleteAll)
-        {
-            vector<string> values = split(line, ',');
-            map<string, string> row;
-
-            for (size_t i = 0; i < tableData.columns.size() && i < values.size(); i++)
-                row[tableData.columns[i]] = trim(values[i]);
-
-            shouldDelete = evaluateCondition(row, whereClause, tableData.columns);
-        }
-
-        if (shouldDelete)
-            deletedCount++;
-        else
-            lines.push_back(line);
-    }
-
-    inFile.close();
-
-    ofstream outFile(tableName + ".csv", ios::trunc);
-    if (!outFile.good())
+bool runDelete(DeletePlan& plan)
+{
+    string err;
+    if (plan.hasWhere && !bindWhere(plan.schema, plan.where, err))
     {
         setColor(12);
-        cout << "Error: Unable to write to table file.\n";
+        cout << "Error: " << err << " in WHERE clause.\n";
         setColor(15);
         return false;
     }
 
-    for (size_t i = 0; i < lines.size(); i++)
-    {
-        outFile << lines[i];
-        if (i < lines.size() - 1)
-            outFile << "\n";
-    }
-    outFile.close();
+    const string& tableName = plan.tableName;
+    int deletedCount = plan.hasWhere ? deleteMatchingRows(plan) : deleteAllRows(plan);
+    if (deletedCount < 0)
+        return false;
 
     if (deletedCount == 0)
     {
@@ -163,75 +164,8 @@ bool deleteFromTable(string tableName, string whereClause)
     return true;
 }
 
-bool evaluateCondition(const map<string, string>& row, const string& condition, const vector<string>& columns)
+bool executeDelete(const DeleteQuery& dq)
 {
-    string cond = trim(condition);
-
-    string ops[] = { ">=", "<=", "!=", "=", ">", "<" };
-    string foundOp = "";
-    size_t opPos = string::npos;
-
-    for (const string& op : ops)
-    {
-        size_t pos = cond.find(op);
-        if (pos != string::npos)
-        {
-            foundOp = op;
-            opPos = pos;
-            break;
-        }
-    }
-
-    if (opPos == string::npos)
-    {
-        setColor(12);
-        cout << "Error: Invalid WHERE condition format.\n";
-        setColor(15);
-        return false;
-    }
-
-    string colName = trim(cond.substr(0, opPos));
-    string value = trim(cond.substr(opPos + foundOp.length()));
-
-    if (!value.empty() && (value.front() == '\'' || value.front() == '"'))
-        value = value.substr(1);
-    if (!value.empty() && (value.back() == '\'' || value.back() == '"'))
-        value.pop_back();
-
-    if (row.find(colName) == row.end())
-    {
-        setColor(12);
-        cout << "Warning: Column '" << colName << "' not found in table.\n";
-        setColor(15);
-        return false;
-    }
-
-    string rowValue = row.at(colName);
-
-    if (foundOp == "=")
-        return rowValue == value;
-    else if (foundOp == "!=")
-        return rowValue != value;
-    else if (foundOp == ">")
-    {
-        try { return stod(rowValue) > stod(value); }
-        catch (...) { return rowValue > value; }
-    }
-    else if (foundOp == "<")
-    {
-        try { return stod(rowValue) < stod(value); }
-        catch (...) { return rowValue < value; }
-    }
-    else if (foundOp == ">=")
-    {
-        try { return stod(rowValue) >= stod(value); }
-        catch (...) { return rowValue >= value; }
-    }
-    else if (foundOp == "<=")
-    {
-        try { return stod(rowValue) <= stod(value); }
-        catch (...) { return rowValue >= value; }
-    }
-
-    return true;
+    DeletePlan plan;
+    return planDelete(dq, plan) && runDelete(plan);
 }
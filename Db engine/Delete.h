@@ -1,8 +1,19 @@
 #pragma once
 #include <string>
-#include <map>
+#include "utils.h"
+#include "parser.h"
+#include "filter.h"
 
-void parseDeleteQuery(string cmd);
-bool deleteFromTable(string tableName, string whereClause);
-bool evaluateCondition(const map<string, string>& row, const string& condition, const vector<string>& columns);
+// A DELETE with its table, condition and index access resolved, so it can
+// run again with other WHERE values (see Prepare.h).
+struct DeletePlan
+{
+    string tableName;
+    TableData schema;
+    bool hasWhere = false;
+    WhereClause where;
+};
 
+bool planDelete(const DeleteQuery& dq, DeletePlan& plan);
+bool runDelete(DeletePlan& plan);
+bool executeDelete(const DeleteQuery& dq);
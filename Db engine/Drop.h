@@ -1,4 +1,5 @@
 #pragma once
 #include <string>
+#include "parser.h"
 
-void parseDrop(std::string cmd);
\ No newline at end of file
+bool executeDrop(const DropQuery& dq);
@@ -0,0 +1,284 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "filter.h"
+#include "filterkernels.h"
+#include "rowview.h"
+#include "update.h"
+using namespace std;
+
+static string negateOperator(const string& op)
+{
+    static const char* pairs[][2] = { { "=", "!=" }, { "!=", "=" }, { "<", ">=" }, { "<=", ">" }, { ">", "<=" }, { ">=", "<" } };
+    for (auto& p : pairs)
+        if (op == p[0])
+            return p[1];
+    return op;
+}
+
+bool Filter::prepare(const TableData& schema, const Condition& cond, const ColumnResolver& resolve, string& err)
+{
+    nodes.clear();
+    if (build(schema, cond, false, resolve, err) == -1) {
+        nodes.clear();
+        return false;
+    }
+    return true;
+}
+
+int Filter::build(const TableData& schema, const Condition& cond, bool negate, const ColumnResolver& resolve, string& err)
+{
+    if (cond.kind == COND_NOT)
+        return build(schema, cond.operands[0], !negate, resolve, err);
+
+    int node = (int)nodes.size();
+    nodes.emplace_back();
+    if (cond.kind == COND_COMPARE)
+    {
+        int col = resolve(cond.column, err);
+        if (col == -1 || !nodes[node].compare.prepare(schema, col, negate ? negateOperator(cond.op) : cond.op, err))
+            return -1;
+        nodes[node].leaf = cond.leaf;
+        return node;
+    }
+
+    // De Morgan: a negated AND is an OR of negated operands, and the other
+    // way round. Operands of the same kind, as NOT can leave, are merged.
+    FilterNodeKind kind = (cond.kind == COND_AND) != negate ? FILTER_AND : FILTER_OR;
+    nodes[node].kind = kind;
+    for (auto& operand : cond.operands)
+    {
+        int o = build(schema, operand, negate, resolve, err);
+        if (o == -1)
+            return -1;
+        if (nodes[o].kind == kind) {
+            vector<int> inner = nodes[o].operands;
+            nodes[node].operands.insert(nodes[node].operands.end(), inner.begin(), inner.end());
+        }
+        else
+            nodes[node].operands.push_back(o);
+    }
+    return node;
+}
+
+// Bottom-up: a comparison is estimated from the column's statistics or else
+// guessed from its operator and column, an AND or OR from its operands once
+// they are put in the order they will run in.
+void Filter::estimate(const TableData& schema, int node)
+{
+    Node& n = nodes[node];
+    if (n.kind == FILTER_COMPARE)
+    {
+        int col = n.compare.column();
+        ColType type = typeCode(schema.types[col]);
+        n.cost = type == COL_CHAR || type == COL_VARCHAR ? 4 : 1;
+        if (stats && stats->columns.size() == schema.columns.size()) {
+            n.selectivity = estimateSelectivity(*stats, schema, n.compare);
+            return;
+        }
+        switch (n.compare.op())
+        {
+        case CMP_EQ: n.selectivity = col == schema.primaryKeyIndex ? 0.001 : 0.1; break;
+        case CMP_NE: n.selectivity = 0.9; break;
+        default: n.selectivity = 0.33; break;
+        }
+        return;
+    }
+
+    for (int o : n.operands)
+        estimate(schema, o);
+
+    // An AND wants the operand that removes the most rows per unit of work
+    // first, an OR the one that settles the most rows per unit of work.
+    bool isAnd = n.kind == FILTER_AND;
+    auto rank = [&](int o) {
+        double settles = isAnd ? 1 - nodes[o].selectivity : nodes[o].selectivity;
+        return settles > 0 ? nodes[o].cost / settles : 1e300;
+    };
+    vector<int> operands = n.operands;
+    stable_sort(operands.begin(), operands.end(), [&](int a, int b) { return rank(a) < rank(b); });
+    n.operands = operands;
+
+    double reaching = 1;    // fraction of rows still undecided
+    n.cost = 0;
+    for (int o : n.operands) {
+        n.cost += reaching * nodes[o].cost;
+        reaching *= isAnd ? nodes[o].selectivity : 1 - nodes[o].selectivity;
+    }
+    n.selectivity = isAnd ? reaching : 1 - reaching;
+}
+
+bool Filter::bind(const TableData& schema, const vector<string>& literals, string& err)
+{
+    for (auto& n : nodes)
+        if (n.kind == FILTER_COMPARE && !n.compare.bind(schema, literals[n.leaf], err))
+            return false;
+    if (!nodes.empty())
+        estimate(schema, 0);
+    return true;
+}
+
+double Filter::selectivity(size_t leaf) const
+{
+    for (auto& n : nodes)
+        if (n.kind == FILTER_COMPARE && n.leaf == leaf)
+            return n.selectivity;
+    return 1;
+}
+
+void Filter::filterBlock(const vector<const char*>& segments, const vector<size_t>& widths,
+    const vector<uint32_t>& encodings, uint32_t slots, uint32_t begin, uint32_t end,
+    uint64_t* selection) const
+{
+    filterNode(0, segments, widths, encodings, slots, begin, end, selection);
+}
+
+void Filter::filterNode(int node, const vector<const char*>& segments, const vector<size_t>& widths,
+    const vector<uint32_t>& encodings, uint32_t slots, uint32_t begin, uint32_t end,
+    uint64_t* selection) const
+{
+    const Node& n = nodes[node];
+    if (n.kind == FILTER_COMPARE) {
+        int col = n.compare.column();
+        n.compare.filterSegment(segments[col], slots, widths[col], encodings[col], begin, end, selection);
+        return;
+    }
+
+    size_t words = selectionWords(end - begin);
+    uint64_t lastWord = (end - begin) % 64 ? (1ull << ((end - begin) % 64)) - 1 : ~0ull;
+    vector<uint64_t> operand(words);
+    bool isAnd = n.kind == FILTER_AND;
+    for (size_t i = 0; i < n.operands.size(); i++)
+    {
+        if (i == 0) {
+            filterNode(n.operands[0], segments, widths, encodings, slots, begin, end, selection);
+            continue;
+        }
+
+        // Stop once the block is decided: no rows left for an AND, all in for an OR.
+        bool decided = true;
+        for (size_t w = 0; w < words && decided; w++)
+        {
+            uint64_t full = w + 1 == words ? lastWord : ~0ull;
+            decided = isAnd ? selection[w] == 0 : (selection[w] & full) == full;
+        }
+        if (decided)
+            return;
+
+        filterNode(n.operands[i], segments, widths, encodings, slots, begin, end, operand.data());
+        for (size_t w = 0; w < words; w++)
+            selection[w] = isAnd ? selection[w] & operand[w] : selection[w] | operand[w];
+    }
+}
+
+bool Filter::mayMatchNode(const char* zoneMap, int node) const
+{
+    const Node& n = nodes[node];
+    if (n.kind == FILTER_COMPARE)
+        return n.compare.mayMatch(readZone(zoneMap, n.compare.column()));
+    for (int o : n.operands)
+        if (mayMatchNode(zoneMap, o) == (n.kind == FILTER_OR))
+            return n.kind == FILTER_OR;
+    return n.kind == FILTER_AND;
+}
+
+void conditionValues(const Condition& cond, vector<string>& values)
+{
+    if (cond.kind == COND_COMPARE) {
+        if (values.size() <= cond.leaf)
+            values.resize(cond.leaf + 1);
+        values[cond.leaf] = cond.value;
+        return;
+    }
+    for (auto& o : cond.operands)
+        conditionValues(o, values);
+}
+
+bool planWhere(const string& tableName, const TableData& schema, const Condition& cond, WhereClause& where, string& err)
+{
+    ColumnResolver resolve = [&](const string& column, string& e) {
+        int col = getColumnIndex(schema, column);
+        if (col == -1)
+            e = "Column '" + column + "' not found";
+        return col;
+    };
+    return planWhere(tableName, schema, cond, resolve, where, err);
+}
+
+bool planWhere(const string& tableName, const TableData& schema, const Condition& cond, const ColumnResolver& resolve,
+    WhereClause& where, string& err)
+{
+    where = WhereClause();
+    if (!where.filter.prepare(schema, cond, resolve, err))
+        return false;
+    where.filter.setStatistics(tableStats(tableName));
+    conditionValues(cond, where.values);
+
+    // Every matching row satisfies each top-level comparison of an AND, so
+    // any of them can pick the rows; equality is tried first.
+    vector<const Condition*> conjuncts;
+    if (cond.kind == COND_COMPARE)
+        conjuncts.push_back(&cond);
+    else if (cond.kind == COND_AND)
+        for (auto& o : cond.operands)
+            if (o.kind == COND_COMPARE)
+                conjuncts.push_back(&o);
+    stable_sort(conjuncts.begin(), conjuncts.end(),
+        [](const Condition* a, const Condition* b) { return a->op == "=" && b->op != "="; });
+    for (const Condition* c : conjuncts)
+    {
+        IndexCandidate candidate;
+        if (chooseIndexAccess(tableName, schema, resolve(c->column, err), c->op, candidate.access)) {
+            candidate.op = c->op;
+            candidate.leaf = c->leaf;
+            where.candidates.push_back(candidate);
+        }
+    }
+    return true;
+}
+
+bool bindWhere(const TableData& schema, WhereClause& where, string& err)
+{
+    if (!where.filter.bind(schema, where.values, err))
+        return false;
+    where.chosen = where.candidates.empty() ? -1 : 0;
+    if (!where.filter.analyzed())
+        return true;
+
+    where.chosen = -1;
+    for (size_t i = 0; i < where.candidates.size(); i++)
+    {
+        double s = where.filter.selectivity(where.candidates[i].leaf);
+        if (s <= INDEX_MAX_SELECTIVITY
+            && (where.chosen == -1 || s < where.filter.selectivity(where.candidates[where.chosen].leaf)))
+            where.chosen = (int)i;
+    }
+    return true;
+}
+
+bool fetchWhereRows(const string& tableName, const TableData& schema, const WhereClause& where,
+    vector<uint64_t>& locations, vector<vector<string>>& rows)
+{
+    if (where.chosen == -1)
+        return false;
+    const IndexCandidate& index = where.candidates[where.chosen];
+    if (!fetchIndexedRows(tableName, schema, index.access, index.op, where.values[index.leaf], locations, rows))
+        return false;
+
+    // The index answers one comparison; the rest of the condition is checked here.
+    size_t kept = 0;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        if (!where.filter.matches(TextRow{ rows[i] }))
+            continue;
+        if (kept != i) {
+            locations[kept] = locations[i];
+            rows[kept] = move(rows[i]);
+        }
+        kept++;
+    }
+    locations.resize(kept);
+    rows.resize(kept);
+    return true;
+}
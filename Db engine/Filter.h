@@ -0,0 +1,142 @@
+#pragma once
+#ifndef FILTER_H
+#define FILTER_H
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+#include "parser.h"
+#include "predicate.h"
+#include "index.h"
+#include "statistics.h"
+using namespace std;
+
+// A WHERE condition compiled against a table schema: a tree of AND and OR
+// nodes over compiled comparisons (see Predicate.h). NOT is pushed down to
+// the comparisons and folded into their operators, so NOT (a < 1 OR b = 2)
+// runs as a >= 1 AND b != 2; since a comparison with a NULL cell is false
+// either way, this matches SQL's three-valued logic.
+//
+// The operands of each AND and OR are ordered by estimated selectivity and
+// cost: an AND runs first the tests that are cheap and reject many rows, an
+// OR those that are cheap and accept many. Selectivity is estimated when the
+// literals are bound, from the table's statistics if it was analyzed (see
+// Statistics.h) and otherwise from the operator and whether the column is
+// the primary key; cost comes from the column type. Rows are tested
+// with short-circuit evaluation. Mapped blocks are filtered a column segment
+// at a time into selection bitmaps that AND and OR combine word by word; an
+// AND stops as soon as no row of the block is left, an OR once every row is.
+
+enum FilterNodeKind : uint8_t
+{
+    FILTER_COMPARE,
+    FILTER_AND,
+    FILTER_OR
+};
+
+// Resolves a column of a condition to its index; -1 with err set if unknown.
+typedef function<int(const string& column, string& err)> ColumnResolver;
+
+class Filter
+{
+public:
+    bool prepare(const TableData& schema, const Condition& cond, const ColumnResolver& resolve, string& err);
+    // Statistics of the table the schema describes, for bind()'s estimates.
+    void setStatistics(shared_ptr<const TableStats> s) { stats = move(s); }
+    // literals[i] is the value of comparison i (Condition::leaf).
+    bool bind(const TableData& schema, const vector<string>& literals, string& err);
+    bool empty() const { return nodes.empty(); }
+
+    // Whether the estimates below come from statistics rather than guesses.
+    bool analyzed() const { return stats != nullptr; }
+    // Estimated fraction of rows that pass, after bind().
+    double selectivity() const { return nodes.empty() ? 1 : nodes[0].selectivity; }
+    // The same for comparison leaf alone.
+    double selectivity(size_t leaf) const;
+
+    // A row with a text(col) accessor (see RowView.h).
+    template <class Row>
+    bool matches(const Row& row) const { return nodes.empty() || matchNode(row, 0); }
+
+    // Rows [begin, end) of a block laid out for slots rows, given its column
+    // segments and their encodings: sets bit r - begin of selection for each
+    // matching row r. begin must be a multiple of 64.
+    void filterBlock(const vector<const char*>& segments, const vector<size_t>& widths,
+        const vector<uint32_t>& encodings, uint32_t slots,
+        uint32_t begin, uint32_t end, uint64_t* selection) const;
+    // False when no row of a block with this zone map can match (see Storage.h).
+    bool mayMatch(const char* zoneMap) const { return nodes.empty() || mayMatchNode(zoneMap, 0); }
+
+private:
+    struct Node
+    {
+        FilterNodeKind kind = FILTER_COMPARE;
+        Predicate compare;
+        size_t leaf = 0;
+        vector<int> operands;
+        double selectivity = 1;     // estimated fraction of rows that pass
+        double cost = 1;            // estimated work per row tested
+    };
+    vector<Node> nodes;             // nodes[0] is the root
+    shared_ptr<const TableStats> stats;
+
+    int build(const TableData& schema, const Condition& cond, bool negate, const ColumnResolver& resolve, string& err);
+    void estimate(const TableData& schema, int node);
+
+    template <class Row>
+    bool matchNode(const Row& row, int node) const
+    {
+        const Node& n = nodes[node];
+        if (n.kind == FILTER_COMPARE)
+            return n.compare.matches(row.text(n.compare.column()));
+        for (int o : n.operands)
+            if (matchNode(row, o) == (n.kind == FILTER_OR))
+                return n.kind == FILTER_OR;
+        return n.kind == FILTER_AND;
+    }
+    bool mayMatchNode(const char* zoneMap, int node) const;
+    void filterNode(int node, const vector<const char*>& segments, const vector<size_t>& widths,
+        const vector<uint32_t>& encodings, uint32_t slots,
+        uint32_t begin, uint32_t end, uint64_t* selection) const;
+};
+
+// With statistics, an index is only used when the comparison it answers is
+// estimated to pass at most this fraction of the table; past that, fetching
+// the rows one by one costs more than a parallel scan.
+const double INDEX_MAX_SELECTIVITY = 0.05;
+
+// A top-level comparison of a WHERE clause that an index can answer.
+struct IndexCandidate
+{
+    IndexAccess access;
+    string op;
+    size_t leaf = 0;
+};
+
+// The WHERE clause of a statement on one table: its filter, the value of
+// each comparison, and the comparisons an index can answer. bindWhere()
+// picks the one to use: the first, equality before ranges, for a table
+// without statistics, otherwise the most selective one if it is selective
+// enough.
+struct WhereClause
+{
+    Filter filter;
+    vector<string> values;      // by Condition::leaf; EXECUTE binds parameters here
+    vector<IndexCandidate> candidates;
+    int chosen = -1;            // candidate bindWhere() picked, -1 for a scan
+};
+
+// The values of the comparisons of a condition, by Condition::leaf.
+void conditionValues(const Condition& cond, vector<string>& values);
+bool planWhere(const string& tableName, const TableData& schema, const Condition& cond, WhereClause& where, string& err);
+bool planWhere(const string& tableName, const TableData& schema, const Condition& cond, const ColumnResolver& resolve,
+    WhereClause& where, string& err);
+bool bindWhere(const TableData& schema, WhereClause& where, string& err);
+// Rows matching the clause, found through its index; false when they have
+// to be found by a scan instead.
+bool fetchWhereRows(const string& tableName, const TableData& schema, const WhereClause& where,
+    vector<uint64_t>& locations, vector<vector<string>>& rows);
+
+#endif
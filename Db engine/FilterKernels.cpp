@@ -0,0 +1,302 @@
+#include <cstring>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "filterkernels.h"
+using namespace std;
+
+// MSVC accepts any intrinsic in any function; GCC and Clang need the target
+// enabled per function so the rest of the file still runs on older CPUs.
+#ifdef _MSC_VER
+#define TARGET_SSE42
+#define TARGET_AVX2
+#else
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+SimdLevel detectSimdLevel()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = (info[2] & (1 << 20)) != 0;
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osSavesYmm) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse42 = __builtin_cpu_supports("sse4.2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    if (avx2)
+        return SIMD_AVX2;
+    return sse42 ? SIMD_SSE42 : SIMD_SCALAR;
+}
+
+static SimdLevel currentLevel = detectSimdLevel();
+
+SimdLevel activeSimdLevel()
+{
+    return currentLevel;
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    currentLevel = level < detectSimdLevel() ? level : detectSimdLevel();
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_AVX2: return "AVX2";
+    case SIMD_SSE42: return "SSE4.2";
+    default: return "scalar";
+    }
+}
+
+int lowestSetBit(uint64_t word)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    return __builtin_ctzll(word);
+#endif
+}
+
+template <CompareOp Op, typename T>
+static inline bool scalarCompare(T a, T b)
+{
+    if constexpr (Op == CMP_EQ) return a == b;
+    else if constexpr (Op == CMP_NE) return a != b;
+    else if constexpr (Op == CMP_LT) return a < b;
+    else if constexpr (Op == CMP_LE) return a <= b;
+    else if constexpr (Op == CMP_GT) return a > b;
+    else return a >= b;
+}
+
+// Rows [from, count) one at a time; also the whole scalar kernel.
+template <CompareOp Op, typename T>
+static void filterScalar(const T* values, uint32_t from, uint32_t count, T literal, uint64_t* selection)
+{
+    for (uint32_t r = from; r < count; r++)
+        selection[r / 64] |= (uint64_t)scalarCompare<Op>(values[r], literal) << (r % 64);
+}
+
+// ---- SSE4.2 ---------------------------------------------------------------
+
+template <CompareOp Op>
+TARGET_SSE42 static inline int maskInt32x4(__m128i v, __m128i lit)
+{
+    __m128i m;
+    if constexpr (Op == CMP_EQ) m = _mm_cmpeq_epi32(v, lit);
+    else if constexpr (Op == CMP_NE) m = _mm_xor_si128(_mm_cmpeq_epi32(v, lit), _mm_set1_epi32(-1));
+    else if constexpr (Op == CMP_LT) m = _mm_cmplt_epi32(v, lit);
+    else if constexpr (Op == CMP_LE) m = _mm_xor_si128(_mm_cmpgt_epi32(v, lit), _mm_set1_epi32(-1));
+    else if constexpr (Op == CMP_GT) m = _mm_cmpgt_epi32(v, lit);
+    else m = _mm_xor_si128(_mm_cmplt_epi32(v, lit), _mm_set1_epi32(-1));
+    return _mm_movemask_ps(_mm_castsi128_ps(m));
+}
+
+template <CompareOp Op>
+TARGET_SSE42 static inline int maskFloatx4(__m128 v, __m128 lit)
+{
+    if constexpr (Op == CMP_EQ) return _mm_movemask_ps(_mm_cmpeq_ps(v, lit));
+    else if constexpr (Op == CMP_NE) return _mm_movemask_ps(_mm_cmpneq_ps(v, lit));
+    else if constexpr (Op == CMP_LT) return _mm_movemask_ps(_mm_cmplt_ps(v, lit));
+    else if constexpr (Op == CMP_LE) return _mm_movemask_ps(_mm_cmple_ps(v, lit));
+    else if constexpr (Op == CMP_GT) return _mm_movemask_ps(_mm_cmpgt_ps(v, lit));
+    else return _mm_movemask_ps(_mm_cmpge_ps(v, lit));
+}
+
+template <CompareOp Op>
+TARGET_SSE42 static inline int maskDoublex2(__m128d v, __m128d lit)
+{
+    if constexpr (Op == CMP_EQ) return _mm_movemask_pd(_mm_cmpeq_pd(v, lit));
+    else if constexpr (Op == CMP_NE) return _mm_movemask_pd(_mm_cmpneq_pd(v, lit));
+    else if constexpr (Op == CMP_LT) return _mm_movemask_pd(_mm_cmplt_pd(v, lit));
+    else if constexpr (Op == CMP_LE) return _mm_movemask_pd(_mm_cmple_pd(v, lit));
+    else if constexpr (Op == CMP_GT) return _mm_movemask_pd(_mm_cmpgt_pd(v, lit));
+    else return _mm_movemask_pd(_mm_cmpge_pd(v, lit));
+}
+
+template <CompareOp Op>
+TARGET_SSE42 static void filterInt32Sse(const int32_t* values, uint32_t count, int32_t literal, uint64_t* selection)
+{
+    __m128i lit = _mm_set1_epi32(literal);
+    uint32_t full = count & ~63u;
+    for (uint32_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (uint32_t i = 0; i < 64; i += 4)
+            word |= (uint64_t)maskInt32x4<Op>(_mm_loadu_si128((const __m128i*)(values + base + i)), lit) << i;
+        selection[base / 64] = word;
+    }
+    filterScalar<Op>(values, full, count, literal, selection);
+}
+
+template <CompareOp Op>
+TARGET_SSE42 static void filterFloatSse(const float* values, uint32_t count, float literal, uint64_t* selection)
+{
+    __m128 lit = _mm_set1_ps(literal);
+    uint32_t full = count & ~63u;
+    for (uint32_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (uint32_t i = 0; i < 64; i += 4)
+            word |= (uint64_t)maskFloatx4<Op>(_mm_loadu_ps(values + base + i), lit) << i;
+        selection[base / 64] = word;
+    }
+    filterScalar<Op>(values, full, count, literal, selection);
+}
+
+template <CompareOp Op>
+TARGET_SSE42 static void filterDoubleSse(const double* values, uint32_t count, double literal, uint64_t* selection)
+{
+    __m128d lit = _mm_set1_pd(literal);
+    uint32_t full = count & ~63u;
+    for (uint32_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (uint32_t i = 0; i < 64; i += 2)
+            word |= (uint64_t)maskDoublex2<Op>(_mm_loadu_pd(values + base + i), lit) << i;
+        selection[base / 64] = word;
+    }
+    filterScalar<Op>(values, full, count, literal, selection);
+}
+
+// ---- AVX2 -----------------------------------------------------------------
+
+template <CompareOp Op>
+TARGET_AVX2 static inline int maskInt32x8(__m256i v, __m256i lit)
+{
+    __m256i m;
+    __m256i ones = _mm256_set1_epi32(-1);
+    if constexpr (Op == CMP_EQ) m = _mm256_cmpeq_epi32(v, lit);
+    else if constexpr (Op == CMP_NE) m = _mm256_xor_si256(_mm256_cmpeq_epi32(v, lit), ones);
+    else if constexpr (Op == CMP_LT) m = _mm256_cmpgt_epi32(lit, v);
+    else if constexpr (Op == CMP_LE) m = _mm256_xor_si256(_mm256_cmpgt_epi32(v, lit), ones);
+    else if constexpr (Op == CMP_GT) m = _mm256_cmpgt_epi32(v, lit);
+    else m = _mm256_xor_si256(_mm256_cmpgt_epi32(lit, v), ones);
+    return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+template <CompareOp Op>
+constexpr int avxPredicate()
+{
+    if constexpr (Op == CMP_EQ) return _CMP_EQ_OQ;
+    else if constexpr (Op == CMP_NE) return _CMP_NEQ_UQ;
+    else if constexpr (Op == CMP_LT) return _CMP_LT_OQ;
+    else if constexpr (Op == CMP_LE) return _CMP_LE_OQ;
+    else if constexpr (Op == CMP_GT) return _CMP_GT_OQ;
+    else return _CMP_GE_OQ;
+}
+
+template <CompareOp Op>
+TARGET_AVX2 static void filterInt32Avx2(const int32_t* values, uint32_t count, int32_t literal, uint64_t* selection)
+{
+    __m256i lit = _mm256_set1_epi32(literal);
+    uint32_t full = count & ~63u;
+    for (uint32_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (uint32_t i = 0; i < 64; i += 8)
+            word |= (uint64_t)maskInt32x8<Op>(_mm256_loadu_si256((const __m256i*)(values + base + i)), lit) << i;
+        selection[base / 64] = word;
+    }
+    filterScalar<Op>(values, full, count, literal, selection);
+}
+
+template <CompareOp Op>
+TARGET_AVX2 static void filterFloatAvx2(const float* values, uint32_t count, float literal, uint64_t* selection)
+{
+    __m256 lit = _mm256_set1_ps(literal);
+    uint32_t full = count & ~63u;
+    for (uint32_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (uint32_t i = 0; i < 64; i += 8)
+            word |= (uint64_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + base + i), lit, avxPredicate<Op>())) << i;
+        selection[base / 64] = word;
+    }
+    filterScalar<Op>(values, full, count, literal, selection);
+}
+
+template <CompareOp Op>
+TARGET_AVX2 static void filterDoubleAvx2(const double* values, uint32_t count, double literal, uint64_t* selection)
+{
+    __m256d lit = _mm256_set1_pd(literal);
+    uint32_t full = count & ~63u;
+    for (uint32_t base = 0; base < full; base += 64)
+    {
+        uint64_t word = 0;
+        for (uint32_t i = 0; i < 64; i += 4)
+            word |= (uint64_t)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + base + i), lit, avxPredicate<Op>())) << i;
+        selection[base / 64] = word;
+    }
+    filterScalar<Op>(values, full, count, literal, selection);
+}
+
+// ---- dispatch -------------------------------------------------------------
+
+template <CompareOp Op>
+static void filterInt32Op(const int32_t* values, uint32_t count, int32_t literal, uint64_t* selection, SimdLevel level)
+{
+    if (level == SIMD_AVX2) filterInt32Avx2<Op>(values, count, literal, selection);
+    else if (level == SIMD_SSE42) filterInt32Sse<Op>(values, count, literal, selection);
+    else filterScalar<Op>(values, 0, count, literal, selection);
+}
+
+template <CompareOp Op>
+static void filterFloatOp(const float* values, uint32_t count, float literal, uint64_t* selection, SimdLevel level)
+{
+    if (level == SIMD_AVX2) filterFloatAvx2<Op>(values, count, literal, selection);
+    else if (level == SIMD_SSE42) filterFloatSse<Op>(values, count, literal, selection);
+    else filterScalar<Op>(values, 0, count, literal, selection);
+}
+
+template <CompareOp Op>
+static void filterDoubleOp(const double* values, uint32_t count, double literal, uint64_t* selection, SimdLevel level)
+{
+    if (level == SIMD_AVX2) filterDoubleAvx2<Op>(values, count, literal, selection);
+    else if (level == SIMD_SSE42) filterDoubleSse<Op>(values, count, literal, selection);
+    else filterScalar<Op>(values, 0, count, literal, selection);
+}
+
+#define DISPATCH_OP(fn, ...)                                                  \
+    switch (op)                                                               \
+    {                                                                         \
+    case CMP_EQ: fn<CMP_EQ>(__VA_ARGS__); break;                              \
+    case CMP_NE: fn<CMP_NE>(__VA_ARGS__); break;                              \
+    case CMP_LT: fn<CMP_LT>(__VA_ARGS__); break;                              \
+    case CMP_LE: fn<CMP_LE>(__VA_ARGS__); break;                              \
+    case CMP_GT: fn<CMP_GT>(__VA_ARGS__); break;                              \
+    default: fn<CMP_GE>(__VA_ARGS__); break;                                  \
+    }
+
+void filterInt32(const int32_t* values, uint32_t count, CompareOp op, int32_t literal, uint64_t* selection, SimdLevel level)
+{
+    memset(selection, 0, selectionWords(count) * sizeof(uint64_t));
+    DISPATCH_OP(filterInt32Op, values, count, literal, selection, level)
+}
+
+void filterFloat(const float* values, uint32_t count, CompareOp op, float literal, uint64_t* selection, SimdLevel level)
+{
+    memset(selection, 0, selectionWords(count) * sizeof(uint64_t));
+    DISPATCH_OP(filterFloatOp, values, count, literal, selection, level)
+}
+
+void filterDouble(const double* values, uint32_t count, CompareOp op, double literal, uint64_t* selection, SimdLevel level)
+{
+    memset(selection, 0, selectionWords(count) * sizeof(uint64_t));
+    DISPATCH_OP(filterDoubleOp, values, count, literal, selection, level)
+}
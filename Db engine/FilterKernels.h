@@ -0,0 +1,35 @@
+#pragma once
+#ifndef FILTERKERNELS_H
+#define FILTERKERNELS_H
+#include <cstdint>
+#include "predicate.h"
+using namespace std;
+
+// Block filter kernels: compare a column's values against a literal and set
+// bit r of the selection bitmap (64 rows per word) for every row r that
+// matches. Each kernel has a scalar, an SSE4.2 and an AVX2 version; the
+// widest one the CPU supports is picked at startup. NULLs are not handled
+// here; callers mask them out with the column's null bitmap.
+
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE42,
+    SIMD_AVX2
+};
+
+SimdLevel detectSimdLevel();
+SimdLevel activeSimdLevel();
+void setSimdLevel(SimdLevel level);
+const char* simdLevelName(SimdLevel level);
+
+inline size_t selectionWords(uint32_t count) { return (count + 63) / 64; }
+
+void filterInt32(const int32_t* values, uint32_t count, CompareOp op, int32_t literal, uint64_t* selection, SimdLevel level);
+void filterFloat(const float* values, uint32_t count, CompareOp op, float literal, uint64_t* selection, SimdLevel level);
+void filterDouble(const double* values, uint32_t count, CompareOp op, double literal, uint64_t* selection, SimdLevel level);
+
+// Index of the lowest set bit; word must not be zero.
+int lowestSetBit(uint64_t word);
+
+#endif
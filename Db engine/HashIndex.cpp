@@ -0,0 +1,254 @@
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include "hashindex.h"
+using namespace std;
+
+uint64_t hashValue(const string& canonical)
+{
+    // FNV-1a, 64-bit
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : canonical) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool HashIndex::writeMeta()
+{
+    char meta[HIX_PAGE_SIZE] = {};
+    memcpy(meta, HIX_MAGIC, 4);
+    memcpy(meta + 4, &HIX_VERSION, 4);
+    memcpy(meta + 8, &bucketCount, 4);
+    memcpy(meta + 12, &pageCount, 4);
+    memcpy(meta + 16, &entryCount, 8);
+    memcpy(meta + 24, &tableBytes, 8);
+    file.seekp(0);
+    file.write(meta, sizeof meta);
+    file.flush();
+    metaDirty = !file.good();
+    return file.good();
+}
+
+bool HashIndex::create(const string& path, uint64_t expectedEntries)
+{
+    close();
+    file.open(path, ios::binary | ios::in | ios::out | ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    // Size the table so buckets start about half full.
+    filePath = path;
+    bucketCount = 1;
+    while ((uint64_t)bucketCount * HIX_PAGE_ENTRIES < expectedEntries * 2)
+        bucketCount *= 2;
+    pageCount = bucketCount + 1;
+    entryCount = 0;
+    tableBytes = 0;
+
+    Page empty;
+    for (uint32_t b = 1; b <= bucketCount; b++)
+        if (!writePage(b, empty))
+            return false;
+    return writeMeta();
+}
+
+bool HashIndex::open(const string& path)
+{
+    close();
+    file.open(path, ios::binary | ios::in | ios::out);
+    if (!file.is_open())
+        return false;
+
+    char meta[32];
+    uint32_t version;
+    if (!file.read(meta, sizeof meta) || memcmp(meta, HIX_MAGIC, 4) != 0) {
+        close();
+        return false;
+    }
+    memcpy(&version, meta + 4, 4);
+    if (version != HIX_VERSION) {
+        close();
+        return false;
+    }
+    filePath = path;
+    memcpy(&bucketCount, meta + 8, 4);
+    memcpy(&pageCount, meta + 12, 4);
+    memcpy(&entryCount, meta + 16, 8);
+    memcpy(&tableBytes, meta + 24, 8);
+    return true;
+}
+
+void HashIndex::close()
+{
+    if (file.is_open() && metaDirty)
+        writeMeta();
+    metaDirty = false;
+    if (file.is_open())
+        file.close();
+    file.clear();
+}
+
+void HashIndex::setSyncedTableBytes(uint64_t bytes)
+{
+    tableBytes = bytes;
+    writeMeta();
+}
+
+bool HashIndex::readPage(uint32_t page, Page& p)
+{
+    char buf[HIX_PAGE_SIZE];
+    file.seekg((uint64_t)page * HIX_PAGE_SIZE);
+    if (!file.read(buf, sizeof buf))
+        return false;
+
+    uint32_t count;
+    memcpy(&count, buf, 4);
+    memcpy(&p.overflow, buf + 4, 4);
+    if (count > HIX_PAGE_ENTRIES)
+        return false;
+    p.entries.resize(count);
+    memcpy(p.entries.data(), buf + HIX_PAGE_HEADER_SIZE, count * sizeof(Entry));
+    return true;
+}
+
+bool HashIndex::writePage(uint32_t page, const Page& p)
+{
+    char buf[HIX_PAGE_SIZE] = {};
+    uint32_t count = (uint32_t)p.entries.size();
+    memcpy(buf, &count, 4);
+    memcpy(buf + 4, &p.overflow, 4);
+    memcpy(buf + HIX_PAGE_HEADER_SIZE, p.entries.data(), count * sizeof(Entry));
+    file.seekp((uint64_t)page * HIX_PAGE_SIZE);
+    file.write(buf, sizeof buf);
+    return file.good();
+}
+
+bool HashIndex::insert(uint64_t hash, uint64_t location)
+{
+    uint32_t head = 1 + (uint32_t)(hash & (bucketCount - 1));
+    Page p;
+    if (!readPage(head, p))
+        return false;
+    if (p.entries.size() >= HIX_PAGE_ENTRIES)
+    {
+        uint32_t moved = pageCount++;
+        if (!writePage(moved, p))
+            return false;
+        p = Page();
+        p.overflow = moved;
+    }
+
+    p.entries.push_back({ hash, location });
+    if (!writePage(head, p))
+        return false;
+    entryCount++;
+    metaDirty = true;
+
+    if (entryCount > (uint64_t)bucketCount * HIX_PAGE_ENTRIES)
+        return grow();
+    return true;
+}
+
+bool HashIndex::erase(uint64_t hash, uint64_t location)
+{
+    uint32_t page = 1 + (uint32_t)(hash & (bucketCount - 1));
+    Page p;
+    while (page != 0)
+    {
+        if (!readPage(page, p))
+            return false;
+        for (size_t i = 0; i < p.entries.size(); i++)
+        {
+            if (p.entries[i].hash == hash && p.entries[i].location == location) {
+                p.entries[i] = p.entries.back();
+                p.entries.pop_back();
+                entryCount--;
+                metaDirty = true;
+                return writePage(page, p);
+            }
+        }
+        page = p.overflow;
+    }
+    return false;
+}
+
+bool HashIndex::find(uint64_t hash, vector<uint64_t>& locations)
+{
+    uint32_t page = 1 + (uint32_t)(hash & (bucketCount - 1));
+    Page p;
+    while (page != 0)
+    {
+        if (!readPage(page, p))
+            return false;
+        for (auto& e : p.entries)
+            if (e.hash == hash)
+                locations.push_back(e.location);
+        page = p.overflow;
+    }
+    return true;
+}
+
+bool HashIndex::grow()
+{
+    vector<Entry> all;
+    all.reserve(entryCount);
+    Page p;
+    for (uint32_t b = 1; b <= bucketCount; b++)
+    {
+        for (uint32_t page = b; page != 0; page = p.overflow)
+        {
+            if (!readPage(page, p))
+                return false;
+            all.insert(all.end(), p.entries.begin(), p.entries.end());
+        }
+    }
+
+    uint64_t synced = tableBytes;
+    if (!writeBuckets(all))
+        return false;
+    tableBytes = synced;
+    return writeMeta();
+}
+
+bool HashIndex::build(const string& path, const vector<pair<uint64_t, uint64_t>>& entries)
+{
+    vector<Entry> all;
+    all.reserve(entries.size());
+    for (auto& e : entries)
+        all.push_back({ e.first, e.second });
+
+    filePath = path;
+    return writeBuckets(all);
+}
+
+bool HashIndex::writeBuckets(const vector<Entry>& all)
+{
+    if (!create(filePath, all.size()))
+        return false;
+
+    // Rebuild every bucket chain in memory, then write each one out once.
+    vector<vector<Entry>> buckets(bucketCount);
+    for (auto& e : all)
+        buckets[e.hash & (bucketCount - 1)].push_back(e);
+
+    for (uint32_t b = 0; b < bucketCount; b++)
+    {
+        uint32_t page = b + 1;
+        size_t at = 0;
+        do {
+            Page out;
+            size_t take = min((size_t)HIX_PAGE_ENTRIES, buckets[b].size() - at);
+            out.entries.assign(buckets[b].begin() + at, buckets[b].begin() + at + take);
+            at += take;
+            out.overflow = at < buckets[b].size() ? pageCount++ : 0;
+            if (!writePage(page, out))
+                return false;
+            page = out.overflow;
+        } while (page != 0);
+    }
+    entryCount = all.size();
+    return writeMeta();
+}
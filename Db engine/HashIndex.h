@@ -0,0 +1,78 @@
+#pragma once
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+using namespace std;
+
+// On-disk hash index over one column (<table>.<index>.hidx). Each entry is the
+// 64-bit hash of a canonical column value plus the row location, so lookups can
+// return false positives that the caller filters by comparing the real value.
+//
+//   page 0      : "ITHX", version, bucket count, page count, entry count,
+//                 table file size at last sync
+//   pages 1..n  : primary bucket pages
+//   later pages : overflow pages chained from a full bucket
+//
+// New entries go to a bucket's first page. When it is full its entries move
+// to a new overflow page linked right behind it, so an insert never walks the
+// chain. The page 0 counts are written when the index is closed, once per
+// statement rather than once per entry. When the average chain grows past one
+// page the file is rebuilt with twice as many buckets.
+
+const char HIX_MAGIC[4] = { 'I', 'T', 'H', 'X' };
+const uint32_t HIX_VERSION = 1;
+const uint32_t HIX_PAGE_SIZE = 4096;
+const size_t HIX_PAGE_HEADER_SIZE = 16;
+const uint32_t HIX_PAGE_ENTRIES = (HIX_PAGE_SIZE - HIX_PAGE_HEADER_SIZE) / 16;
+
+uint64_t hashValue(const string& canonical);
+
+class HashIndex
+{
+public:
+    ~HashIndex() { close(); }
+
+    bool create(const string& path, uint64_t expectedEntries);
+    bool open(const string& path);
+    bool build(const string& path, const vector<pair<uint64_t, uint64_t>>& entries);
+    void close();
+
+    bool insert(uint64_t hash, uint64_t location);
+    bool erase(uint64_t hash, uint64_t location);
+    bool find(uint64_t hash, vector<uint64_t>& locations);
+
+    uint64_t entries() const { return entryCount; }
+    uint64_t syncedTableBytes() const { return tableBytes; }
+    void setSyncedTableBytes(uint64_t bytes);
+
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        uint64_t location;
+    };
+    struct Page
+    {
+        uint32_t overflow = 0;
+        vector<Entry> entries;
+    };
+
+    fstream file;
+    string filePath;
+    uint32_t bucketCount = 1;
+    uint32_t pageCount = 0;
+    uint64_t entryCount = 0;
+    uint64_t tableBytes = 0;
+    bool metaDirty = false;     // counts changed since page 0 was written
+
+    bool readPage(uint32_t page, Page& p);
+    bool writePage(uint32_t page, const Page& p);
+    bool writeMeta();
+    bool writeBuckets(const vector<Entry>& all);
+    bool grow();
+};
+
+#endif
@@ -14,7 +14,13 @@ void printHelp() {
     cout << "2. SELECT\n";
     cout << "   Syntax: SELECT * FROM table_name\n";
     cout << "   Syntax: SELECT col1, col2 FROM table_name\n";
-    cout << "   Syntax: SELECT * FROM table_name WHERE col=val\n\n";
+    cout << "   Syntax: SELECT * FROM table_name WHERE col=val\n";
+    cout << "   Syntax: SELECT * FROM table_name WHERE (a=1 OR b>2) AND NOT c=3\n";
+    cout << "   Syntax: SELECT * FROM table_name WHERE col IN (val1, val2, ...)\n";
+    cout << "   Syntax: SELECT col, COUNT(*), SUM(col2) FROM table_name [WHERE ...] GROUP BY col\n";
+    cout << "   Syntax: SELECT a.col, b.col FROM a JOIN b ON a.x = b.y [WHERE ...]\n";
+    cout << "   Syntax: SELECT ... [ORDER BY col [ASC|DESC], ...] [LIMIT n [OFFSET m]]\n";
+    cout << "   Aggregates: COUNT, SUM, AVG, MIN, MAX\n\n";
 
     cout << "3. UPDATE\n";
     cout << "   Syntax: UPDATE table_name SET col=val WHERE col=val\n\n";
@@ -22,10 +28,67 @@ void printHelp() {
     cout << "4. DROP TABLE\n";
     cout << "   Syntax: DROP TABLE table_name\n\n";
 
-    cout << "5. HELP\n";
+    cout << "5. CONVERT TABLE\n";
+    cout << "   Syntax: CONVERT TABLE table_name\n";
+    cout << "   Description: Converts a legacy table_name.csv file to the binary table format.\n\n";
+
+    cout << "6. COPY\n";
+    cout << "   Syntax: COPY table_name FROM 'file.csv' [HEADER]\n";
+    cout << "   Description: Bulk loads comma-separated rows into a table; HEADER skips the first line.\n\n";
+
+    cout << "7. PREPARE / EXECUTE\n";
+    cout << "   Syntax: PREPARE name AS statement\n";
+    cout << "   Syntax: EXECUTE name(val1, val2, ...)\n";
+    cout << "   Syntax: DEALLOCATE name\n";
+    cout << "   Example: PREPARE byId AS SELECT * FROM Employee WHERE ID = ?\n";
+    cout << "   Description: Plans a SELECT, INSERT, UPDATE or DELETE once; EXECUTE runs it with\n";
+    cout << "                its ? parameters bound to the values given.\n\n";
+
+    cout << "8. CREATE INDEX\n";
+    cout << "   Syntax: CREATE INDEX index_name ON table_name(column)\n";
+    cout << "   Description: Builds a hash index used by WHERE col=val lookups.\n\n";
+
+    cout << "9. DROP INDEX\n";
+    cout << "   Syntax: DROP INDEX index_name [ON table_name]\n\n";
+
+    cout << "10. VACUUM\n";
+    cout << "   Syntax: VACUUM table_name\n";
+    cout << "   Description: Rewrites a table without its deleted rows and rebuilds its indexes.\n\n";
+
+    cout << "11. ANALYZE\n";
+    cout << "   Syntax: ANALYZE table_name\n";
+    cout << "   Description: Collects column statistics (NULLs, distinct values, range, histogram)\n";
+    cout << "                that the planner uses to order WHERE tests, choose between an index\n";
+    cout << "                and a scan, and pick the table a join hashes.\n\n";
+
+    cout << "12. CHECKPOINT\n";
+    cout << "   Description: Forces every changed table to disk and empties the write-ahead log.\n\n";
+
+    cout << "13. COMMIT\n";
+    cout << "   Description: Forces the changes made so far to disk. In batch mode (--file script.sql\n";
+    cout << "                or --batch) changes are only forced to disk at COMMIT and at the end.\n\n";
+
+    cout << "14. SET\n";
+    cout << "   Syntax: SET SIMD = AUTO | AVX2 | SSE42 | SCALAR\n";
+    cout << "   Syntax: SET THREADS = count\n";
+    cout << "   Syntax: SET SYNC = FULL | GROUP | OFF\n";
+    cout << "   Syntax: SET SYNC_INTERVAL = milliseconds\n";
+    cout << "   Syntax: SET VACUUM_THRESHOLD = percent\n";
+    cout << "   Description: SIMD picks the instruction set used to filter numeric columns;\n";
+    cout << "                THREADS sets how many threads scan tables (0 = one per CPU thread);\n";
+    cout << "                SYNC sets when logged changes are forced to disk (GROUP forces commits\n";
+    cout << "                waiting at the same time together, gathering them for SYNC_INTERVAL ms);\n";
+    cout << "                VACUUM_THRESHOLD sets the share of deleted rows at which a table is\n";
+    cout << "                vacuumed automatically (0 = never).\n\n";
+
+    cout << "15. BENCHMARK\n";
+    cout << "   Syntax: BENCHMARK FILTER [rows]\n";
+    cout << "   Description: Measures WHERE filter throughput for each available instruction set.\n\n";
+
+    cout << "16. HELP\n";
     cout << "   Syntax: HELP\n";
     cout << "   Description: Shows this help message.\n\n";
 
-    cout << "6. EXIT / QUIT\n";
-    cout << "   Description: Exits the application.\n\n";
+    cout << "17. EXIT / QUIT\n";
+    cout << "   Description: Forces pending changes to disk and exits the application.\n\n";
 }
@@ -0,0 +1,404 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include "index.h"
+#include "hashindex.h"
+#include "bplustree.h"
+#include "storage.h"
+#include "utils.h"
+using namespace std;
+
+string indexCatalogFile(string tableName)
+{
+    return tableName + ".idx";
+}
+
+string hashIndexFile(string tableName, string indexName)
+{
+    return tableName + "." + indexName + ".hidx";
+}
+
+vector<IndexDef> readIndexCatalog(string tableName)
+{
+    vector<IndexDef> defs;
+    ifstream f(indexCatalogFile(tableName));
+    string line;
+    while (getline(f, line))
+    {
+        stringstream ss(line);
+        IndexDef d;
+        if (ss >> d.name >> d.column)
+            defs.push_back(d);
+    }
+    return defs;
+}
+
+bool writeIndexCatalog(string tableName, const vector<IndexDef>& defs)
+{
+    if (defs.empty()) {
+        remove(indexCatalogFile(tableName).c_str());
+        return true;
+    }
+
+    ofstream f(indexCatalogFile(tableName), ios::trunc);
+    for (auto& d : defs)
+        f << d.name << " " << d.column << "\n";
+    return f.good();
+}
+
+static int findColumn(const TableData& schema, const string& column)
+{
+    string wanted = column;
+    toUpper(wanted);
+    for (size_t i = 0; i < schema.columns.size(); i++)
+    {
+        string name = schema.columns[i];
+        toUpper(name);
+        if (name == wanted)
+            return (int)i;
+    }
+    return -1;
+}
+
+static uint64_t valueHash(const TableData& schema, int col, const string& value)
+{
+    return hashValue(canonicalValue(schema.types[col], value));
+}
+
+static bool buildHashIndex(string tableName, const TableData& schema, const IndexDef& def,
+    const vector<string>& values, const vector<uint64_t>& locations)
+{
+    int col = findColumn(schema, def.column);
+    if (col == -1)
+        return false;
+
+    vector<pair<uint64_t, uint64_t>> entries;
+    entries.reserve(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+        entries.push_back({ valueHash(schema, col, values[i]), locations[i] });
+
+    HashIndex index;
+    if (!index.build(hashIndexFile(tableName, def.name), entries))
+        return false;
+    index.setSyncedTableBytes(tableFileSize(tableName));
+    return true;
+}
+
+static bool buildHashIndexFromFile(string tableName, const TableData& schema, const IndexDef& def)
+{
+    int col = findColumn(schema, def.column);
+    vector<string> values;
+    vector<uint64_t> locations;
+    if (col == -1 || !readTableColumn(tableName, schema, col, values, &locations))
+        return false;
+    return buildHashIndex(tableName, schema, def, values, locations);
+}
+
+static bool openHashIndex(string tableName, const TableData& schema, const IndexDef& def, HashIndex& index,
+    uint64_t expectedTableBytes)
+{
+    string path = hashIndexFile(tableName, def.name);
+    if (index.open(path) && index.syncedTableBytes() == expectedTableBytes)
+        return true;
+    if (!buildHashIndexFromFile(tableName, schema, def)) {
+        setColor(12); cout << "Error: Cannot build index '" << def.name << "' of table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+    return index.open(path);
+}
+
+bool rebuildTableIndexes(string tableName, const TableData& data, const vector<uint64_t>& locations)
+{
+    vector<string> keys;
+    if (data.primaryKeyIndex != -1)
+        for (auto& row : data.rows)
+            keys.push_back(row[data.primaryKeyIndex]);
+    if (!rebuildPrimaryIndex(tableName, data, keys, locations)) {
+        setColor(12); cout << "Error: Cannot build PRIMARY KEY index for table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+
+    for (auto& def : readIndexCatalog(tableName))
+    {
+        int col = findColumn(data, def.column);
+        vector<string> values;
+        if (col != -1)
+            for (auto& row : data.rows)
+                values.push_back(row[col]);
+        if (!buildHashIndex(tableName, data, def, values, locations)) {
+            setColor(12); cout << "Error: Cannot build index '" << def.name << "' of table '" << tableName << "'.\n"; setColor(15);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool rebuildIndexesFromFile(string tableName, const TableData& schema)
+{
+    vector<string> keys;
+    vector<uint64_t> locations;
+    if (schema.primaryKeyIndex != -1 && !readTableColumn(tableName, schema, schema.primaryKeyIndex, keys, &locations))
+        return false;
+    if (!rebuildPrimaryIndex(tableName, schema, keys, locations)) {
+        setColor(12); cout << "Error: Cannot build PRIMARY KEY index for table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+
+    for (auto& def : readIndexCatalog(tableName))
+        if (!buildHashIndexFromFile(tableName, schema, def)) {
+            setColor(12); cout << "Error: Cannot build index '" << def.name << "' of table '" << tableName << "'.\n"; setColor(15);
+            return false;
+        }
+    return true;
+}
+
+bool indexAppendedRows(string tableName, const TableData& schema, const vector<vector<string>>& rows,
+    const vector<uint64_t>& locations, uint64_t tableBytesBefore)
+{
+    bool ok = true;
+    for (auto& def : readIndexCatalog(tableName))
+    {
+        // An index that was already behind gets rebuilt from the file, which
+        // includes the appended rows.
+        HashIndex index;
+        bool current = index.open(hashIndexFile(tableName, def.name)) && index.syncedTableBytes() == tableBytesBefore;
+        if (!current) {
+            ok = buildHashIndexFromFile(tableName, schema, def) && ok;
+            continue;
+        }
+
+        int col = findColumn(schema, def.column);
+        for (size_t i = 0; i < rows.size(); i++)
+            ok = index.insert(valueHash(schema, col, rows[i][col]), locations[i]) && ok;
+        index.setSyncedTableBytes(tableFileSize(tableName));
+    }
+    return ok;
+}
+
+bool indexUpdatedRows(string tableName, const TableData& schema, const vector<uint64_t>& locations,
+    const vector<vector<string>>& before, const vector<vector<string>>& after)
+{
+    bool ok = true;
+    uint64_t tableBytes = tableFileSize(tableName);
+    for (auto& def : readIndexCatalog(tableName))
+    {
+        int col = findColumn(schema, def.column);
+        HashIndex index;
+        if (col == -1 || !openHashIndex(tableName, schema, def, index, tableBytes)) {
+            ok = false;
+            continue;
+        }
+
+        for (size_t i = 0; i < locations.size(); i++)
+        {
+            uint64_t oldHash = valueHash(schema, col, before[i][col]);
+            uint64_t newHash = valueHash(schema, col, after[i][col]);
+            if (oldHash == newHash)
+                continue;
+            index.erase(oldHash, locations[i]);
+            ok = index.insert(newHash, locations[i]) && ok;
+        }
+    }
+    return ok;
+}
+
+bool indexDeletedRows(string tableName, const TableData& schema, const vector<uint64_t>& locations,
+    const vector<vector<string>>& rows)
+{
+    bool ok = true;
+    BPlusTree tree;
+    if (schema.primaryKeyIndex != -1)
+    {
+        string key;
+        if (!openPrimaryIndex(tableName, schema, tree))
+            ok = false;
+        else
+            for (auto& row : rows)
+                if (tree.encodeKey(row[schema.primaryKeyIndex], key))
+                    tree.erase(key);
+    }
+
+    uint64_t tableBytes = tableFileSize(tableName);
+    for (auto& def : readIndexCatalog(tableName))
+    {
+        int col = findColumn(schema, def.column);
+        HashIndex index;
+        if (col == -1 || !openHashIndex(tableName, schema, def, index, tableBytes)) {
+            ok = false;
+            continue;
+        }
+        for (size_t i = 0; i < locations.size(); i++)
+            index.erase(valueHash(schema, col, rows[i][col]), locations[i]);
+    }
+    return ok;
+}
+
+void dropTableIndexes(string tableName)
+{
+    remove(primaryIndexFile(tableName).c_str());
+    for (auto& def : readIndexCatalog(tableName))
+        remove(hashIndexFile(tableName, def.name).c_str());
+    remove(indexCatalogFile(tableName).c_str());
+}
+
+bool chooseIndexAccess(string tableName, const TableData& schema, int col, const string& op, IndexAccess& access)
+{
+    access = IndexAccess();
+    if (col < 0 || op.empty() || op == "!=")
+        return false;
+
+    access.column = col;
+    access.primary = col == schema.primaryKeyIndex;
+    if (op == "=")
+    {
+        for (auto& def : readIndexCatalog(tableName))
+        {
+            if (findColumn(schema, def.column) == col) {
+                access.hash = def;
+                access.hasHash = true;
+                break;
+            }
+        }
+    }
+    return access.primary || access.hasHash;
+}
+
+bool fetchIndexedRows(string tableName, const TableData& schema, const IndexAccess& access, const string& op, string value,
+    vector<uint64_t>& locations, vector<vector<string>>& rows)
+{
+    int col = access.column;
+    if (!access.primary && !access.hasHash)
+        return false;
+
+    if (value.size() >= 2 && (value.front() == '\'' || value.front() == '"') && value.back() == value.front())
+        value = value.substr(1, value.size() - 2);
+
+    if (access.primary && lookupPrimaryKey(tableName, schema, op, value, locations))
+        return readRowsAt(tableName, schema, locations, rows);
+
+    if (!access.hasHash)
+        return false;
+
+    HashIndex index;
+    vector<uint64_t> candidates;
+    string wanted = canonicalValue(schema.types[col], value);
+    if (!openHashIndex(tableName, schema, access.hash, index, tableFileSize(tableName)) ||
+        !index.find(hashValue(wanted), candidates))
+        return false;
+
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    vector<vector<string>> fetched;
+    if (!readRowsAt(tableName, schema, candidates, fetched))
+        return false;
+
+    // Hash hits are only candidates; keep the rows whose value really matches.
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        if (canonicalValue(schema.types[col], fetched[i][col]) == wanted) {
+            locations.push_back(candidates[i]);
+            rows.push_back(fetched[i]);
+        }
+    }
+    return true;
+}
+
+bool fetchIndexedRows(string tableName, const TableData& schema, int col, const string& op, string value,
+    vector<uint64_t>& locations, vector<vector<string>>& rows)
+{
+    IndexAccess access;
+    return chooseIndexAccess(tableName, schema, col, op, access)
+        && fetchIndexedRows(tableName, schema, access, op, value, locations, rows);
+}
+
+bool executeCreateIndex(const CreateIndexQuery& q)
+{
+    const string& tableName = q.tableName;
+    IndexDef def;
+    def.name = q.name;
+    def.column = q.column;
+
+    if (!tableExists(tableName)) {
+        setColor(12); cout << "Error: Table '" << tableName << "' does not exist.\n"; setColor(15);
+        return false;
+    }
+
+    TableData schema;
+    if (!readTableSchema(tableName, schema)) {
+        setColor(12); cout << "Error: Cannot read table structure.\n"; setColor(15);
+        return false;
+    }
+    int col = findColumn(schema, def.column);
+    if (col == -1) {
+        setColor(12); cout << "Error: Column '" << def.column << "' does not exist.\n"; setColor(15);
+        return false;
+    }
+    def.column = schema.columns[col];
+
+    vector<IndexDef> defs = readIndexCatalog(tableName);
+    for (auto& d : defs)
+    {
+        if (d.name == def.name) {
+            setColor(12); cout << "Error: Index '" << def.name << "' already exists on table '" << tableName << "'.\n"; setColor(15);
+            return false;
+        }
+    }
+
+    if (!buildHashIndexFromFile(tableName, schema, def)) {
+        setColor(12); cout << "Error: Failed to build index '" << def.name << "'.\n"; setColor(15);
+        return false;
+    }
+    defs.push_back(def);
+    writeIndexCatalog(tableName, defs);
+
+    setColor(10);
+    cout << "Index '" << def.name << "' created on " << tableName << "(" << def.column << ").\n";
+    setColor(15);
+    return true;
+}
+
+bool executeDropIndex(const DropIndexQuery& q)
+{
+    const string& name = q.name;
+    string tableName = q.tableName;
+    if (tableName.empty()) {
+        // Without ON, look the name up in every table's index catalog.
+        int matches = 0;
+        for (auto& entry : filesystem::directory_iterator(filesystem::current_path()))
+        {
+            if (entry.path().extension() != ".idx")
+                continue;
+            string table = entry.path().stem().string();
+            for (auto& d : readIndexCatalog(table))
+                if (d.name == name) {
+                    tableName = table;
+                    matches++;
+                }
+        }
+        if (matches > 1) {
+            setColor(12); cout << "Error: Index name '" << name << "' is ambiguous. Use DROP INDEX name ON table.\n"; setColor(15);
+            return false;
+        }
+    }
+
+    vector<IndexDef> defs = readIndexCatalog(tableName);
+    auto it = find_if(defs.begin(), defs.end(), [&](const IndexDef& d) { return d.name == name; });
+    if (tableName.empty() || it == defs.end()) {
+        setColor(12); cout << "Error: Index '" << name << "' does not exist.\n"; setColor(15);
+        return false;
+    }
+
+    defs.erase(it);
+    remove(hashIndexFile(tableName, name).c_str());
+    writeIndexCatalog(tableName, defs);
+
+    setColor(10);
+    cout << "Index '" << name << "' dropped from table '" << tableName << "'.\n";
+    setColor(15);
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#ifndef INDEX_H
+#define INDEX_H
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "utils.h"
+#include "hashindex.h"
+#include "parser.h"
+using namespace std;
+
+// Secondary indexes of a table are listed in <table>.idx, one "name column"
+// pair per line; each one is a hash index stored in <table>.<name>.hidx.
+
+struct IndexDef
+{
+    string name;
+    string column;
+};
+
+string indexCatalogFile(string tableName);
+string hashIndexFile(string tableName, string indexName);
+vector<IndexDef> readIndexCatalog(string tableName);
+bool writeIndexCatalog(string tableName, const vector<IndexDef>& defs);
+
+bool rebuildTableIndexes(string tableName, const TableData& data, const vector<uint64_t>& locations);
+// Same, reading the indexed columns back from the table file.
+bool rebuildIndexesFromFile(string tableName, const TableData& schema);
+bool indexAppendedRows(string tableName, const TableData& schema, const vector<vector<string>>& rows,
+    const vector<uint64_t>& locations, uint64_t tableBytesBefore);
+bool indexUpdatedRows(string tableName, const TableData& schema, const vector<uint64_t>& locations,
+    const vector<vector<string>>& before, const vector<vector<string>>& after);
+bool indexDeletedRows(string tableName, const TableData& schema, const vector<uint64_t>& locations,
+    const vector<vector<string>>& rows);
+void dropTableIndexes(string tableName);
+
+// How a condition "col op value" can be answered from the table's indexes:
+// the primary key B+tree, or a hash index for "=". Picked from the schema and
+// the index catalog, so it holds until an index is created or dropped.
+struct IndexAccess
+{
+    int column = -1;
+    bool primary = false;
+    bool hasHash = false;
+    IndexDef hash;
+};
+
+// Returns false when no index can answer the condition.
+bool chooseIndexAccess(string tableName, const TableData& schema, int col, const string& op, IndexAccess& access);
+// Returns false when the rows have to be found by a scan instead.
+bool fetchIndexedRows(string tableName, const TableData& schema, const IndexAccess& access, const string& op, string value,
+    vector<uint64_t>& locations, vector<vector<string>>& rows);
+bool fetchIndexedRows(string tableName, const TableData& schema, int col, const string& op, string value,
+    vector<uint64_t>& locations, vector<vector<string>>& rows);
+
+bool executeCreateIndex(const CreateIndexQuery& q);
+bool executeDropIndex(const DropIndexQuery& q);
+
+#endif
@@ -3,212 +3,98 @@
 #include <fstream>
 #include <algorithm>
 #include <unordered_map>
-#include <set>
+#include <unordered_set>
 #include "insert.h"
 #include "utils.h"
+#include "storage.h"
+#include "bplustree.h"
+#include "index.h"
+#include "writeaheadlog.h"
+#include "update.h"
 
-vector<string> parseValueSet(const string& valueSet)
+static bool isBlank(const string& value)
 {
-    vector<string> values;
-    string current = "";
-    bool inQuotes = false;
-    int parenDepth = 0;
-
-    for (size_t i = 0; i < valueSet.size(); i++)
-    {
-        char c = valueSet[i];
-
-        if (c == '\'')
-        {
-            inQuotes = !inQuotes;
-            continue;
-        }
-
-        if (!inQuotes)
-        {
-            if (c == '(')
-            {
-                parenDepth++;
-                continue;
-            }
-            else if (c == ')')
-            {
-                parenDepth--;
-                if (parenDepth == 0)
-                {
-                    if (!current.empty())
-                    {
-                        values.push_back(trim(current));
-                        current = "";
-                    }
-                    break;
-                }
-                continue;
-            }
-            else if (c == ',' && parenDepth == 1)
-            {
-                values.push_back(trim(current));
-                current = "";
-                continue;
-            }
-        }
-
-        current += c;
-    }
-
-    if (!current.empty())
-    {
-        values.push_back(trim(current));
-    }
-
-    return values;
+    return all_of(value.begin(), value.end(), [](char c) { return isspace((unsigned char)c) != 0; });
 }
 
-InsertQuery parseInsertQuery(const string& query)
+bool prepareInsertRow(const TableData& table, vector<string>& row, string& err)
 {
-    InsertQuery iq;
-    iq.hasColumns = false;
-
-    string cmd = query;
-    if (!cmd.empty() && cmd.back() == ';')
-        cmd.pop_back();
-
-    string upper = cmd;
-    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-    upper = trim_Middle(upper);
-    size_t insertPos = upper.find("INSERT INTO");
-    if (insertPos == string::npos)
-    {
-        setColor(12);
-        cout << "Error: Invalid INSERT syntax. Use: INSERT INTO table VALUES (...)\n";
-        setColor(15);
-        return iq;
-    }
-
-    size_t tableStart = insertPos + 11;
-    size_t valuesPos = upper.find("VALUES");
-    size_t parenPos = upper.find("(", tableStart);
-
-    if (valuesPos == string::npos)
-    {
-        setColor(12);
-        cout << "Error: Missing VALUES clause.\n";
-        setColor(15);
-        return iq;
-    }
-
-    if (parenPos != string::npos && parenPos < valuesPos)
+    for (size_t i = 0; i < table.columns.size(); i++)
     {
-        iq.hasColumns = true;
-        iq.tableName = trim(cmd.substr(tableStart, parenPos - tableStart));
-
-        size_t endParen = upper.find(")", parenPos);
-        if (endParen == string::npos)
+        if (i < table.notNull.size() && table.notNull[i] && (isBlank(row[i]) || isNullValue(trim(row[i]))))
         {
-            setColor(12);
-            cout << "Error: Missing ')' after column names.\n";
-            setColor(15);
-            return iq;
+            err = "Column '" + table.columns[i] + "' cannot be NULL";
+            return false;
         }
-
-        string colSection = trim(cmd.substr(parenPos + 1, endParen - parenPos - 1));
-        iq.columns = split(colSection, ',');
-    }
-    else
-    {
-        iq.tableName = trim(cmd.substr(tableStart, valuesPos - tableStart));
-    }
-
-    if (iq.tableName.empty())
-    {
-        setColor(12);
-        cout << "Error: Missing table name.\n";
-        setColor(15);
-        return iq;
     }
 
-    string valuesSection = trim(cmd.substr(valuesPos + 6));
-
-    if (valuesSection.empty())
-    {
-        setColor(12);
-        cout << "Error: No values provided.\n";
-        setColor(15);
-        return iq;
-    }
-
-    size_t pos = 0;
-    while (pos < valuesSection.size())
+    for (size_t i = 0; i < table.columns.size(); i++)
     {
-        size_t startParen = valuesSection.find("(", pos);
-        if (startParen == string::npos)
-            break;
-
-        size_t endParen = startParen + 1;
-        int depth = 1;
-        bool inQuotes = false;
-
-        while (endParen < valuesSection.size() && depth > 0)
+        if (isBlank(row[i]))
         {
-            if (valuesSection[endParen] == '\'' && (endParen == 0 || valuesSection[endParen - 1] != '\\'))
+            string typeUpper = table.types[i];
+            transform(typeUpper.begin(), typeUpper.end(), typeUpper.begin(), ::toupper);
+
+            if (typeUpper == "INT" || typeUpper == "FLOAT")
             {
-                inQuotes = !inQuotes;
+                row[i] = "0";
             }
-            else if (!inQuotes)
+            else
             {
-                if (valuesSection[endParen] == '(')
-                    depth++;
-                else if (valuesSection[endParen] == ')')
-                    depth--;
+                row[i] = "NULL";
             }
-            endParen++;
         }
+    }
 
-        if (depth != 0)
+    for (size_t i = 0; i < table.columns.size(); i++)
+    {
+        if (i < table.lengths.size() && table.lengths[i] != -1)
         {
-            setColor(12);
-            cout << "Error: Unmatched parentheses in VALUES.\n";
-            setColor(15);
-            return iq;
+            if (!isNullValue(row[i]) && (int)row[i].length() > table.lengths[i])
+            {
+                err = "Value '" + row[i] + "' exceeds maximum length " + to_string(table.lengths[i])
+                    + " for column '" + table.columns[i] + "'";
+                return false;
+            }
         }
+    }
 
-        string valueSet = valuesSection.substr(startParen, endParen - startParen);
-        vector<string> values = parseValueSet(valueSet);
-
-        if (!values.empty())
+    for (size_t i = 0; i < table.columns.size(); i++)
+    {
+        if (!validateValue(table.types[i], table.lengths[i], row[i], err))
         {
-            iq.valuesList.push_back(values);
+            err += " for column '" + table.columns[i] + "'";
+            return false;
         }
-
-        pos = endParen;
     }
 
-    if (iq.valuesList.empty())
+    if (table.primaryKeyIndex != -1 && isNullValue(trim(row[table.primaryKeyIndex])))
     {
-        setColor(12);
-        cout << "Error: No valid value sets found.\n";
-        setColor(15);
-        return iq;
+        err = "PRIMARY KEY column '" + table.columns[table.primaryKeyIndex] + "' cannot be NULL";
+        return false;
     }
 
-    return iq;
+    // Stored values read back in canonical form; log them the same way.
+    for (size_t i = 0; i < table.columns.size(); i++)
+        row[i] = canonicalValue(table.types[i], row[i]);
+    return true;
 }
 
-bool executeInsert(const InsertQuery& iq)
+bool planInsert(const InsertQuery& iq, InsertPlan& plan)
 {
-    ifstream check(iq.tableName + ".csv");
-    if (!check.good())
+    plan = InsertPlan();
+    plan.tableName = iq.tableName;
+    plan.valuesList = iq.valuesList;
+    if (!tableExists(plan.tableName))
     {
         setColor(12);
-        cout << "Error: Table '" << iq.tableName << "' does not exist.\n";
+        cout << "Error: Table '" << plan.tableName << "' does not exist.\n";
         setColor(15);
         return false;
     }
-    check.close();
-
-    TableData table = readTable(iq.tableName);
 
-    if (table.columns.empty())
+    TableData& table = plan.table;
+    if (!readTableSchema(plan.tableName, table) || table.columns.empty())
     {
         setColor(12);
         cout << "Error: Cannot read table structure.\n";
@@ -216,50 +102,44 @@ bool executeInsert(const InsertQuery& iq)
         return false;
     }
 
-    unordered_map<string, int> colIndex;
-    for (size_t i = 0; i < table.columns.size(); i++)
-    {
-        string upperCol = table.columns[i];
-        transform(upperCol.begin(), upperCol.end(), upperCol.begin(), ::toupper);
-        colIndex[upperCol] = i;
-    }
-
-    if (iq.hasColumns)
+    plan.hasColumns = iq.hasColumns;
+    for (const string& col : iq.columns)
     {
-        for (const string& col : iq.columns)
+        int idx = getColumnIndex(table, col);
+        if (idx == -1)
         {
-            string upperInputCol = col;
-            transform(upperInputCol.begin(), upperInputCol.end(), upperInputCol.begin(), ::toupper);
-
-            if (colIndex.find(upperInputCol) == colIndex.end())
-            {
-                setColor(12);
-                cout << "Error: Column '" << col << "' does not exist.\n";
-                setColor(15);
-                return false;
-            }
+            setColor(12);
+            cout << "Error: Column '" << col << "' does not exist.\n";
+            setColor(15);
+            return false;
         }
+        plan.target.push_back(idx);
     }
+    return true;
+}
 
-    set<string> existingPKValues;
-    if (table.primaryKeyIndex != -1)
+bool runInsert(const InsertPlan& plan)
+{
+    const TableData& table = plan.table;
+
+    BPlusTree pkIndex;
+    unordered_set<string> newPKValues;
+    if (table.primaryKeyIndex != -1 && !openPrimaryIndex(plan.tableName, table, pkIndex))
     {
-        for (const auto& row : table.rows)
-        {
-            if (table.primaryKeyIndex < (int)row.size())
-            {
-                existingPKValues.insert(trim(row[table.primaryKeyIndex]));
-            }
-        }
+        setColor(12);
+        cout << "Error: Cannot open PRIMARY KEY index of table '" << plan.tableName << "'.\n";
+        setColor(15);
+        return false;
     }
 
+    vector<vector<string>> newRows;
     int insertedCount = 0;
 
-    for (const vector<string>& values : iq.valuesList)
+    for (const vector<string>& values : plan.valuesList)
     {
         vector<string> newRow;
 
-        if (!iq.hasColumns)
+        if (!plan.hasColumns)
         {
             if (values.size() != table.columns.size())
             {
@@ -274,7 +154,7 @@ bool executeInsert(const InsertQuery& iq)
         }
         else
         {
-            if (iq.columns.size() != values.size())
+            if (plan.target.size() != values.size())
             {
                 setColor(12);
                 cout << "Error: Column count doesn't match value count in row " << (insertedCount + 1) << ".\n";
@@ -283,66 +163,26 @@ bool executeInsert(const InsertQuery& iq)
             }
 
             newRow.resize(table.columns.size(), "");
-
-            for (size_t i = 0; i < iq.columns.size(); i++)
-            {
-                string upperInputCol = iq.columns[i];
-                transform(upperInputCol.begin(), upperInputCol.end(), upperInputCol.begin(), ::toupper);
-
-                int idx = colIndex[upperInputCol];
-                newRow[idx] = values[i];
-            }
-        }
-
-        for (size_t i = 0; i < table.columns.size(); i++)
-        {
-            if (i < table.notNull.size() && table.notNull[i])
-            {
-                if (i >= newRow.size() || trim(newRow[i]).empty())
-                {
-                    setColor(12);
-                    cout << "Error: Column '" << table.columns[i] << "' cannot be NULL (row " << (insertedCount + 1) << ").\n";
-                    setColor(15);
-                    return false;
-                }
-            }
+            for (size_t i = 0; i < plan.target.size(); i++)
+                newRow[plan.target[i]] = values[i];
         }
 
-        for (size_t i = 0; i < table.columns.size(); i++)
+        string err;
+        if (!prepareInsertRow(table, newRow, err))
         {
-            if (i >= newRow.size() || trim(newRow[i]).empty())
-            {
-                string typeUpper = table.types[i];
-                transform(typeUpper.begin(), typeUpper.end(), typeUpper.begin(), ::toupper);
-
-                if (typeUpper == "INT" || typeUpper == "FLOAT")
-                {
-                    newRow[i] = "0";  
-                }
-                else if (typeUpper == "STRING")
-                {
-                    newRow[i] = "NULL"; 
-                }
-                else
-                {
-                    newRow[i] = "NULL";
-                }
-            }
+            setColor(12);
+            cout << "Error: " << err << " (row " << (insertedCount + 1) << ").\n";
+            setColor(15);
+            return false;
         }
 
         if (table.primaryKeyIndex != -1)
         {
-            if (table.primaryKeyIndex >= (int)newRow.size() || trim(newRow[table.primaryKeyIndex]).empty())
-            {
-                setColor(12);
-                cout << "Error: PRIMARY KEY column '" << table.columns[table.primaryKeyIndex]
-                    << "' cannot be NULL (row " << (insertedCount + 1) << ").\n";
-                setColor(15);
-                return false;
-            }
-
-            string pkValue = trim(newRow[table.primaryKeyIndex]);
-            if (existingPKValues.find(pkValue) != existingPKValues.end())
+            string pkValue = canonicalValue(table.types[table.primaryKeyIndex], trim(newRow[table.primaryKeyIndex]));
+            string key;
+            uint64_t location;
+            pkIndex.encodeKey(pkValue, key);
+            if (newPKValues.count(pkValue) || pkIndex.find(key, location))
             {
                 setColor(12);
                 cout << "Error: Duplicate PRIMARY KEY value '" << pkValue << "' in column '"
@@ -351,31 +191,40 @@ bool executeInsert(const InsertQuery& iq)
                 return false;
             }
 
-            existingPKValues.insert(pkValue);
+            newPKValues.insert(pkValue);
         }
 
-        for (size_t i = 0; i < table.columns.size(); i++)
-        {
-            if (i < table.lengths.size() && table.lengths[i] != -1)
-            {
-                if (i < newRow.size() && (int)newRow[i].length() > table.lengths[i])
-                {
-                    setColor(12);
-                    cout << "Error: Value '" << newRow[i] << "' exceeds maximum length "
-                        << table.lengths[i] << " for column '" << table.columns[i]
-                        << "' (row " << (insertedCount + 1) << ").\n";
-                    setColor(15);
-                    return false;
-                }
-            }
-        }
-
-        table.rows.push_back(newRow);
+        newRows.push_back(newRow);
         insertedCount++;
     }
 
-    if (!writeTable(iq.tableName, table))
+    vector<uint64_t> locations;
+    uint64_t tableBytesBefore = tableFileSize(plan.tableName);
+    TableBlock tail;
+    if (!readTableTail(plan.tableName, table, tail) || !walLogInsert(plan.tableName, tableBytesBefore, tail.rowCount, newRows))
+        return false;
+    if (!appendTableRows(plan.tableName, table, newRows, &locations))
         return false;
+    bool durable = stampTableLsn(plan.tableName, walLastLsn());
+
+    if (table.primaryKeyIndex != -1)
+    {
+        string key;
+        for (size_t i = 0; i < newRows.size(); i++)
+        {
+            pkIndex.encodeKey(newRows[i][table.primaryKeyIndex], key);
+            pkIndex.insert(key, locations[i]);
+        }
+        pkIndex.setSyncedTableBytes(tableFileSize(plan.tableName));
+    }
+    indexAppendedRows(plan.tableName, table, newRows, locations, tableBytesBefore);
+    if (!durable)
+    {
+        setColor(12);
+        cout << "Error: Cannot force table '" << plan.tableName << "' to disk.\n";
+        setColor(15);
+        return false;
+    }
 
     setColor(10);
     cout << insertedCount << " row(s) inserted successfully.\n";
@@ -384,12 +233,8 @@ bool executeInsert(const InsertQuery& iq)
     return true;
 }
 
-void handleInsert(const string& query)
+bool executeInsert(const InsertQuery& iq)
 {
-    InsertQuery iq = parseInsertQuery(query);
-
-    if (iq.tableName.empty())
-        return;
-
-    executeInsert(iq);
-}
\ No newline at end of file
+    InsertPlan plan;
+    return planInsert(iq, plan) && runInsert(plan);
+}
@@ -1,15 +1,26 @@
 #pragma once
 #include <string>
+#include <vector>
+#include "utils.h"
+#include "parser.h"
 using namespace std;
 
-struct InsertQuery
+// Fills in defaults for empty values, checks the row against the table's
+// constraints and types, and puts each value into its stored form. Rows
+// must have one value per column; err does not name the row.
+bool prepareInsertRow(const TableData& table, vector<string>& row, string& err);
+
+// An INSERT with its table and column list resolved, so it can run again
+// with other values (see Prepare.h).
+struct InsertPlan
 {
     string tableName;
-    vector<string> columns;            
-    vector<vector<string>> valuesList;  
-    bool hasColumns;                  
+    TableData table;
+    bool hasColumns = false;
+    vector<int> target;                 // column of each value, with a column list
+    vector<vector<string>> valuesList;
 };
 
-InsertQuery parseInsertQuery(const string& query);
+bool planInsert(const InsertQuery& iq, InsertPlan& plan);
+bool runInsert(const InsertPlan& plan);
 bool executeInsert(const InsertQuery& iq);
-void handleInsert(const string& query);
@@ -0,0 +1,85 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include "join.h"
+#include "parallelscan.h"
+using namespace std;
+
+static bool isNumeric(ColType type)
+{
+    return type == COL_INT || type == COL_FLOAT || type == COL_DOUBLE;
+}
+
+bool joinKeyType(ColType left, ColType right, ColType& keyType)
+{
+    if (isNumeric(left) != isNumeric(right))
+        return false;
+    keyType = !isNumeric(left) ? COL_VARCHAR : left == COL_INT && right == COL_INT ? COL_INT : COL_DOUBLE;
+    return true;
+}
+
+bool HashJoin::build(const TableScanner& scan, int keyColumn, const Filter* filter)
+{
+    // Every morsel reads its rows on its own; they are appended in table order.
+    struct Part
+    {
+        vector<vector<string>> rows;
+        string keys;
+        vector<size_t> keyEnds;
+    };
+    vector<unique_ptr<Part>> parts(scan.morsels(SCAN_MORSEL_ROWS).size());
+    size_t columns = scan.schema().columns.size();
+
+    rows.clear();
+    keys.clear();
+    keyStarts.assign(1, 0);
+    parallelScan(scan, filter,
+        [&](TableScanner& cursor, size_t m) {
+            parts[m] = make_unique<Part>();
+            Part& part = *parts[m];
+            CursorRow row{ cursor };
+            string key;
+            while (cursor.next())
+            {
+                if (row.isNull(keyColumn))
+                    continue;
+                vector<string> values(columns);
+                for (size_t c = 0; c < columns; c++)
+                    values[c] = cursor.field((int)c);
+                part.rows.push_back(move(values));
+                encodeKey(key, row, keyColumn);
+                part.keys += key;
+                part.keyEnds.push_back(part.keys.size());
+            }
+        },
+        [&](size_t m) {
+            Part& part = *parts[m];
+            size_t base = keys.size();
+            keys += part.keys;
+            for (size_t end : part.keyEnds)
+                keyStarts.push_back(base + end);
+            for (auto& r : part.rows)
+                rows.push_back(move(r));
+            parts[m].reset();
+        });
+
+    if (rows.size() >= JOIN_NO_ROW)
+        return false;
+
+    size_t buckets = 16;
+    while (buckets < rows.size() * 2)
+        buckets *= 2;
+    heads.assign(buckets, JOIN_NO_ROW);
+    next.assign(rows.size(), JOIN_NO_ROW);
+    hashes.resize(rows.size());
+    // Inserted back to front, so each chain lists its rows in table order.
+    for (size_t r = rows.size(); r-- > 0;)
+    {
+        string_view k = keyOf((uint32_t)r);
+        hashes[r] = hashKey(k.data(), k.size());
+        uint32_t& head = heads[hashes[r] & (buckets - 1)];
+        next[r] = head;
+        head = (uint32_t)r;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef JOIN_H
+#define JOIN_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+#include "tablescanner.h"
+#include "filter.h"
+#include "rowview.h"
+#include "aggregate.h"
+using namespace std;
+
+// Hash join for SELECT ... FROM a JOIN b ON a.x = b.y.
+//
+// The table with fewer rows is the build side: a parallel scan reads its rows
+// (those passing a WHERE on that table) as text and hashes them on their join
+// key. The table is bucket-chained over flat arrays: a power-of-two array of
+// chain heads and, per row, the next row of its chain and the full key hash,
+// which is compared before the key itself. The other table is then streamed
+// through a parallel scan of its own, and every morsel probes the table with
+// the key of each of its rows.
+//
+// Keys are compared in one domain for both sides: as integers when both
+// columns are INT, as doubles when both are numeric and as bytes when both
+// are strings. NULL keys match nothing.
+
+const uint32_t JOIN_NO_ROW = UINT32_MAX;
+
+class HashJoin
+{
+public:
+    // Comparison domain: COL_INT, COL_DOUBLE or COL_VARCHAR.
+    explicit HashJoin(ColType keyType) : keyType(keyType) {}
+
+    bool build(const TableScanner& scan, int keyColumn, const Filter* filter);
+    uint64_t buildRows() const { return rows.size(); }
+
+    // Calls emit(buildRow) for every build row whose key matches column
+    // keyColumn of the cursor's current row. key is scratch space.
+    template <class Emit>
+    void probe(TableScanner& cursor, int keyColumn, string& key, Emit&& emit) const
+    {
+        CursorRow row{ cursor };
+        if (heads.empty() || row.isNull(keyColumn))
+            return;
+        encodeKey(key, row, keyColumn);
+        uint64_t hash = hashKey(key.data(), key.size());
+        for (uint32_t r = heads[hash & (heads.size() - 1)]; r != JOIN_NO_ROW; r = next[r])
+            if (hashes[r] == hash && keyOf(r) == key)
+                emit(rows[r]);
+    }
+
+private:
+    ColType keyType;
+    vector<vector<string>> rows;
+    string keys;                // keys of the rows, end to end
+    vector<size_t> keyStarts;   // rows.size() + 1 entries
+    vector<uint64_t> hashes;
+    vector<uint32_t> heads;
+    vector<uint32_t> next;
+
+    string_view keyOf(uint32_t r) const
+    {
+        return string_view(keys).substr(keyStarts[r], keyStarts[r + 1] - keyStarts[r]);
+    }
+    template <class Row>
+    void encodeKey(string& key, Row& row, int col) const
+    {
+        key.clear();
+        if (keyType == COL_INT) {
+            int64_t v = row.integer(col);
+            key.append((const char*)&v, sizeof v);
+        }
+        else if (keyType == COL_DOUBLE) {
+            double v = row.real(col);
+            if (v == 0)
+                v = 0;      // -0.0 joins with 0.0
+            key.append((const char*)&v, sizeof v);
+        }
+        else {
+            string_view s = row.text(col);
+            key.append(s.data(), s.size());
+        }
+    }
+};
+
+// The domain two join columns are compared in, or false if they cannot be.
+bool joinKeyType(ColType left, ColType right, ColType& keyType);
+
+#endif
@@ -0,0 +1,147 @@
+#include <string>
+#include <cctype>
+#include "lexer.h"
+using namespace std;
+
+static bool isWordStart(char c) { return isalpha((unsigned char)c) || c == '_'; }
+static bool isWordChar(char c) { return isalnum((unsigned char)c) || c == '_'; }
+static bool isDigit(char c) { return isdigit((unsigned char)c) != 0; }
+
+bool Lexer::next(Token& token, string& err)
+{
+    while (at < sql.size())
+    {
+        if (isspace((unsigned char)sql[at]))
+            at++;
+        else if (sql[at] == '-' && at + 1 < sql.size() && sql[at + 1] == '-') {
+            while (at < sql.size() && sql[at] != '\n')
+                at++;
+        }
+        else
+            break;
+    }
+
+    token.pos = at;
+    if (at >= sql.size()) {
+        token.type = TOK_END;
+        token.text = string_view();
+        return true;
+    }
+
+    size_t start = at;
+    char c = sql[at];
+    if (isWordStart(c))
+    {
+        while (at < sql.size() && isWordChar(sql[at]))
+            at++;
+        token.type = TOK_WORD;
+    }
+    else if (isDigit(c) || ((c == '-' || c == '+' || c == '.') && at + 1 < sql.size()
+        && (isDigit(sql[at + 1]) || (sql[at + 1] == '.' && at + 2 < sql.size() && isDigit(sql[at + 2])))))
+    {
+        if (c == '-' || c == '+')
+            at++;
+        while (at < sql.size() && isDigit(sql[at]))
+            at++;
+        if (at < sql.size() && sql[at] == '.') {
+            at++;
+            while (at < sql.size() && isDigit(sql[at]))
+                at++;
+        }
+        if (at < sql.size() && (sql[at] == 'e' || sql[at] == 'E')) {
+            size_t exp = at + 1;
+            if (exp < sql.size() && (sql[exp] == '-' || sql[exp] == '+'))
+                exp++;
+            if (exp < sql.size() && isDigit(sql[exp])) {
+                at = exp;
+                while (at < sql.size() && isDigit(sql[at]))
+                    at++;
+            }
+        }
+        token.type = TOK_NUMBER;
+    }
+    else if (c == '\'' || c == '"')
+    {
+        at++;
+        while (true)
+        {
+            if (at >= sql.size()) {
+                err = "Unterminated string starting at position " + to_string(start + 1);
+                return false;
+            }
+            if (sql[at] == c) {
+                if (at + 1 < sql.size() && sql[at + 1] == c) {
+                    at += 2;
+                    continue;
+                }
+                at++;
+                break;
+            }
+            at++;
+        }
+        token.type = TOK_STRING;
+    }
+    else
+    {
+        static const char* pairs[] = { "!=", "<>", "<=", ">=" };
+        token.type = TOK_SYMBOL;
+        at++;
+        for (const char* p : pairs)
+            if (c == p[0] && at < sql.size() && sql[at] == p[1]) {
+                at++;
+                break;
+            }
+    }
+
+    token.text = sql.substr(start, at - start);
+    return true;
+}
+
+bool tokenize(string_view sql, vector<Token>& tokens, string& err)
+{
+    Lexer lexer(sql);
+    tokens.clear();
+    Token token;
+    do {
+        if (!lexer.next(token, err))
+            return false;
+        tokens.push_back(token);
+    } while (token.type != TOK_END);
+    return true;
+}
+
+bool isKeyword(const Token& token, const char* keyword)
+{
+    if (token.type != TOK_WORD)
+        return false;
+    size_t i = 0;
+    for (; i < token.text.size(); i++)
+        if (keyword[i] == '\0' || toupper((unsigned char)token.text[i]) != keyword[i])
+            return false;
+    return keyword[i] == '\0';
+}
+
+string tokenValue(const Token& token)
+{
+    if (token.type != TOK_STRING)
+        return string(token.text);
+
+    char quote = token.text.front();
+    string value;
+    value.reserve(token.text.size() - 2);
+    for (size_t i = 1; i + 1 < token.text.size(); i++)
+    {
+        value += token.text[i];
+        if (token.text[i] == quote)
+            i++;
+    }
+    return value;
+}
+
+string upperWord(string_view word)
+{
+    string upper(word);
+    for (auto& c : upper)
+        c = (char)toupper((unsigned char)c);
+    return upper;
+}
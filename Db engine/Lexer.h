@@ -0,0 +1,58 @@
+#pragma once
+#ifndef LEXER_H
+#define LEXER_H
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+// Splits a statement into tokens that point into the statement text, so
+// lexing copies nothing. Keywords are not special here: they are words that
+// the parser compares case-insensitively, which is why a column named FROMAGE
+// or a value containing WHERE is just another token.
+//
+//   words    : letters, digits and '_', not starting with a digit
+//   numbers  : an optional sign, digits, an optional fraction and exponent
+//   strings  : '...' or "...", a doubled quote standing for one quote
+//   symbols  : != <> <= >= and any other single character
+//
+// Text after "--" is a comment.
+
+enum TokenType
+{
+    TOK_END,
+    TOK_WORD,
+    TOK_NUMBER,
+    TOK_STRING,
+    TOK_SYMBOL
+};
+
+struct Token
+{
+    TokenType type = TOK_END;
+    string_view text;       // quotes included for strings
+    size_t pos = 0;         // offset in the statement
+};
+
+class Lexer
+{
+public:
+    explicit Lexer(string_view sql) : sql(sql) {}
+
+    // Returns false with err set on an unterminated string.
+    bool next(Token& token, string& err);
+
+private:
+    string_view sql;
+    size_t at = 0;
+};
+
+bool tokenize(string_view sql, vector<Token>& tokens, string& err);
+
+// Case-insensitive comparison of a word token with an upper-case keyword.
+bool isKeyword(const Token& token, const char* keyword);
+// Literal text of a token: a string without its quotes, anything else as is.
+string tokenValue(const Token& token);
+string upperWord(string_view word);
+
+#endif
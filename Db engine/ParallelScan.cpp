@@ -0,0 +1,28 @@
+#include <vector>
+#include <algorithm>
+#include "parallelscan.h"
+#include "threadpool.h"
+using namespace std;
+
+void parallelScan(const TableScanner& scan, const Filter* filter,
+    const function<void(TableScanner& cursor, size_t morsel)>& work,
+    const function<void(size_t morsel)>& merge)
+{
+    vector<ScanMorsel> morsels = scan.morsels(SCAN_MORSEL_ROWS);
+    ThreadPool& pool = ThreadPool::instance();
+    size_t wave = pool.size() * SCAN_MORSELS_PER_THREAD;
+
+    for (size_t first = 0; first < morsels.size(); first += wave)
+    {
+        size_t count = min(wave, morsels.size() - first);
+        pool.parallelFor(count, [&](size_t i) {
+            TableScanner cursor;
+            if (!cursor.openMorsel(scan, morsels[first + i]))
+                return;
+            cursor.setFilter(filter);
+            work(cursor, first + i);
+        });
+        for (size_t i = 0; i < count; i++)
+            merge(first + i);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#ifndef PARALLELSCAN_H
+#define PARALLELSCAN_H
+#include <functional>
+#include <cstdint>
+#include "tablescanner.h"
+#include "filter.h"
+using namespace std;
+
+// Morsel-driven scan of an open TableScanner. The table is cut into morsels
+// of SCAN_MORSEL_ROWS rows and each one is handed, through its own filtered
+// cursor, to work() on the thread pool; work() writes its output into a
+// per-morsel slot owned by the caller. Morsels run in waves of a few per
+// thread, and after each wave merge() is called on the calling thread for
+// every morsel of the wave in table order, so results come out in the same
+// order as a serial scan while only one wave is buffered at a time.
+
+const uint32_t SCAN_MORSEL_ROWS = 16384;
+const size_t SCAN_MORSELS_PER_THREAD = 4;
+
+void parallelScan(const TableScanner& scan, const Filter* filter,
+    const function<void(TableScanner& cursor, size_t morsel)>& work,
+    const function<void(size_t morsel)>& merge);
+
+#endif
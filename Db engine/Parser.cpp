@@ -0,0 +1,770 @@
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <charconv>
+#include <cctype>
+#include "parser.h"
+#include "lexer.h"
+using namespace std;
+
+class Parser
+{
+public:
+    Parser(string_view sql, const vector<Token>& tokens) : sql(sql), tokens(tokens) {}
+
+    bool parse(Statement& stmt, string& err);
+
+private:
+    string_view sql;
+    const vector<Token>& tokens;
+    size_t at = 0;
+    string error;
+    Statement* current = nullptr;   // the statement ? parameters belong to, in a PREPARE
+    bool inCondition = false;
+    size_t leaves = 0;              // comparisons of the current condition
+
+    const Token& peek() const { return tokens[at]; }
+    bool atEnd() const { return tokens[at].type == TOK_END; }
+    bool isSymbol(const char* symbol) const { return tokens[at].type == TOK_SYMBOL && tokens[at].text == symbol; }
+
+    bool fail(const string& what);
+    bool acceptKeyword(const char* keyword);
+    bool expectKeyword(const char* keyword);
+    bool acceptSymbol(const char* symbol);
+    bool expectSymbol(const char* symbol);
+    bool name(string& out, const char* what);
+    bool columnRef(string& out, const char* what);
+    bool count(uint64_t& out);
+    bool value(string& out, const Parameter* param = nullptr);
+    bool where(bool& hasWhere, Condition& c);
+    bool condition(Condition& c);
+    bool conjunction(Condition& c);
+    bool factor(Condition& c);
+    bool comparison(Condition& c);
+    bool inList(Condition& c);
+    bool end();
+
+    bool statement(Statement& stmt);
+
+    bool selectItem(SelectItem& item);
+    bool select(SelectQuery& q);
+    bool insert(InsertQuery& q);
+    bool update(UpdateQuery& q);
+    bool remove(DeleteQuery& q);
+    bool create(CreateQuery& q);
+    bool columnDef(ColumnDef& col);
+    bool drop(DropQuery& q);
+    bool prepare(PrepareQuery& q);
+    bool execute(ExecuteQuery& q);
+    bool deallocate(DeallocateQuery& q);
+    bool createIndex(CreateIndexQuery& q);
+    bool dropIndex(DropIndexQuery& q);
+    bool copy(CopyQuery& q);
+    bool set(SetQuery& q);
+    bool benchmark(BenchmarkQuery& q);
+};
+
+bool Parser::fail(const string& what)
+{
+    if (error.empty())
+        error = atEnd() ? what + " at end of statement"
+                        : what + " near '" + string(peek().text) + "'";
+    return false;
+}
+
+bool Parser::acceptKeyword(const char* keyword)
+{
+    if (!isKeyword(peek(), keyword))
+        return false;
+    at++;
+    return true;
+}
+
+bool Parser::expectKeyword(const char* keyword)
+{
+    return acceptKeyword(keyword) || fail(string("Expected ") + keyword);
+}
+
+bool Parser::acceptSymbol(const char* symbol)
+{
+    if (!isSymbol(symbol))
+        return false;
+    at++;
+    return true;
+}
+
+bool Parser::expectSymbol(const char* symbol)
+{
+    return acceptSymbol(symbol) || fail(string("Expected '") + symbol + "'");
+}
+
+bool Parser::name(string& out, const char* what)
+{
+    if (peek().type != TOK_WORD)
+        return fail(string("Expected ") + what);
+    out = string(peek().text);
+    at++;
+    return true;
+}
+
+// A column name, possibly qualified with a table name.
+bool Parser::columnRef(string& out, const char* what)
+{
+    if (!name(out, what))
+        return false;
+    string column;
+    if (acceptSymbol(".")) {
+        if (!name(column, "a column name"))
+            return false;
+        out += "." + column;
+    }
+    return true;
+}
+
+bool Parser::count(uint64_t& out)
+{
+    string_view digits = peek().text;
+    if (peek().type != TOK_NUMBER
+        || from_chars(digits.data(), digits.data() + digits.size(), out).ptr != digits.data() + digits.size())
+        return fail("Expected a row count");
+    at++;
+    return true;
+}
+
+static bool endsValue(const Token& token, bool inCondition)
+{
+    if (token.type == TOK_END)
+        return true;
+    if (token.type == TOK_WORD)
+        return isKeyword(token, "WHERE") || isKeyword(token, "GROUP") || isKeyword(token, "ORDER")
+            || isKeyword(token, "LIMIT") || (inCondition && (isKeyword(token, "AND") || isKeyword(token, "OR")));
+    if (token.type != TOK_SYMBOL)
+        return false;
+    static const char* stops[] = { "(", ")", ",", ";", "*", "=", "!=", "<>", "<", "<=", ">", ">=" };
+    for (const char* s : stops)
+        if (token.text == s)
+            return true;
+    return false;
+}
+
+// A quoted string, or the source text of a run of unquoted tokens, so that
+// unquoted values such as 2024-01-31 or John Smith read as typed. Where a
+// parameter may stand, param says where it goes.
+bool Parser::value(string& out, const Parameter* param)
+{
+    if (isSymbol("?")) {
+        if (!param || !current)
+            return fail("Parameters are only allowed in PREPARE");
+        current->params.push_back(*param);
+        out = "?";
+        at++;
+        return true;
+    }
+    if (peek().type == TOK_STRING) {
+        out = tokenValue(peek());
+        at++;
+        return true;
+    }
+    if (endsValue(peek(), inCondition))
+        return fail("Expected a value");
+
+    size_t first = at;
+    while (!endsValue(peek(), inCondition) && peek().type != TOK_STRING && !isSymbol("?"))
+        at++;
+    const Token& last = tokens[at - 1];
+    out = string(sql.substr(tokens[first].pos, last.pos + last.text.size() - tokens[first].pos));
+    return true;
+}
+
+bool Parser::where(bool& hasWhere, Condition& c)
+{
+    if (!acceptKeyword("WHERE"))
+        return true;
+    hasWhere = true;
+    leaves = 0;
+    inCondition = true;
+    bool ok = condition(c);
+    inCondition = false;
+    return ok;
+}
+
+// Appends operand to c, a kind node, merging nested nodes of the same kind.
+static void addOperand(Condition& c, ConditionKind kind, Condition&& operand)
+{
+    if (c.kind != kind) {
+        Condition node;
+        node.kind = kind;
+        node.operands.push_back(move(c));
+        c = move(node);
+    }
+    if (operand.kind == kind)
+        for (auto& o : operand.operands)
+            c.operands.push_back(move(o));
+    else
+        c.operands.push_back(move(operand));
+}
+
+bool Parser::condition(Condition& c)
+{
+    if (!conjunction(c))
+        return false;
+    while (acceptKeyword("OR")) {
+        Condition next;
+        if (!conjunction(next))
+            return false;
+        addOperand(c, COND_OR, move(next));
+    }
+    return true;
+}
+
+bool Parser::conjunction(Condition& c)
+{
+    if (!factor(c))
+        return false;
+    while (acceptKeyword("AND")) {
+        Condition next;
+        if (!factor(next))
+            return false;
+        addOperand(c, COND_AND, move(next));
+    }
+    return true;
+}
+
+bool Parser::factor(Condition& c)
+{
+    if (acceptKeyword("NOT")) {
+        c.kind = COND_NOT;
+        c.operands.resize(1);
+        return factor(c.operands[0]);
+    }
+    if (acceptSymbol("("))
+        return condition(c) && expectSymbol(")");
+    return comparison(c);
+}
+
+bool Parser::comparison(Condition& c)
+{
+    c.kind = COND_COMPARE;
+    if (!columnRef(c.column, "a column name"))
+        return false;
+
+    if (isKeyword(peek(), "IN") || (isKeyword(peek(), "NOT") && isKeyword(tokens[at + 1], "IN")))
+        return inList(c);
+
+    static const char* ops[] = { "=", "!=", "<>", "<", "<=", ">", ">=" };
+    c.op.clear();
+    for (const char* o : ops)
+        if (isSymbol(o))
+            c.op = o;
+    if (c.op.empty())
+        return fail("Expected an operator (=, !=, <, <=, >, >=)");
+    if (c.op == "<>")
+        c.op = "!=";
+    at++;
+    c.leaf = leaves++;
+    Parameter param;
+    param.target = PARAM_WHERE_VALUE;
+    param.position = c.leaf;
+    return value(c.value, &param);
+}
+
+// col [NOT] IN (value, ...), after the column: the OR of an = comparison
+// per value, under a NOT for NOT IN.
+bool Parser::inList(Condition& c)
+{
+    bool negated = acceptKeyword("NOT");
+    if (!expectKeyword("IN") || !expectSymbol("("))
+        return false;
+    Condition list;
+    size_t first = leaves;
+    do {
+        Condition equal;
+        equal.column = c.column;
+        equal.op = "=";
+        equal.leaf = leaves++;
+        Parameter param;
+        param.target = PARAM_WHERE_VALUE;
+        param.position = equal.leaf;
+        if (!value(equal.value, &param))
+            return false;
+        if (equal.leaf == first)
+            list = move(equal);
+        else
+            addOperand(list, COND_OR, move(equal));
+    } while (acceptSymbol(","));
+    if (!expectSymbol(")"))
+        return false;
+
+    if (negated) {
+        c = Condition();
+        c.kind = COND_NOT;
+        c.operands.push_back(move(list));
+    }
+    else
+        c = move(list);
+    return true;
+}
+
+bool Parser::end()
+{
+    acceptSymbol(";");
+    return atEnd() || fail("Unexpected text");
+}
+
+bool Parser::selectItem(SelectItem& item)
+{
+    static const pair<const char*, AggregateKind> functions[] = {
+        { "COUNT", AGG_COUNT }, { "SUM", AGG_SUM }, { "AVG", AGG_AVG }, { "MIN", AGG_MIN }, { "MAX", AGG_MAX } };
+
+    item = SelectItem();
+    if (!atEnd() && tokens[at + 1].type == TOK_SYMBOL && tokens[at + 1].text == "(")
+    {
+        for (auto& f : functions)
+            if (isKeyword(peek(), f.first))
+                item.aggregate = f.second;
+        if (item.aggregate == AGG_NONE)
+            return fail("Unknown function");
+        at += 2;
+        if (item.aggregate == AGG_COUNT && acceptSymbol("*"))
+            item.column = "*";
+        else if (!columnRef(item.column, "a column name"))
+            return false;
+        return expectSymbol(")");
+    }
+    return columnRef(item.column, "a column name or *");
+}
+
+bool Parser::select(SelectQuery& q)
+{
+    if (isKeyword(peek(), "FROM"))
+        return fail("Expected a column name or *");
+    if (!acceptSymbol("*"))
+    {
+        do {
+            SelectItem item;
+            if (!selectItem(item))
+                return false;
+            q.items.push_back(item);
+        } while (acceptSymbol(","));
+    }
+
+    if (!expectKeyword("FROM") || !name(q.tableName, "a table name"))
+        return false;
+    bool inner = acceptKeyword("INNER");
+    if (inner ? expectKeyword("JOIN") : acceptKeyword("JOIN"))
+    {
+        q.hasJoin = true;
+        if (!name(q.joinTable, "a table name") || !expectKeyword("ON") || !columnRef(q.joinLeft, "a column name")
+            || !expectSymbol("=") || !columnRef(q.joinRight, "a column name"))
+            return false;
+    }
+    else if (inner)
+        return false;
+    if (!where(q.hasWhere, q.where))
+        return false;
+    if (acceptKeyword("GROUP"))
+    {
+        if (!expectKeyword("BY"))
+            return false;
+        do {
+            string column;
+            if (!columnRef(column, "a column name"))
+                return false;
+            q.groupBy.push_back(column);
+        } while (acceptSymbol(","));
+    }
+    if (acceptKeyword("ORDER"))
+    {
+        if (!expectKeyword("BY"))
+            return false;
+        do {
+            OrderItem order;
+            if (!selectItem(order.item))
+                return false;
+            if (acceptKeyword("DESC"))
+                order.descending = true;
+            else
+                acceptKeyword("ASC");
+            q.orderBy.push_back(order);
+        } while (acceptSymbol(","));
+    }
+    if (acceptKeyword("LIMIT"))
+    {
+        q.hasLimit = true;
+        if (!count(q.limit) || (acceptKeyword("OFFSET") && !count(q.offset)))
+            return false;
+    }
+    return end();
+}
+
+bool Parser::insert(InsertQuery& q)
+{
+    if (!expectKeyword("INTO") || !name(q.tableName, "a table name"))
+        return false;
+
+    if (acceptSymbol("("))
+    {
+        q.hasColumns = true;
+        do {
+            string column;
+            if (!name(column, "a column name"))
+                return false;
+            q.columns.push_back(column);
+        } while (acceptSymbol(","));
+        if (!expectSymbol(")"))
+            return false;
+    }
+
+    if (!expectKeyword("VALUES"))
+        return false;
+    do {
+        if (!expectSymbol("("))
+            return false;
+        vector<string> values;
+        do {
+            string v;
+            Parameter param;
+            param.target = PARAM_INSERT_VALUE;
+            param.row = q.valuesList.size();
+            param.position = values.size();
+            if (!isSymbol(",") && !isSymbol(")") && !value(v, &param))
+                return false;
+            values.push_back(v);
+        } while (acceptSymbol(","));
+        if (!expectSymbol(")"))
+            return false;
+        q.valuesList.push_back(move(values));
+    } while (acceptSymbol(","));
+    return end();
+}
+
+bool Parser::update(UpdateQuery& q)
+{
+    if (!name(q.tableName, "a table name") || !expectKeyword("SET"))
+        return false;
+
+    do {
+        string column, v;
+        Parameter param;
+        param.target = PARAM_SET_VALUE;
+        if (!name(column, "a column name") || !expectSymbol("="))
+            return false;
+        param.column = column;
+        if (!value(v, &param))
+            return false;
+        q.setValues[column] = v;
+    } while (acceptSymbol(","));
+
+    if (!where(q.hasWhere, q.where))
+        return false;
+    return end();
+}
+
+bool Parser::remove(DeleteQuery& q)
+{
+    acceptSymbol("*");
+    if (!expectKeyword("FROM") || !name(q.tableName, "a table name"))
+        return false;
+    if (!where(q.hasWhere, q.where))
+        return false;
+    return end();
+}
+
+bool Parser::columnDef(ColumnDef& col)
+{
+    col = { "", "", -1, false, false };
+    if (!name(col.name, "a column name") || !name(col.type, "a column type"))
+        return false;
+    col.type = upperWord(col.type);
+
+    if (acceptSymbol("("))
+    {
+        string_view digits = peek().text;
+        if (peek().type != TOK_NUMBER
+            || from_chars(digits.data(), digits.data() + digits.size(), col.length).ptr != digits.data() + digits.size())
+            return fail("Expected a size");
+        at++;
+        if (!expectSymbol(")"))
+            return false;
+    }
+
+    while (!isSymbol(",") && !isSymbol(")"))
+    {
+        if (acceptKeyword("PRIMARY")) {
+            if (!expectKeyword("KEY"))
+                return false;
+            col.isPK = true;
+        }
+        else if (acceptKeyword("NOT")) {
+            if (!expectKeyword("NULL"))
+                return false;
+            col.isNN = true;
+        }
+        else
+            return fail("Unknown token in definition of column '" + col.name + "'");
+    }
+    return true;
+}
+
+bool Parser::create(CreateQuery& q)
+{
+    if (!name(q.tableName, "a table name") || !expectSymbol("("))
+        return false;
+    do {
+        ColumnDef col;
+        if (!columnDef(col))
+            return false;
+        q.columns.push_back(col);
+    } while (acceptSymbol(","));
+    return expectSymbol(")") && end();
+}
+
+bool Parser::drop(DropQuery& q)
+{
+    return name(q.tableName, "a table name") && end();
+}
+
+bool Parser::prepare(PrepareQuery& q)
+{
+    if (!name(q.name, "a statement name") || !expectKeyword("AS"))
+        return false;
+    if (!isKeyword(peek(), "SELECT") && !isKeyword(peek(), "INSERT") && !isKeyword(peek(), "UPDATE")
+        && !isKeyword(peek(), "DELETE"))
+        return fail("Expected SELECT, INSERT, UPDATE or DELETE");
+
+    auto body = make_shared<Statement>();
+    current = body.get();
+    bool ok = statement(*body);
+    current = nullptr;
+    q.body = body;
+    return ok;
+}
+
+bool Parser::execute(ExecuteQuery& q)
+{
+    if (!name(q.name, "a statement name"))
+        return false;
+    if (acceptSymbol("(") && !acceptSymbol(")"))
+    {
+        do {
+            string v;
+            if (!isSymbol(",") && !isSymbol(")") && !value(v))
+                return false;
+            q.values.push_back(v);
+        } while (acceptSymbol(","));
+        if (!expectSymbol(")"))
+            return false;
+    }
+    return end();
+}
+
+bool Parser::deallocate(DeallocateQuery& q)
+{
+    acceptKeyword("PREPARE");
+    return name(q.name, "a statement name") && end();
+}
+
+bool Parser::createIndex(CreateIndexQuery& q)
+{
+    return name(q.name, "an index name") && expectKeyword("ON") && name(q.tableName, "a table name")
+        && expectSymbol("(") && name(q.column, "a column name") && expectSymbol(")") && end();
+}
+
+bool Parser::dropIndex(DropIndexQuery& q)
+{
+    if (!name(q.name, "an index name"))
+        return false;
+    if (acceptKeyword("ON") && !name(q.tableName, "a table name"))
+        return false;
+    return end();
+}
+
+bool Parser::copy(CopyQuery& q)
+{
+    if (!name(q.tableName, "a table name") || !expectKeyword("FROM"))
+        return false;
+    if (peek().type != TOK_STRING)
+        return fail("Expected a quoted file name");
+    q.path = tokenValue(peek());
+    at++;
+    q.header = acceptKeyword("HEADER");
+    return end();
+}
+
+bool Parser::set(SetQuery& q)
+{
+    if (!name(q.name, "a setting name") || !expectSymbol("="))
+        return false;
+    q.name = upperWord(q.name);
+    return value(q.value) && end();
+}
+
+bool Parser::benchmark(BenchmarkQuery& q)
+{
+    if (!expectKeyword("FILTER"))
+        return false;
+    if (peek().type == TOK_NUMBER) {
+        size_t number = at;
+        if (!count(q.rows))
+            return false;
+        if (q.rows == 0) {
+            at = number;
+            return fail("Expected a row count");
+        }
+    }
+    return end();
+}
+
+bool Parser::statement(Statement& stmt)
+{
+    if (acceptKeyword("SELECT")) {
+        stmt.kind = STMT_SELECT;
+        return select(stmt.select);
+    }
+    if (acceptKeyword("INSERT")) {
+        stmt.kind = STMT_INSERT;
+        return insert(stmt.insert);
+    }
+    if (acceptKeyword("UPDATE")) {
+        stmt.kind = STMT_UPDATE;
+        return update(stmt.update);
+    }
+    if (acceptKeyword("DELETE")) {
+        stmt.kind = STMT_DELETE;
+        return remove(stmt.remove);
+    }
+    if (acceptKeyword("CREATE")) {
+        if (acceptKeyword("INDEX")) {
+            stmt.kind = STMT_CREATE_INDEX;
+            return createIndex(stmt.createIndex);
+        }
+        stmt.kind = STMT_CREATE_TABLE;
+        return (acceptKeyword("TABLE") || fail("Expected TABLE or INDEX")) && create(stmt.create);
+    }
+    if (acceptKeyword("DROP")) {
+        if (acceptKeyword("INDEX")) {
+            stmt.kind = STMT_DROP_INDEX;
+            return dropIndex(stmt.dropIndex);
+        }
+        stmt.kind = STMT_DROP_TABLE;
+        return (acceptKeyword("TABLE") || fail("Expected TABLE or INDEX")) && drop(stmt.drop);
+    }
+    if (acceptKeyword("PREPARE")) {
+        stmt.kind = STMT_PREPARE;
+        return prepare(stmt.prepare);
+    }
+    if (acceptKeyword("EXECUTE")) {
+        stmt.kind = STMT_EXECUTE;
+        return execute(stmt.execute);
+    }
+    if (acceptKeyword("DEALLOCATE")) {
+        stmt.kind = STMT_DEALLOCATE;
+        return deallocate(stmt.deallocate);
+    }
+    if (acceptKeyword("COPY")) {
+        stmt.kind = STMT_COPY;
+        return copy(stmt.copy);
+    }
+    if (acceptKeyword("VACUUM")) {
+        stmt.kind = STMT_VACUUM;
+        return name(stmt.vacuum.tableName, "a table name") && end();
+    }
+    if (acceptKeyword("CONVERT")) {
+        stmt.kind = STMT_CONVERT;
+        return expectKeyword("TABLE") && name(stmt.convert.tableName, "a table name") && end();
+    }
+    if (acceptKeyword("COMMIT")) {
+        stmt.kind = STMT_COMMIT;
+        return end();
+    }
+    if (acceptKeyword("CHECKPOINT")) {
+        stmt.kind = STMT_CHECKPOINT;
+        return end();
+    }
+    if (acceptKeyword("SET")) {
+        stmt.kind = STMT_SET;
+        return set(stmt.set);
+    }
+    if (acceptKeyword("BENCHMARK")) {
+        stmt.kind = STMT_BENCHMARK;
+        return benchmark(stmt.benchmark);
+    }
+    if (acceptKeyword("ANALYZE")) {
+        stmt.kind = STMT_ANALYZE;
+        return name(stmt.analyze.tableName, "a table name") && end();
+    }
+    return fail("Unknown statement");
+}
+
+bool Parser::parse(Statement& stmt, string& err)
+{
+    if (statement(stmt))
+        return true;
+    err = error;
+    return false;
+}
+
+string normalizeStatement(const string& sql)
+{
+    string key;
+    key.reserve(sql.size());
+    char quote = 0;
+    for (size_t i = 0; i < sql.size(); i++)
+    {
+        char c = sql[i];
+        if (quote) {
+            if (c == quote)
+                quote = 0;
+        }
+        else if (c == '\'' || c == '"')
+            quote = c;
+        else if (c == '-' && i + 1 < sql.size() && sql[i + 1] == '-') {
+            while (i + 1 < sql.size() && sql[i + 1] != '\n')
+                i++;
+            c = ' ';
+        }
+        if (!quote && isspace((unsigned char)c)) {
+            if (!key.empty() && key.back() != ' ')
+                key += ' ';
+            continue;
+        }
+        key += c;
+    }
+    while (!key.empty() && (key.back() == ' ' || key.back() == ';'))
+        key.pop_back();
+    return key;
+}
+
+// Most recently used first.
+static list<pair<string, shared_ptr<const Statement>>> cacheOrder;
+static unordered_map<string, list<pair<string, shared_ptr<const Statement>>>::iterator> cacheIndex;
+
+shared_ptr<const Statement> parseStatement(const string& sql, string& err)
+{
+    string key = normalizeStatement(sql);
+    auto hit = cacheIndex.find(key);
+    if (hit != cacheIndex.end()) {
+        cacheOrder.splice(cacheOrder.begin(), cacheOrder, hit->second);
+        return hit->second->second;
+    }
+
+    vector<Token> tokens;
+    if (!tokenize(key, tokens, err))
+        return nullptr;
+    auto stmt = make_shared<Statement>();
+    if (!Parser(key, tokens).parse(*stmt, err))
+        return nullptr;
+
+    if (key.size() <= PARSE_CACHE_MAX_TEXT && stmt->kind != STMT_EXECUTE)
+    {
+        cacheOrder.emplace_front(key, stmt);
+        cacheIndex[key] = cacheOrder.begin();
+        if (cacheOrder.size() > PARSE_CACHE_ENTRIES) {
+            cacheIndex.erase(cacheOrder.back().first);
+            cacheOrder.pop_back();
+        }
+    }
+    return stmt;
+}
@@ -0,0 +1,281 @@
+#pragma once
+#ifndef PARSER_H
+#define PARSER_H
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "lexer.h"
+using namespace std;
+
+// Recursive-descent parser for the statements:
+//
+//   SELECT * | item, ... FROM table [[INNER] JOIN table ON col = col]
+//       [WHERE condition] [GROUP BY col, ...]
+//       [ORDER BY item [ASC|DESC], ...] [LIMIT n [OFFSET m]]
+//       where an item is col, COUNT(*) or COUNT|SUM|AVG|MIN|MAX(col)
+//   INSERT INTO table [(col, ...)] VALUES (value, ...), ...
+//   UPDATE table SET col = value, ... [WHERE condition]
+//   DELETE [*] FROM table [WHERE condition]
+//   CREATE TABLE table (col type[(size)] [PRIMARY KEY] [NOT NULL], ...)
+//   DROP TABLE table
+//   PREPARE name AS statement
+//   EXECUTE name [(value, ...)]
+//   DEALLOCATE [PREPARE] name
+//   CREATE INDEX name ON table(col)
+//   DROP INDEX name [ON table]
+//   COPY table FROM 'file.csv' [HEADER]
+//   VACUUM table
+//   CONVERT TABLE table
+//   COMMIT
+//   CHECKPOINT
+//   SET name = value
+//   BENCHMARK FILTER [rows]
+//   ANALYZE table
+//
+// A condition is built from comparisons col op value and col [NOT] IN
+// (value, ...) with AND, OR, NOT and parentheses; NOT binds tightest and OR
+// loosest. IN is parsed as an OR of = comparisons, one per value. In a SELECT a column may be
+// qualified with its table name, as table.col. op is one of
+// = != <> < <= > >=. A value is a quoted string, a number, NULL
+// or unquoted text, which runs up to the next comma, parenthesis or operator
+// (or AND/OR in a condition).
+// Values are stored without their quotes and an omitted INSERT value is "".
+// In the SELECT, INSERT, UPDATE or DELETE of a PREPARE, a value may be a ?
+// parameter; Statement::params says where each one goes.
+//
+// parseStatement() keeps the last PARSE_CACHE_ENTRIES statements it parsed,
+// keyed on their text with whitespace and comments outside quotes collapsed,
+// so a repeated statement is looked up instead of parsed again. EXECUTE
+// statements differ in their values every time and are not cached.
+
+const size_t PARSE_CACHE_ENTRIES = 256;
+const size_t PARSE_CACHE_MAX_TEXT = 4096;    // longer statements are not cached
+
+enum StatementKind
+{
+    STMT_SELECT,
+    STMT_INSERT,
+    STMT_UPDATE,
+    STMT_DELETE,
+    STMT_CREATE_TABLE,
+    STMT_DROP_TABLE,
+    STMT_PREPARE,
+    STMT_EXECUTE,
+    STMT_DEALLOCATE,
+    STMT_CREATE_INDEX,
+    STMT_DROP_INDEX,
+    STMT_COPY,
+    STMT_VACUUM,
+    STMT_CONVERT,
+    STMT_COMMIT,
+    STMT_CHECKPOINT,
+    STMT_SET,
+    STMT_BENCHMARK,
+    STMT_ANALYZE
+};
+
+enum AggregateKind
+{
+    AGG_NONE,
+    AGG_COUNT,
+    AGG_SUM,
+    AGG_AVG,
+    AGG_MIN,
+    AGG_MAX
+};
+
+enum ConditionKind
+{
+    COND_COMPARE,
+    COND_AND,
+    COND_OR,
+    COND_NOT
+};
+
+// A WHERE condition. Its comparisons are numbered in the order written.
+struct Condition
+{
+    ConditionKind kind = COND_COMPARE;
+    string column;              // COND_COMPARE
+    string op;
+    string value;
+    size_t leaf = 0;
+    vector<Condition> operands; // two or more for AND and OR, one for NOT
+};
+
+struct SelectItem
+{
+    AggregateKind aggregate = AGG_NONE;
+    string column;              // "*" for COUNT(*)
+};
+
+struct OrderItem
+{
+    SelectItem item;
+    bool descending = false;
+};
+
+struct SelectQuery
+{
+    string tableName;
+    bool hasJoin = false;
+    string joinTable;
+    string joinLeft;            // the two columns of ON, as written
+    string joinRight;
+    vector<SelectItem> items;   // empty for *
+    vector<string> groupBy;
+    vector<OrderItem> orderBy;
+    bool hasLimit = false;
+    uint64_t limit = 0;
+    uint64_t offset = 0;
+    bool hasWhere = false;
+    Condition where;
+};
+
+struct InsertQuery
+{
+    string tableName;
+    vector<string> columns;
+    vector<vector<string>> valuesList;
+    bool hasColumns = false;
+};
+
+struct UpdateQuery
+{
+    string tableName;
+    unordered_map<string, string> setValues;
+    Condition where;
+    bool hasWhere = false;
+};
+
+struct DeleteQuery
+{
+    string tableName;
+    bool hasWhere = false;
+    Condition where;
+};
+
+struct ColumnDef { string name; string type; int length; bool isPK; bool isNN; };
+
+struct CreateQuery
+{
+    string tableName;
+    vector<ColumnDef> columns;
+};
+
+struct DropQuery
+{
+    string tableName;
+};
+
+struct Statement;
+
+struct PrepareQuery
+{
+    string name;
+    shared_ptr<const Statement> body;
+};
+
+struct ExecuteQuery
+{
+    string name;
+    vector<string> values;
+};
+
+struct DeallocateQuery
+{
+    string name;
+};
+
+struct CreateIndexQuery
+{
+    string name;
+    string tableName;
+    string column;
+};
+
+struct DropIndexQuery
+{
+    string name;
+    string tableName;           // empty without ON
+};
+
+struct CopyQuery
+{
+    string tableName;
+    string path;
+    bool header = false;
+};
+
+struct VacuumQuery
+{
+    string tableName;
+};
+
+struct ConvertQuery
+{
+    string tableName;
+};
+
+struct SetQuery
+{
+    string name;                // upper case
+    string value;
+};
+
+struct BenchmarkQuery
+{
+    uint64_t rows = 4000000;
+};
+
+struct AnalyzeQuery
+{
+    string tableName;
+};
+
+enum ParamTarget
+{
+    PARAM_INSERT_VALUE,     // insert.valuesList[row][position]
+    PARAM_SET_VALUE,        // update.setValues[column]
+    PARAM_WHERE_VALUE       // the value of comparison `position` of the WHERE
+};
+
+struct Parameter
+{
+    ParamTarget target = PARAM_WHERE_VALUE;
+    size_t row = 0;
+    size_t position = 0;
+    string column;
+};
+
+struct Statement
+{
+    StatementKind kind = STMT_SELECT;
+    SelectQuery select;
+    InsertQuery insert;
+    UpdateQuery update;
+    DeleteQuery remove;
+    CreateQuery create;
+    DropQuery drop;
+    PrepareQuery prepare;
+    ExecuteQuery execute;
+    DeallocateQuery deallocate;
+    CreateIndexQuery createIndex;
+    DropIndexQuery dropIndex;
+    CopyQuery copy;
+    VacuumQuery vacuum;
+    ConvertQuery convert;
+    SetQuery set;
+    BenchmarkQuery benchmark;
+    AnalyzeQuery analyze;
+    vector<Parameter> params;   // in the order the ?s appear
+};
+
+// Returns null with err set when the statement does not parse.
+shared_ptr<const Statement> parseStatement(const string& sql, string& err);
+// Key under which a statement is cached.
+string normalizeStatement(const string& sql);
+
+#endif
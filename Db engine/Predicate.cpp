@@ -0,0 +1,458 @@
+#include <string>
+#include <charconv>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include "predicate.h"
+#include "storage.h"
+#include "utils.h"
+#include "filterkernels.h"
+using namespace std;
+
+const uint32_t FILTER_CHUNK_ROWS = 1024;  // rows of an encoded segment decoded at a time
+
+bool parseCompareOp(const string& op, CompareOp& out)
+{
+    if (op == "=") out = CMP_EQ;
+    else if (op == "!=") out = CMP_NE;
+    else if (op == "<") out = CMP_LT;
+    else if (op == "<=") out = CMP_LE;
+    else if (op == ">") out = CMP_GT;
+    else if (op == ">=") out = CMP_GE;
+    else return false;
+    return true;
+}
+
+template <CompareOp Op, typename T>
+static inline bool compareAs(const T& a, const T& b)
+{
+    if constexpr (Op == CMP_EQ) return a == b;
+    else if constexpr (Op == CMP_NE) return a != b;
+    else if constexpr (Op == CMP_LT) return a < b;
+    else if constexpr (Op == CMP_LE) return a <= b;
+    else if constexpr (Op == CMP_GT) return a > b;
+    else return a >= b;
+}
+
+template <OperandKind K, CompareOp Op>
+static bool matchTextAs(const Predicate& p, string_view cell)
+{
+    if (cell == "NULL" || cell.empty())
+        return false;
+
+    if constexpr (K == OPERAND_CHAR || K == OPERAND_VARCHAR)
+        return compareAs<Op>(cell, string_view(p.text));
+    else if constexpr (K == OPERAND_INT)
+    {
+        int64_t v;
+        auto r = from_chars(cell.data(), cell.data() + cell.size(), v);
+        return r.ec == errc() && compareAs<Op>(v, p.intValue);
+    }
+    else if constexpr (K == OPERAND_FLOAT)
+    {
+        float v;
+        auto r = from_chars(cell.data(), cell.data() + cell.size(), v);
+        return r.ec == errc() && compareAs<Op>((double)v, p.realValue);
+    }
+    else
+    {
+        double v;
+        auto r = from_chars(cell.data(), cell.data() + cell.size(), v);
+        return r.ec == errc() && compareAs<Op>(v, p.realValue);
+    }
+}
+
+template <OperandKind K, CompareOp Op>
+static bool matchSlotAs(const Predicate& p, const char* slot, size_t width)
+{
+    if (!slot)
+        return false;
+
+    if constexpr (K == OPERAND_INT)
+    {
+        int32_t v;
+        memcpy(&v, slot, sizeof v);
+        return compareAs<Op>((int64_t)v, p.intValue);
+    }
+    else if constexpr (K == OPERAND_INT_AS_REAL)
+    {
+        int32_t v;
+        memcpy(&v, slot, sizeof v);
+        return compareAs<Op>((double)v, p.realValue);
+    }
+    else if constexpr (K == OPERAND_FLOAT)
+    {
+        float v;
+        memcpy(&v, slot, sizeof v);
+        return compareAs<Op>((double)v, p.realValue);
+    }
+    else if constexpr (K == OPERAND_DOUBLE)
+    {
+        double v;
+        memcpy(&v, slot, sizeof v);
+        return compareAs<Op>(v, p.realValue);
+    }
+    else if constexpr (K == OPERAND_CHAR)
+        return compareAs<Op>(string_view(slot, strnlen(slot, width)), string_view(p.text));
+    else
+    {
+        uint16_t len;
+        memcpy(&len, slot, sizeof len);
+        return compareAs<Op>(string_view(slot + sizeof len, min((size_t)len, width - sizeof len)), string_view(p.text));
+    }
+}
+
+template <CompareOp Op>
+static bool matchNullText(const Predicate&, string_view cell)
+{
+    bool isNull = cell == "NULL" || cell.empty();
+    return Op == CMP_EQ ? isNull : Op == CMP_NE ? !isNull : false;
+}
+
+template <CompareOp Op>
+static bool matchNullSlot(const Predicate&, const char* slot, size_t)
+{
+    return Op == CMP_EQ ? slot == nullptr : Op == CMP_NE ? slot != nullptr : false;
+}
+
+struct Comparators
+{
+    bool (*text)(const Predicate&, string_view);
+    bool (*slot)(const Predicate&, const char*, size_t);
+};
+
+template <OperandKind K>
+static Comparators comparatorsFor(CompareOp op)
+{
+    switch (op)
+    {
+    case CMP_EQ: return { matchTextAs<K, CMP_EQ>, matchSlotAs<K, CMP_EQ> };
+    case CMP_NE: return { matchTextAs<K, CMP_NE>, matchSlotAs<K, CMP_NE> };
+    case CMP_LT: return { matchTextAs<K, CMP_LT>, matchSlotAs<K, CMP_LT> };
+    case CMP_LE: return { matchTextAs<K, CMP_LE>, matchSlotAs<K, CMP_LE> };
+    case CMP_GT: return { matchTextAs<K, CMP_GT>, matchSlotAs<K, CMP_GT> };
+    default:     return { matchTextAs<K, CMP_GE>, matchSlotAs<K, CMP_GE> };
+    }
+}
+
+static Comparators nullComparators(CompareOp op)
+{
+    switch (op)
+    {
+    case CMP_EQ: return { matchNullText<CMP_EQ>, matchNullSlot<CMP_EQ> };
+    case CMP_NE: return { matchNullText<CMP_NE>, matchNullSlot<CMP_NE> };
+    default:     return { matchNullText<CMP_LT>, matchNullSlot<CMP_LT> };
+    }
+}
+
+static int resolveColumn(const TableData& schema, const string& column)
+{
+    for (size_t i = 0; i < schema.columns.size(); i++)
+        if (schema.columns[i] == column)
+            return (int)i;
+
+    string wanted = column;
+    toUpper(wanted);
+    for (size_t i = 0; i < schema.columns.size(); i++)
+    {
+        string name = schema.columns[i];
+        toUpper(name);
+        if (name == wanted)
+            return (int)i;
+    }
+    return -1;
+}
+
+bool Predicate::compile(const TableData& schema, const string& column, const string& op, const string& literal, string& err)
+{
+    return prepare(schema, column, op, err) && bind(schema, literal, err);
+}
+
+bool Predicate::prepare(const TableData& schema, const string& column, const string& op, string& err)
+{
+    int found = resolveColumn(schema, column);
+    if (found == -1) {
+        err = "Column '" + column + "' not found";
+        return false;
+    }
+    return prepare(schema, found, op, err);
+}
+
+bool Predicate::prepare(const TableData& schema, int column, const string& op, string& err)
+{
+    if (column < 0 || column >= (int)schema.columns.size()) {
+        err = "Column " + to_string(column) + " not found";
+        return false;
+    }
+    col = column;
+    if (!parseCompareOp(op, cmp)) {
+        err = "Unsupported operator '" + op + "'";
+        return false;
+    }
+    return true;
+}
+
+bool Predicate::bind(const TableData& schema, const string& literal, string& err)
+{
+    text = trim(literal);
+    if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front())
+        text = text.substr(1, text.size() - 2);
+
+    Comparators c;
+    ColType type = typeCode(schema.types[col]);
+    string upper = text;
+    toUpper(upper);
+
+    if (upper == "NULL")
+        kind = OPERAND_NULL;
+    else if (type == COL_CHAR)
+        kind = OPERAND_CHAR;
+    else if (type == COL_VARCHAR)
+        kind = OPERAND_VARCHAR;
+    else
+    {
+        const char* b = text.data();
+        const char* e = text.data() + text.size();
+        auto asInt = from_chars(b, e, intValue);
+        auto asReal = from_chars(b, e, realValue);
+        if (asReal.ec != errc() || asReal.ptr != e) {
+            err = "Invalid value '" + text + "' for " + schema.types[col] + " column '" + schema.columns[col] + "'";
+            return false;
+        }
+
+        if (type == COL_INT && asInt.ec == errc() && asInt.ptr == e)
+            kind = OPERAND_INT;
+        else if (type == COL_INT)
+            kind = OPERAND_INT_AS_REAL;
+        else if (type == COL_FLOAT) {
+            // Stored floats are compared against the literal rounded the same way.
+            realValue = (double)(float)realValue;
+            kind = OPERAND_FLOAT;
+        }
+        else
+            kind = OPERAND_DOUBLE;
+    }
+
+    switch (kind)
+    {
+    case OPERAND_INT: c = comparatorsFor<OPERAND_INT>(cmp); break;
+    case OPERAND_INT_AS_REAL: c = comparatorsFor<OPERAND_INT_AS_REAL>(cmp); break;
+    case OPERAND_FLOAT: c = comparatorsFor<OPERAND_FLOAT>(cmp); break;
+    case OPERAND_DOUBLE: c = comparatorsFor<OPERAND_DOUBLE>(cmp); break;
+    case OPERAND_CHAR: c = comparatorsFor<OPERAND_CHAR>(cmp); break;
+    case OPERAND_VARCHAR: c = comparatorsFor<OPERAND_VARCHAR>(cmp); break;
+    default: c = nullComparators(cmp); break;
+    }
+
+    matchText = c.text;
+    matchSlot = c.slot;
+    return true;
+}
+
+// Whether some value in [low, high] can compare true against v.
+template <typename T>
+static bool rangeMayMatch(CompareOp op, T low, T high, T v)
+{
+    switch (op)
+    {
+    case CMP_EQ: return !(v < low) && !(high < v);
+    case CMP_NE: return !(low == high && low == v);
+    case CMP_LT: return low < v;
+    case CMP_LE: return low <= v;
+    case CMP_GT: return high > v;
+    default:     return high >= v;
+    }
+}
+
+bool Predicate::mayMatch(const ColumnZone& zone) const
+{
+    if (kind == OPERAND_NULL)
+        return cmp == CMP_EQ ? zone.nulls > 0 : cmp == CMP_NE ? zone.values > 0 : false;
+    if (zone.values == 0)
+        return false;
+
+    if (kind == OPERAND_INT || kind == OPERAND_INT_AS_REAL)
+    {
+        int64_t low, high;
+        memcpy(&low, &zone.low, 8);
+        memcpy(&high, &zone.high, 8);
+        return kind == OPERAND_INT ? rangeMayMatch(cmp, low, high, intValue)
+            : rangeMayMatch(cmp, (double)low, (double)high, realValue);
+    }
+    if (kind == OPERAND_FLOAT || kind == OPERAND_DOUBLE)
+    {
+        double low, high;
+        memcpy(&low, &zone.low, 8);
+        memcpy(&high, &zone.high, 8);
+        return rangeMayMatch(cmp, low, high, realValue);
+    }
+
+    // Strings are bounded by their first 8 bytes only: a key strictly
+    // outside the bounds settles the comparison, an equal one does not.
+    uint64_t key = stringZoneKey(text);
+    switch (cmp)
+    {
+    case CMP_EQ: return key >= zone.low && key <= zone.high;
+    case CMP_NE: return true;
+    case CMP_LT:
+    case CMP_LE: return zone.low <= key;
+    default:     return zone.high >= key;
+    }
+}
+
+// The codes of the entries of a sorted dictionary that compare true against
+// v: [low, high), or everything outside it when outside is set.
+static void codeRange(CompareOp op, const DictionarySegment& d, ColType type, size_t width, string_view v,
+    uint32_t& low, uint32_t& high, bool& outside)
+{
+    char scratch[TBL_VALUE_SCRATCH];
+    auto below = [&](uint32_t code, bool orEqual) {
+        string_view entry = viewValue(type, d.entry(code, width), width, scratch);
+        return orEqual ? entry <= v : entry < v;
+    };
+    // Entries [0, lower) are below v and [0, upper) not above it.
+    uint32_t lower = 0, upper = 0;
+    for (uint32_t n = d.entries; n > 0;)
+    {
+        uint32_t half = n / 2;
+        if (below(lower + half, false)) { lower += half + 1; n -= half + 1; }
+        else n = half;
+    }
+    upper = lower;
+    for (uint32_t n = d.entries - lower; n > 0;)
+    {
+        uint32_t half = n / 2;
+        if (below(upper + half, true)) { upper += half + 1; n -= half + 1; }
+        else n = half;
+    }
+
+    outside = op == CMP_NE;
+    switch (op)
+    {
+    case CMP_EQ:
+    case CMP_NE: low = lower; high = upper; break;
+    case CMP_LT: low = 0; high = lower; break;
+    case CMP_LE: low = 0; high = upper; break;
+    case CMP_GT: low = upper; high = d.entries; break;
+    default:     low = lower; high = d.entries; break;
+    }
+}
+
+template <typename Code>
+static void filterCodes(const Code* codes, uint32_t count, uint32_t low, uint32_t high, bool outside,
+    uint64_t* selection)
+{
+    uint32_t span = high - low;
+    for (uint32_t w = 0; w * 64 < count; w++)
+    {
+        uint64_t bits = 0;
+        uint32_t n = min<uint32_t>(64, count - w * 64);
+        for (uint32_t i = 0; i < n; i++)
+            bits |= (uint64_t)((uint32_t)(codes[w * 64 + i] - low) < span) << i;
+        uint64_t valid = n == 64 ? ~0ull : (1ull << n) - 1;
+        selection[w] = outside ? ~bits & valid : bits;
+    }
+}
+
+// Sets bits [from, to) of a selection.
+static void selectRange(uint64_t* selection, uint32_t from, uint32_t to)
+{
+    while (from < to)
+    {
+        uint32_t n = min(to - from, 64 - from % 64);
+        uint64_t bits = n == 64 ? ~0ull : ((1ull << n) - 1) << (from % 64);
+        selection[from / 64] |= bits;
+        from += n;
+    }
+}
+
+void Predicate::filterValues(const char* values, uint32_t count, size_t width, uint64_t* selection) const
+{
+    SimdLevel level = activeSimdLevel();
+    bool int32Literal = intValue >= INT32_MIN && intValue <= INT32_MAX;
+    if (kind == OPERAND_INT && int32Literal)
+        filterInt32((const int32_t*)values, count, cmp, (int32_t)intValue, selection, level);
+    else if (kind == OPERAND_FLOAT)
+        filterFloat((const float*)values, count, cmp, (float)realValue, selection, level);
+    else if (kind == OPERAND_DOUBLE)
+        filterDouble((const double*)values, count, cmp, realValue, selection, level);
+    else
+    {
+        memset(selection, 0, selectionWords(count) * sizeof(uint64_t));
+        for (uint32_t i = 0; i < count; i++)
+            if (matchSlot(*this, values + (size_t)i * width, width))
+                selection[i / 64] |= 1ull << (i % 64);
+    }
+}
+
+void Predicate::filterSegment(const char* segment, uint32_t slots, size_t width, uint32_t encoding,
+    uint32_t begin, uint32_t end, uint64_t* selection) const
+{
+    const char* values = segment + bitmapSize(slots);
+    uint32_t count = end - begin;
+    size_t words = selectionWords(count);
+
+    if (kind == OPERAND_NULL)
+    {
+        // A NULL test looks at the null bitmap only, never at a value.
+        memset(selection, 0, words * sizeof(uint64_t));
+        for (uint32_t r = begin; r < end; r++)
+        {
+            bool isNull = (segment[r / 8] & (1 << (r % 8))) != 0;
+            if (matchSlot(*this, isNull ? nullptr : values, width))
+                selection[(r - begin) / 64] |= 1ull << ((r - begin) % 64);
+        }
+        return;
+    }
+
+    if (encoding == SEG_DICTIONARY)
+    {
+        // The literal is looked up once; each row then only compares its code.
+        DictionarySegment d = dictionarySegment(values, slots);
+        uint32_t low, high;
+        bool outside;
+        codeRange(cmp, d, kind == OPERAND_CHAR ? COL_CHAR : COL_VARCHAR, width, text, low, high, outside);
+        if (d.codeSize == 1)
+            filterCodes((const uint8_t*)d.codes + begin, count, low, high, outside, selection);
+        else
+            filterCodes((const uint16_t*)d.codes + begin, count, low, high, outside, selection);
+    }
+    else if (encoding == SEG_RLE)
+    {
+        // Each run is compared once, and its rows go in or out together.
+        RunSegment runs = runSegment(values);
+        memset(selection, 0, words * sizeof(uint64_t));
+        uint32_t r = begin;
+        for (uint32_t run = runs.find(begin); r < end; run++)
+        {
+            uint32_t stop = min(runs.end(run), end);
+            if (matchSlot(*this, runs.value(run, width), width))
+                selectRange(selection, r - begin, stop - begin);
+            r = stop;
+        }
+    }
+    else if (encoding == SEG_PLAIN)
+        filterValues(values + (size_t)begin * width, count, width, selection);
+    else
+    {
+        // Delta and frame-of-reference segments are decoded a chunk at a
+        // time and the chunk filtered as plain slots.
+        alignas(8) char chunk[FILTER_CHUNK_ROWS * sizeof(double)];
+        for (uint32_t at = begin; at < end; at += FILTER_CHUNK_ROWS)
+        {
+            uint32_t n = min(FILTER_CHUNK_ROWS, end - at);
+            decodeSegment(values, encoding, width, slots, at, at + n, chunk);
+            filterValues(chunk, n, width, selection + (at - begin) / 64);
+        }
+    }
+
+    // The null bitmap is padded to 8 bytes, so it reads as whole words;
+    // begin is a multiple of 64, so they line up with the selection words.
+    for (size_t w = 0; w < words; w++)
+    {
+        size_t at = begin / 8 + w * 8;
+        uint64_t nulls = 0;
+        memcpy(&nulls, segment + at, min<size_t>(8, bitmapSize(slots) - at));
+        selection[w] &= ~nulls;
+    }
+}
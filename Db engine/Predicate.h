@@ -0,0 +1,90 @@
+#pragma once
+#ifndef PREDICATE_H
+#define PREDICATE_H
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+using namespace std;
+
+// A WHERE condition "column op literal" compiled against a table schema.
+// The column is resolved and the literal parsed into the column's type once;
+// compile() then picks a comparator instantiated for that type and operator,
+// so evaluating a row is a direct call with no parsing and no exceptions.
+//
+// Numeric columns compare numerically and string columns byte-wise. NULL
+// cells match nothing except "= NULL" (and "!= NULL" matches every non-NULL).
+
+enum CompareOp : uint8_t
+{
+    CMP_EQ,
+    CMP_NE,
+    CMP_LT,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE
+};
+
+// How a value is compared: the stored column type and the type the
+// comparison happens in.
+enum OperandKind : uint8_t
+{
+    OPERAND_INT,
+    OPERAND_INT_AS_REAL,
+    OPERAND_FLOAT,
+    OPERAND_DOUBLE,
+    OPERAND_CHAR,
+    OPERAND_VARCHAR,
+    OPERAND_NULL
+};
+
+bool parseCompareOp(const string& op, CompareOp& out);
+
+class Predicate
+{
+public:
+    bool compile(const TableData& schema, const string& column, const string& op, const string& literal, string& err);
+    // compile() in two steps, for a condition whose literal changes between
+    // runs: prepare() resolves the column and operator, bind() the literal.
+    bool prepare(const TableData& schema, const string& column, const string& op, string& err);
+    bool prepare(const TableData& schema, int column, const string& op, string& err);
+    bool bind(const TableData& schema, const string& literal, string& err);
+
+    int column() const { return col; }
+    CompareOp op() const { return cmp; }
+    OperandKind operand() const { return kind; }
+    const string& literal() const { return text; }
+
+    // A cell in decoded text form, as held by TableData rows.
+    bool matches(string_view cell) const { return matchText(*this, cell); }
+    // A cell in its stored binary form (see Storage.h); slot is null for NULL.
+    bool matchesSlot(const char* slot, size_t width) const { return matchSlot(*this, slot, width); }
+    // Rows [begin, end) of a column segment of a block laid out for slots
+    // rows: sets bit r - begin of selection for each matching row r. begin
+    // must be a multiple of 64.
+    // Numeric columns go through the SIMD filter kernels. An encoded segment
+    // (see Storage.h) is filtered on its dictionary codes or once per run,
+    // or else decoded a chunk at a time.
+    void filterSegment(const char* segment, uint32_t slots, size_t width, uint32_t encoding,
+        uint32_t begin, uint32_t end, uint64_t* selection) const;
+    // False when no cell of a block with this zone of the column can match.
+    bool mayMatch(const ColumnZone& zone) const;
+
+    // Comparison operands, public for the comparator templates in Predicate.cpp.
+    int64_t intValue = 0;
+    double realValue = 0;
+    string text;
+
+private:
+    int col = -1;
+    CompareOp cmp = CMP_EQ;
+    OperandKind kind = OPERAND_NULL;
+    bool (*matchText)(const Predicate&, string_view) = nullptr;
+    bool (*matchSlot)(const Predicate&, const char*, size_t) = nullptr;
+
+    // count plain non-NULL slots: sets bit i of selection when slot i matches.
+    void filterValues(const char* values, uint32_t count, size_t width, uint64_t* selection) const;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include "prepare.h"
+#include "select.h"
+#include "insert.h"
+#include "update.h"
+#include "delete.h"
+#include "utils.h"
+using namespace std;
+
+struct PreparedStatement
+{
+    shared_ptr<const Statement> body;
+    uint64_t planVersion = 0;
+    SelectPlan select;
+    InsertPlan insert;
+    UpdatePlan update;
+    DeletePlan remove;
+};
+
+static unordered_map<string, PreparedStatement> prepared;     // by upper-case name
+static uint64_t catalogVersion = 1;
+
+void invalidatePreparedPlans()
+{
+    catalogVersion++;
+}
+
+static bool planPrepared(PreparedStatement& ps)
+{
+    bool ok = false;
+    switch (ps.body->kind)
+    {
+    case STMT_SELECT: ok = planSelect(ps.body->select, ps.select); break;
+    case STMT_INSERT: ok = planInsert(ps.body->insert, ps.insert); break;
+    case STMT_UPDATE: ok = planUpdate(ps.body->update, ps.update); break;
+    case STMT_DELETE: ok = planDelete(ps.body->remove, ps.remove); break;
+    default: break;
+    }
+    ps.planVersion = ok ? catalogVersion : 0;
+    return ok;
+}
+
+void prepareStatement(const PrepareQuery& pq)
+{
+    string key = upperWord(pq.name);
+    if (prepared.count(key))
+    {
+        setColor(12);
+        cout << "Error: Prepared statement '" << pq.name << "' already exists.\n";
+        setColor(15);
+        return;
+    }
+
+    PreparedStatement ps;
+    ps.body = pq.body;
+    if (!planPrepared(ps))
+        return;
+    size_t count = ps.body->params.size();
+    prepared.emplace(key, move(ps));
+
+    setColor(10);
+    cout << "Statement '" << pq.name << "' prepared with " << count << " parameter(s).\n";
+    setColor(15);
+}
+
+void executePrepared(const ExecuteQuery& eq)
+{
+    auto it = prepared.find(upperWord(eq.name));
+    if (it == prepared.end())
+    {
+        setColor(12);
+        cout << "Error: Prepared statement '" << eq.name << "' does not exist.\n";
+        setColor(15);
+        return;
+    }
+
+    PreparedStatement& ps = it->second;
+    const vector<Parameter>& params = ps.body->params;
+    if (eq.values.size() != params.size())
+    {
+        setColor(12);
+        cout << "Error: Statement '" << eq.name << "' takes " << params.size() << " parameter(s), got "
+            << eq.values.size() << ".\n";
+        setColor(15);
+        return;
+    }
+    if (ps.planVersion != catalogVersion && !planPrepared(ps))
+        return;
+
+    StatementKind kind = ps.body->kind;
+    for (size_t i = 0; i < params.size(); i++)
+    {
+        const Parameter& p = params[i];
+        const string& v = eq.values[i];
+        if (p.target == PARAM_INSERT_VALUE)
+            ps.insert.valuesList[p.row][p.position] = v;
+        else if (p.target == PARAM_SET_VALUE) {
+            for (auto& set : ps.update.sets)
+                if (set.name == p.column)
+                    set.value = v;
+        }
+        else if (kind == STMT_SELECT)
+            ps.select.where.values[p.position] = v;
+        else if (kind == STMT_UPDATE)
+            ps.update.where.values[p.position] = v;
+        else
+            ps.remove.where.values[p.position] = v;
+    }
+
+    switch (kind)
+    {
+    case STMT_SELECT: runSelect(ps.select); break;
+    case STMT_INSERT: runInsert(ps.insert); break;
+    case STMT_UPDATE: runUpdate(ps.update); break;
+    case STMT_DELETE: runDelete(ps.remove); break;
+    default: break;
+    }
+}
+
+void deallocatePrepared(const DeallocateQuery& dq)
+{
+    if (!prepared.erase(upperWord(dq.name)))
+    {
+        setColor(12);
+        cout << "Error: Prepared statement '" << dq.name << "' does not exist.\n";
+        setColor(15);
+        return;
+    }
+    setColor(10);
+    cout << "Statement '" << dq.name << "' deallocated.\n";
+    setColor(15);
+}
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef PREPARE_H
+#define PREPARE_H
+#include <string>
+#include "parser.h"
+using namespace std;
+
+// PREPARE name AS statement
+// EXECUTE name [(value, ...)]
+// DEALLOCATE [PREPARE] name
+//
+// PREPARE plans a SELECT, INSERT, UPDATE or DELETE once: the table schema is
+// read, column names resolved, the WHERE column and operator compiled and the
+// index to answer the condition chosen. EXECUTE binds its values to the
+// statement's ? parameters, in order, and runs the plan; only the values are
+// parsed and checked against their columns.
+//
+// Creating or dropping a table or an index, or converting a table, makes the
+// plans stale; each is made again at its next EXECUTE.
+
+void prepareStatement(const PrepareQuery& pq);
+void executePrepared(const ExecuteQuery& eq);
+void deallocatePrepared(const DeallocateQuery& dq);
+void invalidatePreparedPlans();
+
+#endif
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <string>
+#include "resultsink.h"
+#include "utils.h"
+using namespace std;
+
+static string& sharedBuffer()
+{
+    static string buffer;
+    return buffer;
+}
+
+ResultSink::ResultSink() : buffer(sharedBuffer())
+{
+    buffer.clear();
+    buffer.reserve(RESULT_SINK_BUFFER + RESULT_SINK_BUFFER / 4);
+}
+
+void ResultSink::header(const vector<string>& columns)
+{
+    flush();
+    for (auto& c : columns)
+        field(c);
+    buffer += '\n';
+
+    setColor(11);
+    flush();
+    setColor(15);
+}
+
+void ResultSink::row(const vector<string>& values, const vector<int>& picked)
+{
+    for (int c : picked)
+        field(values[c]);
+    endRow();
+}
+
+void ResultSink::write(string_view rows)
+{
+    if (buffer.size() + rows.size() > RESULT_SINK_BUFFER)
+        flush();
+    if (rows.size() >= RESULT_SINK_BUFFER) {
+        cout.write(rows.data(), rows.size());
+        cout.flush();
+        return;
+    }
+    buffer.append(rows.data(), rows.size());
+}
+
+void ResultSink::flush()
+{
+    if (buffer.empty())
+        return;
+    cout.write(buffer.data(), buffer.size());
+    cout.flush();
+    buffer.clear();
+}
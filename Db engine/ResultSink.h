@@ -0,0 +1,49 @@
+#pragma once
+#ifndef RESULTSINK_H
+#define RESULTSINK_H
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+// Output side of a query result. Rows are appended as tab-separated text to
+// one large buffer that is reused from statement to statement and written to
+// stdout in RESULT_SINK_BUFFER-sized chunks, so a big result costs a handful
+// of writes instead of one per cell. Console colours are only switched around
+// the header; rows go out as soon as the buffer fills, while the scan that
+// produces them is still running.
+
+const size_t RESULT_SINK_BUFFER = 1 << 20;
+
+class ResultSink
+{
+public:
+    ResultSink();
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+    ~ResultSink() { flush(); }
+
+    void header(const vector<string>& columns);
+
+    void field(string_view value)
+    {
+        buffer.append(value.data(), value.size());
+        buffer += '\t';
+    }
+    void endRow()
+    {
+        buffer += '\n';
+        if (buffer.size() >= RESULT_SINK_BUFFER)
+            flush();
+    }
+    void row(const vector<string>& values, const vector<int>& picked);
+    // Rows already formatted elsewhere, e.g. by a parallel scan worker.
+    void write(string_view rows);
+
+    void flush();
+
+private:
+    string& buffer;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef ROWVIEW_H
+#define ROWVIEW_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <charconv>
+#include "storage.h"
+#include "tablescanner.h"
+using namespace std;
+
+// Typed field access shared by the kinds of rows a query works on: the
+// current row of a TableScanner, a row decoded into text (an index hit or an
+// aggregate result) and a row of a join. Code templated on the row reads numbers without
+// caring whether they come from a binary slot or from text.
+
+struct CursorRow
+{
+    TableScanner& cursor;
+    bool isNull(int col) const { return cursor.isNull(col); }
+    int64_t integer(int col) const { return cursor.intField(col); }
+    double real(int col) const { return cursor.realField(col); }
+    string_view text(int col) const { return cursor.field(col); }
+};
+
+struct TextRow
+{
+    const vector<string>& row;
+    bool isNull(int col) const { return isNullValue(row[col]); }
+    int64_t integer(int col) const
+    {
+        int64_t v = 0;
+        from_chars(row[col].data(), row[col].data() + row[col].size(), v);
+        return v;
+    }
+    double real(int col) const
+    {
+        double v = 0;
+        from_chars(row[col].data(), row[col].data() + row[col].size(), v);
+        return v;
+    }
+    string_view text(int col) const { return row[col]; }
+};
+
+// A probe row joined with a build row (see Join.h). Columns are numbered
+// across both tables, those of the FROM table first; each side's columns
+// start at its offset.
+struct JoinedRow
+{
+    TableScanner& probe;
+    const vector<string>& build;
+    int probeOffset;
+    int buildOffset;
+
+    bool fromBuild(int col) const { return buildOffset < probeOffset ? col < probeOffset : col >= buildOffset; }
+    bool isNull(int col) const
+    {
+        return fromBuild(col) ? isNullValue(build[col - buildOffset]) : probe.isNull(col - probeOffset);
+    }
+    int64_t integer(int col) const
+    {
+        return fromBuild(col) ? TextRow{ build }.integer(col - buildOffset) : probe.intField(col - probeOffset);
+    }
+    double real(int col) const
+    {
+        return fromBuild(col) ? TextRow{ build }.real(col - buildOffset) : probe.realField(col - probeOffset);
+    }
+    string_view text(int col) const
+    {
+        return fromBuild(col) ? string_view(build[col - buildOffset]) : probe.field(col - probeOffset);
+    }
+};
+
+#endif
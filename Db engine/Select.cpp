@@ -2,283 +2,540 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
+#include <memory>
+#include <cstdint>
 #include "select.h"
-#include <unordered_map>
 #include "utils.h"
+#include "storage.h"
+#include "index.h"
+#include "tablescanner.h"
+#include "filter.h"
+#include "parallelscan.h"
+#include "resultsink.h"
+#include "parser.h"
+#include "lexer.h"
+#include "update.h"
+#include "aggregate.h"
+#include "sort.h"
+#include "join.h"
+#include "rowview.h"
+#include "threadpool.h"
 using namespace std;
 
-void selectAll(string tableName)
+// Where the rows of a scan come from: the scanned table itself, or a join
+// whose probe side is the scanned table.
+struct ScanSource
 {
-    TableData t = readTable(tableName);
-
-    if (t.columns.empty())
-        return;
-
-    setColor(11);
-    for (auto c : t.columns)
-        cout << c << "\t";
-    cout << "\n";
-    setColor(15);
-
-    for (auto row : t.rows)
+    const HashJoin* join = nullptr;
+    const Filter* joined = nullptr;     // checked on each joined row
+    int probeKey = 0;
+    int probeOffset = 0;
+    int buildOffset = 0;
+
+    // Calls f with the cursor's current row, or with each joined row it makes.
+    template <class F>
+    void rows(TableScanner& cursor, string& key, F&& f) const
     {
-        for (auto val : row)
-            cout << val << "\t";
-        cout << "\n";
+        if (!join) {
+            f(cursor);
+            return;
+        }
+        join->probe(cursor, probeKey, key, [&](const vector<string>& build) {
+            JoinedRow row{ cursor, build, probeOffset, buildOffset };
+            if (!joined || joined->matches(row))
+                f(row);
+        });
     }
-}
+};
 
-void selectColumns(string tableName, vector<string> wanted)
+static string_view cell(TableScanner& cursor, int col) { return cursor.field(col); }
+static string_view cell(const JoinedRow& row, int col) { return row.text(col); }
+
+// Formats the picked columns of every (matching) row into per-morsel text on
+// the thread pool and hands the morsels to the sink in table order.
+static void printScan(const TableScanner& scan, const Filter* filter, const ScanSource& source,
+    const vector<int>& picked, ResultSink& sink)
 {
-    TableData t = readTable(tableName);
-    if (t.columns.empty())
-        return;
+    vector<string> text(scan.morsels(SCAN_MORSEL_ROWS).size());
+    parallelScan(scan, filter,
+        [&](TableScanner& cursor, size_t m) {
+            string& out = text[m];
+            string key;
+            while (cursor.next())
+                source.rows(cursor, key, [&](auto& row) {
+                    for (int c : picked) {
+                        out += cell(row, c);
+                        out += '\t';
+                    }
+                    out += '\n';
+                });
+        },
+        [&](size_t m) {
+            sink.write(text[m]);
+            string().swap(text[m]);
+        });
+}
 
-    unordered_map<string, int> colIndex;
-    for (int i = 0; i < t.columns.size(); i++)
-        colIndex[t.columns[i]] = i;
+static const char* functionNames[] = { "", "COUNT", "SUM", "AVG", "MIN", "MAX" };
 
-    setColor(11);
-    for (auto c : wanted)
-        cout << c << "\t";
-    cout << endl;
-    setColor(15);
+// Resolves a column, possibly written as table.col, to its index in
+// plan.schema. Returns -1 (and reports why) when there is no such column.
+static int findColumn(const SelectPlan& plan, const string& name)
+{
+    size_t dot = name.find('.');
+    string qualifier = dot == string::npos ? "" : upperWord(name.substr(0, dot));
+    string column = dot == string::npos ? name : name.substr(dot + 1);
+    bool inTable = qualifier.empty() || qualifier == upperWord(plan.tableName);
+
+    int col = -1;
+    if (!plan.hasJoin)
+        col = inTable ? getColumnIndex(plan.schema, column) : -1;
+    else
+    {
+        int left = inTable ? getColumnIndex(plan.tableSchema, column) : -1;
+        int right = qualifier.empty() || qualifier == upperWord(plan.joinTable) ? getColumnIndex(plan.joinSchema, column) : -1;
+        if (left != -1 && right != -1) {
+            setColor(12); cout << "Error: Column '" << name << "' is in both tables; write it as table.column.\n"; setColor(15);
+            return -1;
+        }
+        col = left != -1 ? left : right == -1 ? -1 : (int)plan.tableSchema.columns.size() + right;
+    }
 
-    for (auto row : t.rows)
+    if (col == -1)
     {
-        for (auto c : wanted)
-            cout << row[colIndex[c]] << "\t";
-        cout << "\n";
+        setColor(12);
+        cout << "Error: Column '" << name << "' not found.\n";
+        setColor(15);
     }
+    return col;
 }
 
-bool compareValues(const string& leftVal, const string& rightVal, const string& op)
+// The column of a SELECT or ORDER BY item, -1 for COUNT(*).
+static bool itemColumn(const SelectPlan& plan, const SelectItem& item, int& col)
 {
-    bool isNumeric = true;
-    double leftNum = 0, rightNum = 0;
-
-    try
-    {
-        size_t pos1, pos2;
-        leftNum = stod(leftVal, &pos1);
-        rightNum = stod(rightVal, &pos2);
+    col = item.column == "*" ? -1 : findColumn(plan, item.column);
+    return col != -1 || item.column == "*";
+}
 
-        if (pos1 != leftVal.length() || pos2 != rightVal.length())
-            isNumeric = false;
-    }
-    catch (...)
+// Where an item of an aggregate query lies in the aggregate result rows,
+// which hold the GROUP BY values and then the aggregates. An aggregate not
+// computed yet is added. Returns -1 when the item cannot be used.
+static int resultColumn(SelectPlan& plan, const SelectItem& item, int col)
+{
+    const TableData& t = plan.schema;
+    if (item.aggregate == AGG_NONE)
     {
-        isNumeric = false;
+        auto at = find(plan.groupColumns.begin(), plan.groupColumns.end(), col);
+        if (at == plan.groupColumns.end()) {
+            setColor(12); cout << "Error: Column '" << t.columns[col] << "' must appear in GROUP BY or in an aggregate function.\n"; setColor(15);
+            return -1;
+        }
+        return (int)(at - plan.groupColumns.begin());
     }
 
-    if (op == "=")
-    {
-        return leftVal == rightVal;
+    ColType type = col == -1 ? COL_INT : typeCode(t.types[col]);
+    if ((item.aggregate == AGG_SUM || item.aggregate == AGG_AVG) && (type == COL_CHAR || type == COL_VARCHAR)) {
+        setColor(12); cout << "Error: " << functionNames[item.aggregate] << " needs a numeric column; '" << t.columns[col] << "' is " << t.types[col] << ".\n"; setColor(15);
+        return -1;
     }
-    else if (op == "!=")
-    {
-        return leftVal != rightVal;
-    }
-    else if (op == ">")
-    {
-        if (isNumeric)
-            return leftNum > rightNum;
-        else
-            return leftVal > rightVal;
-    }
-    else if (op == "<")
-    {
-        if (isNumeric)
-            return leftNum < rightNum;
-        else
-            return leftVal < rightVal;
-    }
-    else if (op == ">=")
+    size_t a = 0;
+    while (a < plan.aggregates.size() && (plan.aggregates[a].kind != item.aggregate || plan.aggregates[a].column != col))
+        a++;
+    if (a == plan.aggregates.size())
+        plan.aggregates.push_back({ item.aggregate, col });
+    return (int)(plan.groupColumns.size() + a);
+}
+
+// ORDER BY: each morsel (or chunk of decoded rows) is sorted into its own
+// buffer on the thread pool, keeping only the first `end` rows under a LIMIT,
+// and the buffers are then merged.
+static void printSorted(const SelectPlan& plan, const vector<vector<string>>* rows, const TableScanner& scan,
+    const Filter* filter, const ScanSource& source, uint64_t end, ResultSink& sink)
+{
+    vector<unique_ptr<SortBuffer>> buffers;
+    if (rows)
     {
-        if (isNumeric)
-            return leftNum >= rightNum;
-        else
-            return leftVal >= rightVal;
+        buffers.resize((rows->size() + SCAN_MORSEL_ROWS - 1) / SCAN_MORSEL_ROWS);
+        ThreadPool::instance().parallelFor(buffers.size(), [&](size_t m) {
+            buffers[m] = make_unique<SortBuffer>(plan.order, end);
+            size_t last = min(rows->size(), (m + 1) * SCAN_MORSEL_ROWS);
+            for (size_t i = m * SCAN_MORSEL_ROWS; i < last; i++)
+                buffers[m]->add((*rows)[i], plan.picked, i);
+            buffers[m]->finish();
+        });
     }
-    else if (op == "<=")
+    else
     {
-        if (isNumeric)
-            return leftNum <= rightNum;
-        else
-            return leftVal <= rightVal;
+        buffers.resize(scan.morsels(SCAN_MORSEL_ROWS).size());
+        parallelScan(scan, filter,
+            [&](TableScanner& cursor, size_t m) {
+                buffers[m] = make_unique<SortBuffer>(plan.order, end);
+                uint64_t i = (uint64_t)m << 32;
+                string key;
+                while (cursor.next())
+                    source.rows(cursor, key, [&](auto& row) { buffers[m]->add(row, plan.picked, i++); });
+                buffers[m]->finish();
+            },
+            [](size_t) {});
     }
 
-    return false;
+    vector<SortBuffer*> sorted;
+    for (auto& b : buffers)
+        if (b)
+            sorted.push_back(b.get());
+    vector<SortEntry> entries;
+    mergeSorted(sorted, end, entries);
+    for (uint64_t i = plan.offset; i < entries.size(); i++)
+        sink.write(entries[i].text);
 }
 
-void selectColumnsWhere(string tablename, vector<string> wanted, string whereColCond, string whereVal, string op)
-{
-    TableData t = readTable(tablename);
+static const Filter* activeFilter(const Filter& f) { return f.empty() ? nullptr : &f; }
 
-    if (t.columns.empty())
-    {
+static void reportWhereError(const string& err)
+{
+    // Unknown columns were reported by findColumn already.
+    if (err.empty())
         return;
+    setColor(12);
+    cout << "Error: " << err << ".\n";
+    setColor(15);
+}
+
+// Which tables of a join a condition reads: bit 0 the FROM table, bit 1 the
+// JOIN table. 0 when a column does not resolve.
+static int conditionTables(const SelectPlan& plan, const Condition& cond)
+{
+    if (cond.kind != COND_COMPARE) {
+        int tables = 0;
+        for (auto& o : cond.operands) {
+            int t = conditionTables(plan, o);
+            if (t == 0)
+                return 0;
+            tables |= t;
+        }
+        return tables;
     }
+    int col = findColumn(plan, cond.column);
+    return col == -1 ? 0 : col < (int)plan.tableSchema.columns.size() ? 1 : 2;
+}
 
-    unordered_map<string, int> colIndex;
-    for (int i = 0; i < t.columns.size(); i++)
-        colIndex[t.columns[i]] = i;
+// The AND of some conjuncts of a condition.
+static Condition allOf(vector<Condition>& parts)
+{
+    if (parts.size() == 1)
+        return parts[0];
+    Condition c;
+    c.kind = COND_AND;
+    c.operands = parts;
+    return c;
+}
 
-    if (colIndex.find(whereColCond) == colIndex.end())
+// In a join, each top-level conjunct of the WHERE goes to the scan of the
+// one table it reads, or is left for the joined rows when it needs both.
+static bool planJoinWhere(const SelectQuery& sq, SelectPlan& plan)
+{
+    vector<Condition> parts[3];
+    vector<Condition> conjuncts = sq.where.kind == COND_AND ? sq.where.operands : vector<Condition>{ sq.where };
+    for (auto& c : conjuncts)
     {
-        setColor(12);
-        cout << "Error: Column '" << whereColCond << "' not found.\n";
-        setColor(15);
-        return;
+        int tables = conditionTables(plan, c);
+        if (tables == 0)
+            return false;
+        parts[tables - 1].push_back(c);
     }
 
-    int whereIdx = colIndex[whereColCond];
-
-    setColor(11);
-    for (auto c : wanted)
-        cout << c << "\t";
-    cout << endl;
-    setColor(15);
-
-    for (auto row : t.rows)
+    int split = (int)plan.tableSchema.columns.size();
+    ColumnResolver both = [&](const string& column, string&) { return findColumn(plan, column); };
+    ColumnResolver joinTable = [&](const string& column, string&) {
+        int col = findColumn(plan, column);
+        return col == -1 ? -1 : col - split;
+    };
+    string err;
+    conditionValues(sq.where, plan.where.values);
+    if ((!parts[0].empty() && !plan.where.filter.prepare(plan.tableSchema, allOf(parts[0]), both, err))
+        || (!parts[1].empty() && !plan.joinWhere.prepare(plan.joinSchema, allOf(parts[1]), joinTable, err))
+        || (!parts[2].empty() && !plan.bothWhere.prepare(plan.schema, allOf(parts[2]), both, err)))
     {
-        if (compareValues(row[whereIdx], whereVal, op))
-        {
-            for (auto& c : wanted)
-                cout << row[colIndex[c]] << "\t";
-            cout << "\n";
-        }
+        reportWhereError(err);
+        return false;
     }
+    plan.where.filter.setStatistics(tableStats(sq.tableName));
+    plan.joinWhere.setStatistics(tableStats(sq.joinTable));
+    return true;
 }
 
-string extractOperator(const string& cond, int& opPos, int& opLen)
+// Lays the JOIN table's columns after those of the FROM table in plan.schema
+// and resolves the ON columns.
+static bool planJoin(const SelectQuery& sq, SelectPlan& plan)
 {
-    if (cond.find(">=") != string::npos)
+    plan.hasJoin = true;
+    plan.joinTable = sq.joinTable;
+    if (upperWord(sq.joinTable) == upperWord(sq.tableName)) {
+        setColor(12); cout << "Error: A table cannot be joined with itself.\n"; setColor(15);
+        return false;
+    }
+    if (!readTableSchema(sq.joinTable, plan.joinSchema))
     {
-        opPos = cond.find(">=");
-        opLen = 2;
-        return ">=";
+        reportMissingTable(sq.joinTable);
+        return false;
+    }
+
+    plan.tableSchema = plan.schema;
+    TableData& t = plan.schema;
+    const TableData& j = plan.joinSchema;
+    t.columns.insert(t.columns.end(), j.columns.begin(), j.columns.end());
+    t.types.insert(t.types.end(), j.types.begin(), j.types.end());
+    t.lengths.insert(t.lengths.end(), j.lengths.begin(), j.lengths.end());
+    t.notNull.insert(t.notNull.end(), j.notNull.begin(), j.notNull.end());
+    t.primaryKeyIndex = -1;
+
+    int left = findColumn(plan, sq.joinLeft);
+    int right = findColumn(plan, sq.joinRight);
+    if (left == -1 || right == -1)
+        return false;
+    int split = (int)plan.tableSchema.columns.size();
+    if (left >= split)
+        swap(left, right);
+    if (left >= split || right < split) {
+        setColor(12); cout << "Error: JOIN ... ON must compare a column of '" << sq.tableName << "' with a column of '" << sq.joinTable << "'.\n"; setColor(15);
+        return false;
     }
-    if (cond.find("<=") != string::npos)
+    if (!joinKeyType(typeCode(t.types[left]), typeCode(t.types[right]), plan.joinKeyType)) {
+        setColor(12); cout << "Error: Cannot join " << t.types[left] << " column '" << t.columns[left] << "' with " << t.types[right] << " column '" << t.columns[right] << "'.\n"; setColor(15);
+        return false;
+    }
+    plan.tableKey = left;
+    plan.joinKey = right - split;
+    return true;
+}
+
+bool planSelect(const SelectQuery& sq, SelectPlan& plan)
+{
+    plan = SelectPlan();
+    plan.tableName = sq.tableName;
+    if (!readTableSchema(sq.tableName, plan.schema))
     {
-        opPos = cond.find("<=");
-        opLen = 2;
-        return "<=";
+        reportMissingTable(sq.tableName);
+        return false;
     }
-    if (cond.find("!=") != string::npos)
+    if (sq.hasJoin && !planJoin(sq, plan))
+        return false;
+
+    // Columns are matched case-insensitively and printed as the table names them.
+    const TableData& t = plan.schema;
+    for (auto& g : sq.groupBy)
     {
-        opPos = cond.find("!=");
-        opLen = 2;
-        return "!=";
+        int col = findColumn(plan, g);
+        if (col == -1)
+            return false;
+        plan.groupColumns.push_back(col);
+    }
+
+    plan.aggregate = !sq.groupBy.empty();
+    for (auto& item : sq.items)
+        if (item.aggregate != AGG_NONE)
+            plan.aggregate = true;
+    for (auto& o : sq.orderBy)
+        if (o.item.aggregate != AGG_NONE)
+            plan.aggregate = true;
+    if (plan.aggregate && sq.items.empty()) {
+        setColor(12); cout << "Error: SELECT * cannot be used with GROUP BY.\n"; setColor(15);
+        return false;
     }
 
-    if (cond.find("=") != string::npos)
+    for (auto& item : sq.items)
     {
-        opPos = cond.find("=");
-        opLen = 1;
-        return "=";
+        int col;
+        if (!itemColumn(plan, item, col))
+            return false;
+        int picked = plan.aggregate ? resultColumn(plan, item, col) : col;
+        if (picked == -1)
+            return false;
+        plan.picked.push_back(picked);
+        if (item.aggregate == AGG_NONE)
+            plan.header.push_back(t.columns[col]);
+        else
+            plan.header.push_back(string(functionNames[item.aggregate]) + "(" + (col == -1 ? "*" : t.columns[col]) + ")");
     }
-    if (cond.find(">") != string::npos)
+    if (sq.items.empty())
+        for (int c = 0; c < (int)t.columns.size(); c++) {
+            plan.picked.push_back(c);
+            plan.header.push_back(t.columns[c]);
+        }
+
+    // ORDER BY may name any column of the table; in an aggregate query a
+    // GROUP BY column or an aggregate, which need not be selected.
+    for (auto& o : sq.orderBy)
     {
-        opPos = cond.find(">");
-        opLen = 1;
-        return ">";
+        int col;
+        if (!itemColumn(plan, o.item, col))
+            return false;
+        SortColumn sort;
+        sort.descending = o.descending;
+        sort.column = plan.aggregate ? resultColumn(plan, o.item, col) : col;
+        if (sort.column == -1)
+            return false;
+        if (o.item.aggregate == AGG_NONE)
+            sort.type = typeCode(t.types[col]);
+        else
+            sort.type = aggregateType(plan.aggregates[sort.column - plan.groupColumns.size()], t);
+        plan.order.push_back(sort);
     }
-    if (cond.find("<") != string::npos)
+    plan.hasLimit = sq.hasLimit;
+    plan.limit = sq.limit;
+    plan.offset = sq.offset;
+
+    plan.hasWhere = sq.hasWhere;
+    if (!sq.hasWhere)
+        return true;
+    if (plan.hasJoin)
+        return planJoinWhere(sq, plan);
+
+    string err;
+    ColumnResolver resolve = [&](const string& column, string&) { return findColumn(plan, column); };
+    if (!planWhere(sq.tableName, plan.schema, sq.where, resolve, plan.where, err))
     {
-        opPos = cond.find("<");
-        opLen = 1;
-        return "<";
+        reportWhereError(err);
+        return false;
     }
-
-    return "";
+    return true;
 }
 
-void parseSelect(string cmd)
+// Rows of a join side that pass its filter. Only analyzed tables are
+// discounted by the filter's selectivity; fixed guesses would say little.
+static double estimatedRows(const TableScanner& scan, const Filter& filter)
 {
-    if (!cmd.empty() && cmd.back() == ';')
-        cmd.pop_back();
-
-    string upper = cmd;
-    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-    upper = trim_Middle(upper);
+    return (double)scan.rowCount() * (filter.analyzed() ? filter.selectivity() : 1);
+}
 
-    if (upper.find("SELECT") != 0)
+bool runSelect(SelectPlan& plan)
+{
+    string err;
+    if (plan.hasWhere && (!(plan.hasJoin ? plan.where.filter.bind(plan.tableSchema, plan.where.values, err)
+            : bindWhere(plan.schema, plan.where, err))
+        || !plan.joinWhere.bind(plan.joinSchema, plan.where.values, err)
+        || !plan.bothWhere.bind(plan.schema, plan.where.values, err)))
     {
         setColor(12);
-        cout << "Error: SELECT syntax.\n";
+        cout << "Error: " << err << ".\n";
         setColor(15);
-        return;
+        return false;
     }
 
-    int fromPos = upper.find("FROM");
-    if (fromPos == -1)
+    // Index hits are checked against the rest of the condition. Otherwise
+    // the table is streamed through a parallel scan, so only the printed
+    // columns of matching rows are ever copied.
+    vector<uint64_t> locations;
+    vector<vector<string>> rows;
+    TableScanner left, right;
+    TableScanner* scan = &left;
+    const Filter* filter = activeFilter(plan.where.filter);
+    HashJoin join(plan.joinKeyType);
+    ScanSource source;
+    bool indexed = false;
+
+    if (plan.hasJoin)
     {
-        setColor(12);
-        cout << "Error: Missing FROM.\n";
-        setColor(15);
-        return;
-    }
-
-    string colsPart = trim(cmd.substr(6, fromPos - 6));
-    vector<string> wanted;
-
-    if (colsPart == "*")
-    {
-        wanted = { "*" };
+        // The side with fewer rows left after its part of the WHERE is
+        // hashed and the other one probes it.
+        if (!left.open(plan.tableName) || !right.open(plan.joinTable))
+            return false;
+        bool buildLeft = estimatedRows(left, plan.where.filter) < estimatedRows(right, plan.joinWhere);
+        int split = (int)plan.tableSchema.columns.size();
+        scan = buildLeft ? &right : &left;
+        source.join = &join;
+        source.joined = activeFilter(plan.bothWhere);
+        source.probeKey = buildLeft ? plan.joinKey : plan.tableKey;
+        source.probeOffset = buildLeft ? split : 0;
+        source.buildOffset = buildLeft ? 0 : split;
+
+        const Filter* joinFilter = activeFilter(plan.joinWhere);
+        if (!join.build(buildLeft ? left : right, buildLeft ? plan.tableKey : plan.joinKey, buildLeft ? filter : joinFilter))
+        {
+            setColor(12);
+            cout << "Error: Table '" << (buildLeft ? plan.tableName : plan.joinTable) << "' has too many rows to join.\n";
+            setColor(15);
+            return false;
+        }
+        if (buildLeft)
+            filter = joinFilter;
     }
     else
     {
-        wanted = split(colsPart, ',');
+        indexed = plan.hasWhere
+            && fetchWhereRows(plan.tableName, plan.schema, plan.where, locations, rows);
+        if (!indexed && !left.open(plan.tableName))
+            return false;
     }
 
-    int wherePos = upper.find("WHERE");
-    string tableName;
-
-    if (wherePos == -1)
+    if (plan.aggregate)
     {
-        tableName = trim(cmd.substr(fromPos + 4));
-
-        if (wanted[0] == "*")
-            selectAll(tableName);
+        HashAggregator total(plan.schema, plan.groupColumns, plan.aggregates);
+        if (indexed)
+        {
+            for (auto& row : rows)
+                total.add(row);
+        }
         else
-            selectColumns(tableName, wanted);
-
-        return;
+        {
+            // Each morsel aggregates on its own; the partial results are
+            // merged in table order.
+            vector<unique_ptr<HashAggregator>> partial(scan->morsels(SCAN_MORSEL_ROWS).size());
+            parallelScan(*scan, filter,
+                [&](TableScanner& cursor, size_t m) {
+                    partial[m] = make_unique<HashAggregator>(plan.schema, plan.groupColumns, plan.aggregates);
+                    string key;
+                    while (cursor.next())
+                        source.rows(cursor, key, [&](auto& row) { partial[m]->add(row); });
+                },
+                [&](size_t m) {
+                    total.merge(*partial[m]);
+                    partial[m].reset();
+                });
+        }
+        total.results(rows);
+        indexed = true;
     }
 
-    tableName = trim(cmd.substr(fromPos + 4, wherePos - (fromPos + 4)));
-
-    string cond = trim(cmd.substr(wherePos + 5));
-
-    int opPos = -1;
-    int opLen = 0;
-    string op = extractOperator(cond, opPos, opLen);
+    ResultSink sink;
+    sink.header(plan.header);
+    uint64_t end = !plan.hasLimit ? UINT64_MAX
+        : plan.limit > UINT64_MAX - plan.offset ? UINT64_MAX : plan.offset + plan.limit;
 
-    if (op.empty())
+    if (!plan.order.empty())
     {
-        setColor(12);
-        cout << "Error: Invalid WHERE clause. Expected operator (=, !=, >, <, >=, <=).\n";
-        setColor(15);
-        return;
+        printSorted(plan, indexed ? &rows : nullptr, *scan, filter, source, end, sink);
+        return true;
     }
-
-    string whereCol = trim(cond.substr(0, opPos));
-    string whereVal = trim(cond.substr(opPos + opLen));
-
-    if (whereCol.empty() || whereVal.empty())
+    if (indexed)
     {
-        setColor(12);
-        cout << "Error: Invalid WHERE clause format.\n";
-        setColor(15);
-        return;
+        for (uint64_t i = plan.offset; i < rows.size() && i < end; i++)
+            sink.row(rows[i], plan.picked);
+        return true;
     }
-
-    if (wanted[0] == "*")
+    if (plan.hasLimit)
     {
-        TableData t = readTable(tableName);
-        wanted = t.columns;
+        // Read serially so the scan ends with the last row wanted.
+        scan->setFilter(filter);
+        uint64_t i = 0;
+        string key;
+        while (i < end && scan->next())
+            source.rows(*scan, key, [&](auto& row) {
+                if (i >= end || i++ < plan.offset)
+                    return;
+                for (int c : plan.picked)
+                    sink.field(cell(row, c));
+                sink.endRow();
+            });
+        return true;
     }
 
-    selectColumnsWhere(tableName, wanted, whereCol, whereVal, op);
-}
\ No newline at end of file
+    printScan(*scan, filter, source, plan.picked, sink);
+    return true;
+}
+
+bool executeSelect(const SelectQuery& sq)
+{
+    SelectPlan plan;
+    return planSelect(sq, plan) && runSelect(plan);
+}
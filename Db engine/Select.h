@@ -1,13 +1,43 @@
 #pragma once
 #include <string>
 #include <vector>
+#include "utils.h"
+#include "parser.h"
+#include "filter.h"
+#include "aggregate.h"
+#include "sort.h"
+#include "join.h"
 using namespace std;
 
+// A SELECT with its table, columns, condition and index access resolved, so
+// it can run again with only the WHERE values changed (see Prepare.h).
+struct SelectPlan
+{
+    string tableName;
+    TableData schema;           // with a JOIN, the columns of both tables
+    vector<int> picked;         // table columns, or columns of the aggregate results
+    vector<string> header;
+    bool aggregate = false;
+    vector<int> groupColumns;
+    vector<AggregateSpec> aggregates;
+    vector<SortColumn> order;   // over the same columns as picked
+    bool hasLimit = false;
+    uint64_t limit = 0;
+    uint64_t offset = 0;
+    bool hasWhere = false;
+    WhereClause where;          // with a JOIN, the conjuncts on the FROM table
 
-void selectAll(string tableName);
+    bool hasJoin = false;
+    string joinTable;
+    TableData tableSchema;
+    TableData joinSchema;
+    int tableKey = -1;          // the ON columns, each within its own table
+    int joinKey = -1;
+    ColType joinKeyType = COL_INT;
+    Filter joinWhere;           // the conjuncts on the JOIN table
+    Filter bothWhere;           // the conjuncts that need both tables, on joined rows
+};
 
-void selectColumns(string tableName, vector<string> wanted);
-
-void selectColumnsWhere(string tablename, vector<string>wanted, string whereColCond, string whereVal);
-
-void parseSelect(string cmd);
+bool planSelect(const SelectQuery& sq, SelectPlan& plan);
+bool runSelect(SelectPlan& plan);
+bool executeSelect(const SelectQuery& sq);
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include "settings.h"
+#include "filterkernels.h"
+#include "threadpool.h"
+#include "writeaheadlog.h"
+#include "vacuum.h"
+#include "utils.h"
+using namespace std;
+
+static bool parseCount(const string& text, long long& out)
+{
+    if (text.empty() || text.size() > 12)
+        return false;
+    for (char c : text)
+        if (!isdigit((unsigned char)c))
+            return false;
+    out = stoll(text);
+    return true;
+}
+
+bool executeSet(const SetQuery& q)
+{
+    const string& name = q.name;
+    string value = q.value;
+
+    long long number;
+    if (name == "SIMD")
+    {
+        toUpper(value);
+        SimdLevel level;
+        if (value == "AUTO") level = detectSimdLevel();
+        else if (value == "AVX2") level = SIMD_AVX2;
+        else if (value == "SSE42" || value == "SSE4.2") level = SIMD_SSE42;
+        else if (value == "SCALAR") level = SIMD_SCALAR;
+        else {
+            setColor(12); cout << "Error: SIMD must be AUTO, AVX2, SSE42 or SCALAR.\n"; setColor(15);
+            return false;
+        }
+        setSimdLevel(level);
+        setColor(10); cout << "Filter kernels set to " << simdLevelName(activeSimdLevel()) << ".\n"; setColor(15);
+    }
+    else if (name == "THREADS")
+    {
+        if (!parseCount(value, number) || number > 1024) {
+            setColor(12); cout << "Error: THREADS must be a whole number from 0 to 1024.\n"; setColor(15);
+            return false;
+        }
+        ThreadPool::instance().resize(number == 0 ? defaultThreadCount() : (unsigned)number);
+        setColor(10); cout << "Scan threads set to " << ThreadPool::instance().size() << ".\n"; setColor(15);
+    }
+    else if (name == "SYNC")
+    {
+        toUpper(value);
+        WalSyncMode mode;
+        if (value == "FULL") mode = WAL_SYNC_FULL;
+        else if (value == "GROUP") mode = WAL_SYNC_GROUP;
+        else if (value == "OFF") mode = WAL_SYNC_OFF;
+        else {
+            setColor(12); cout << "Error: SYNC must be FULL, GROUP or OFF.\n"; setColor(15);
+            return false;
+        }
+        setWalSyncMode(mode);
+        setColor(10); cout << "Commit sync mode set to " << walSyncModeName(mode) << ".\n"; setColor(15);
+    }
+    else if (name == "SYNC_INTERVAL")
+    {
+        if (!parseCount(value, number) || number < 1 || number > 10000) {
+            setColor(12); cout << "Error: SYNC_INTERVAL must be a whole number of milliseconds from 1 to 10000.\n"; setColor(15);
+            return false;
+        }
+        setWalGroupInterval((unsigned)number);
+        setColor(10); cout << "Group commit interval set to " << number << " ms.\n"; setColor(15);
+    }
+    else if (name == "VACUUM_THRESHOLD")
+    {
+        if (!parseCount(value, number) || number > 100) {
+            setColor(12); cout << "Error: VACUUM_THRESHOLD must be a whole percentage from 0 to 100.\n"; setColor(15);
+            return false;
+        }
+        setVacuumThreshold((unsigned)number);
+        setColor(10);
+        if (number == 0)
+            cout << "Automatic vacuum disabled.\n";
+        else
+            cout << "Tables are vacuumed once " << number << "% of their rows are deleted.\n";
+        setColor(15);
+    }
+    else
+    {
+        setColor(12); cout << "Error: Unknown setting '" << name << "'.\n"; setColor(15);
+        return false;
+    }
+    return true;
+}
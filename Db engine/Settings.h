@@ -0,0 +1,17 @@
+#pragma once
+#ifndef SETTINGS_H
+#define SETTINGS_H
+#include <string>
+#include "parser.h"
+using namespace std;
+
+// SET name = value
+//   SIMD       : AUTO, AVX2, SSE42 or SCALAR filter kernels (see FilterKernels.h)
+//   THREADS    : scan threads, 0 for one per hardware thread (see ThreadPool.h)
+//   SYNC       : FULL, GROUP or OFF commit durability (see WriteAheadLog.h)
+//   SYNC_INTERVAL : group commit interval in milliseconds
+//   VACUUM_THRESHOLD : percentage of deleted rows that triggers an automatic
+//              VACUUM, 0 to disable (see Vacuum.h)
+bool executeSet(const SetQuery& q);
+
+#endif
@@ -0,0 +1,174 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "sort.h"
+#include "rowview.h"
+#include "threadpool.h"
+using namespace std;
+
+static void appendBigEndian(string& key, uint64_t v)
+{
+    char bytes[8];
+    for (int i = 7; i >= 0; i--) {
+        bytes[i] = (char)(v & 0xFF);
+        v >>= 8;
+    }
+    key.append(bytes, 8);
+}
+
+template <class Row>
+static void encodeKey(string& key, Row& row, const vector<SortColumn>& order, uint64_t sequence)
+{
+    key.clear();
+    for (auto& o : order)
+    {
+        if (row.isNull(o.column)) {
+            key += '\x01';
+            continue;
+        }
+        key += '\0';
+        size_t start = key.size();
+        if (o.type == COL_INT)
+            appendBigEndian(key, (uint64_t)row.integer(o.column) ^ (1ull << 63));
+        else if (o.type == COL_FLOAT || o.type == COL_DOUBLE) {
+            double v = row.real(o.column);
+            if (v == 0)
+                v = 0;      // -0.0 orders with 0.0
+            uint64_t bits;
+            memcpy(&bits, &v, sizeof bits);
+            appendBigEndian(key, bits >> 63 ? ~bits : bits | (1ull << 63));
+        }
+        else {
+            for (char c : row.text(o.column)) {
+                key += c;
+                if (c == '\0')
+                    key += '\xFF';
+            }
+            key.append(2, '\0');
+        }
+
+        if (o.descending)
+            for (size_t i = start; i < key.size(); i++)
+                key[i] = (char)~key[i];
+    }
+    appendBigEndian(key, sequence);
+}
+
+SortBuffer::SortBuffer(const vector<SortColumn>& order, uint64_t keep)
+    : order(order), keep(keep), bounded(keep <= SORT_TOPK_MAX_ROWS)
+{
+}
+
+template <class Row>
+void SortBuffer::addRow(Row& row, const vector<int>& picked, uint64_t sequence)
+{
+    encodeKey(key, row, order, sequence);
+
+    string* text;
+    if (bounded)
+    {
+        // The heap's top is the worst row kept so far.
+        if (heap.size() < keep)
+            heap.emplace_back();
+        else if (keep > 0 && key < heap.front().key)
+            pop_heap(heap.begin(), heap.end());
+        else
+            return;
+        heap.back().key = key;
+        text = &heap.back().text;
+        text->clear();
+    }
+    else
+    {
+        bounds.push_back(arena.size());
+        arena += key;
+        bounds.push_back(arena.size());
+        text = &arena;
+    }
+
+    for (int c : picked) {
+        string_view v = row.text(c);
+        text->append(v.data(), v.size());
+        *text += '\t';
+    }
+    *text += '\n';
+    if (bounded)
+        push_heap(heap.begin(), heap.end());
+}
+
+void SortBuffer::add(TableScanner& cursor, const vector<int>& picked, uint64_t sequence)
+{
+    CursorRow row{ cursor };
+    addRow(row, picked, sequence);
+}
+
+void SortBuffer::add(const vector<string>& row, const vector<int>& picked, uint64_t sequence)
+{
+    TextRow text{ row };
+    addRow(text, picked, sequence);
+}
+
+void SortBuffer::add(const JoinedRow& row, const vector<int>& picked, uint64_t sequence)
+{
+    JoinedRow joined = row;
+    addRow(joined, picked, sequence);
+}
+
+void SortBuffer::finish()
+{
+    entries.clear();
+    if (bounded)
+    {
+        sort_heap(heap.begin(), heap.end());
+        for (auto& r : heap)
+            entries.push_back({ r.key, r.text });
+        return;
+    }
+
+    entries.reserve(bounds.size() / 2);
+    string_view all = arena;
+    for (size_t i = 0; i < bounds.size(); i += 2)
+    {
+        size_t end = i + 2 < bounds.size() ? bounds[i + 2] : arena.size();
+        entries.push_back({ all.substr(bounds[i], bounds[i + 1] - bounds[i]),
+                            all.substr(bounds[i + 1], end - bounds[i + 1]) });
+    }
+    sort(entries.begin(), entries.end(),
+        [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+}
+
+void mergeSorted(vector<SortBuffer*>& buffers, uint64_t keep, vector<SortEntry>& out)
+{
+    vector<vector<SortEntry>> runs;
+    for (auto* b : buffers)
+        runs.push_back(move(b->entries));
+
+    auto less = [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; };
+    while (runs.size() > 1)
+    {
+        vector<vector<SortEntry>> merged((runs.size() + 1) / 2);
+        ThreadPool::instance().parallelFor(merged.size(), [&](size_t i) {
+            if (2 * i + 1 == runs.size()) {
+                merged[i] = move(runs[2 * i]);
+                return;
+            }
+            vector<SortEntry>& a = runs[2 * i];
+            vector<SortEntry>& b = runs[2 * i + 1];
+            uint64_t n = min<uint64_t>(keep, a.size() + b.size());
+            merged[i].resize(n);
+            // Merging only as many rows as are kept.
+            size_t x = 0, y = 0;
+            for (uint64_t k = 0; k < n; k++)
+                merged[i][k] = y == b.size() || (x < a.size() && less(a[x], b[y])) ? a[x++] : b[y++];
+        });
+        runs.swap(merged);
+    }
+
+    out.clear();
+    if (!runs.empty())
+        out = move(runs[0]);
+    if (out.size() > keep)
+        out.resize(keep);
+}
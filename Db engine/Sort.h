@@ -0,0 +1,87 @@
+#pragma once
+#ifndef SORT_H
+#define SORT_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+#include "tablescanner.h"
+#include "rowview.h"
+using namespace std;
+
+// Sorting for SELECT ... ORDER BY.
+//
+// Each row gets a sort key: its ORDER BY values encoded so that comparing
+// two keys byte-wise gives the ORDER BY order. Integers are stored
+// big-endian with the sign bit flipped, floating point numbers with the
+// usual sign-magnitude fix-up, so numbers compare numerically; strings are
+// zero-terminated with embedded zeros escaped. Each value follows a marker
+// byte that sorts a NULL after every value, ASC or DESC, and DESC columns
+// have their value bytes inverted. The key ends with the row's position in
+// the table, which keeps equal rows in table order.
+//
+// A SortBuffer collects the rows of one morsel, as keys plus their already
+// formatted output text, and sorts them on its own thread. Under a LIMIT it
+// keeps only the best rows in a bounded max-heap, so a row that cannot make
+// the cut is never formatted. mergeSorted then merges the sorted buffers
+// pairwise on the thread pool.
+
+const uint64_t SORT_TOPK_MAX_ROWS = 100000;     // larger LIMITs sort everything
+
+struct SortColumn
+{
+    int column = 0;
+    ColType type = COL_INT;     // the type of the value being ordered on
+    bool descending = false;
+};
+
+struct SortEntry
+{
+    string_view key;
+    string_view text;
+};
+
+class SortBuffer
+{
+public:
+    // keep is the number of leading rows wanted, UINT64_MAX for all.
+    SortBuffer(const vector<SortColumn>& order, uint64_t keep);
+    SortBuffer(const SortBuffer&) = delete;
+    SortBuffer& operator=(const SortBuffer&) = delete;
+
+    // The picked columns of a row, printed tab-separated like a scan prints
+    // them. sequence is the row's position in the table.
+    void add(TableScanner& cursor, const vector<int>& picked, uint64_t sequence);
+    void add(const vector<string>& row, const vector<int>& picked, uint64_t sequence);
+    void add(const JoinedRow& row, const vector<int>& picked, uint64_t sequence);
+
+    // Sorts the buffer; the rows are then in entries, in order.
+    void finish();
+    vector<SortEntry> entries;
+
+private:
+    struct HeapRow
+    {
+        string key;
+        string text;
+        bool operator<(const HeapRow& other) const { return key < other.key; }
+    };
+
+    const vector<SortColumn>& order;
+    uint64_t keep;
+    bool bounded;
+    vector<HeapRow> heap;       // under a LIMIT
+    string arena;               // otherwise keys and texts end to end
+    vector<size_t> bounds;      // per row: key start, text start
+    string key;
+
+    template <class Row> void addRow(Row& row, const vector<int>& picked, uint64_t sequence);
+};
+
+// Merges sorted buffers into out, keeping at most keep rows. The entries
+// point into the buffers, which must outlive out.
+void mergeSorted(vector<SortBuffer*>& buffers, uint64_t keep, vector<SortEntry>& out);
+
+#endif
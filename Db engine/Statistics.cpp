@@ -0,0 +1,449 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "statistics.h"
+#include "tablescanner.h"
+#include "parallelscan.h"
+#include "aggregate.h"
+#include "resultsink.h"
+using namespace std;
+
+static const char* STATS_MAGIC = "ITSTATS 1";
+
+static string statsFile(string tableName)
+{
+    return tableName + ".stats";
+}
+
+static bool isNumeric(ColType type)
+{
+    return type == COL_INT || type == COL_FLOAT || type == COL_DOUBLE;
+}
+
+static unsigned leadingZeros(uint64_t x)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, x);
+    return 63 - i;
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+void HyperLogLog::add(uint64_t hash)
+{
+    // hashKey() is built for hash tables; the sketch wants all 64 bits mixed.
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+
+    size_t r = hash >> (64 - STATS_HLL_BITS);
+    uint8_t rank = (uint8_t)leadingZeros((hash << STATS_HLL_BITS) | (1ull << (STATS_HLL_BITS - 1))) + 1;
+    if (rank > registers[r])
+        registers[r] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other)
+{
+    for (size_t r = 0; r < registers.size(); r++)
+        registers[r] = max(registers[r], other.registers[r]);
+}
+
+uint64_t HyperLogLog::estimate() const
+{
+    double m = (double)registers.size();
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t v : registers) {
+        sum += ldexp(1.0, -(int)v);
+        zeros += v == 0;
+    }
+    double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // Few values leave most registers empty; counting those is more accurate.
+    if (e <= 2.5 * m && zeros)
+        e = m * log(m / zeros);
+    return (uint64_t)llround(e);
+}
+
+// What one morsel of ANALYZE found about a column.
+struct ColumnSummary
+{
+    uint64_t nulls = 0;
+    uint64_t values = 0;
+    double lowValue = 0, highValue = 0;
+    string low, high;
+    HyperLogLog sketch;
+    vector<double> numbers;     // the sampled values of a numeric column
+    vector<string> strings;     // or of a string column
+};
+
+static string formatNumber(ColType type, double v)
+{
+    char buf[TBL_VALUE_SCRATCH];
+    char* end = type == COL_FLOAT ? to_chars(buf, buf + sizeof buf, (float)v).ptr : to_chars(buf, buf + sizeof buf, v).ptr;
+    return string(buf, end);
+}
+
+static void summarize(TableScanner& cursor, const vector<ColType>& types, uint64_t step, vector<ColumnSummary>& out)
+{
+    uint64_t seen = 0;
+    while (cursor.next())
+    {
+        bool sampled = seen++ % step == 0;
+        for (size_t c = 0; c < types.size(); c++)
+        {
+            ColumnSummary& s = out[c];
+            int col = (int)c;
+            if (cursor.isNull(col)) {
+                s.nulls++;
+                continue;
+            }
+            bool first = s.values++ == 0;
+            if (types[c] == COL_INT)
+            {
+                int64_t v = cursor.intField(col);
+                s.sketch.add(hashKey((const char*)&v, sizeof v));
+                double d = (double)v;
+                if (first || d < s.lowValue)
+                    s.lowValue = d, s.low = to_string(v);
+                if (first || d > s.highValue)
+                    s.highValue = d, s.high = to_string(v);
+                if (sampled)
+                    s.numbers.push_back(d);
+            }
+            else if (isNumeric(types[c]))
+            {
+                double v = cursor.realField(col);
+                if (v == 0)
+                    v = 0;      // -0.0 is the same value as 0.0
+                s.sketch.add(hashKey((const char*)&v, sizeof v));
+                if (first || v < s.lowValue)
+                    s.lowValue = v, s.low = formatNumber(types[c], v);
+                if (first || v > s.highValue)
+                    s.highValue = v, s.high = formatNumber(types[c], v);
+                if (sampled)
+                    s.numbers.push_back(v);
+            }
+            else
+            {
+                string_view v = cursor.field(col);
+                s.sketch.add(hashKey(v.data(), v.size()));
+                if (first || v < string_view(s.low))
+                    s.low.assign(v.data(), v.size());
+                if (first || v > string_view(s.high))
+                    s.high.assign(v.data(), v.size());
+                if (sampled)
+                    s.strings.emplace_back(v);
+            }
+        }
+    }
+}
+
+static void mergeSummary(ColumnSummary& to, ColumnSummary& from, ColType type)
+{
+    to.nulls += from.nulls;
+    to.sketch.merge(from.sketch);
+    to.numbers.insert(to.numbers.end(), from.numbers.begin(), from.numbers.end());
+    for (auto& s : from.strings)
+        to.strings.push_back(move(s));
+    if (from.values == 0)
+        return;
+
+    bool first = to.values == 0;
+    to.values += from.values;
+    bool lower = isNumeric(type) ? from.lowValue < to.lowValue : from.low < to.low;
+    bool higher = isNumeric(type) ? from.highValue > to.highValue : from.high > to.high;
+    if (first || lower) {
+        to.lowValue = from.lowValue;
+        to.low = move(from.low);
+    }
+    if (first || higher) {
+        to.highValue = from.highValue;
+        to.high = move(from.high);
+    }
+}
+
+// Bucket bounds splitting a sorted sample into equal parts.
+template <class T>
+static vector<T> histogramBounds(const vector<T>& sorted)
+{
+    vector<T> bounds;
+    if (sorted.empty())
+        return bounds;
+    size_t buckets = min(STATS_HISTOGRAM_BUCKETS, sorted.size() - 1);
+    for (size_t i = 0; i <= buckets; i++)
+        bounds.push_back(sorted[buckets ? i * (sorted.size() - 1) / buckets : 0]);
+    return bounds;
+}
+
+static bool writeStats(string tableName, const TableStats& stats)
+{
+    string tmp = statsFile(tableName) + ".tmp";
+    {
+        ofstream f(tmp, ios::binary | ios::trunc);
+        auto text = [&](const string& s) { f << s.size() << " " << s << "\n"; };
+        f << STATS_MAGIC << "\n" << stats.rows << " " << stats.columns.size() << "\n";
+        for (auto& c : stats.columns)
+        {
+            f << c.nulls << " " << c.distinct << " " << c.bounds.size() << "\n";
+            text(c.low);
+            text(c.high);
+            for (auto& b : c.bounds)
+                text(b);
+        }
+        if (!f.good())
+            return false;
+    }
+    return replaceFile(tmp, statsFile(tableName));
+}
+
+static double parseNumber(const string& s)
+{
+    double v = 0;
+    from_chars(s.data(), s.data() + s.size(), v);
+    return v;
+}
+
+static shared_ptr<const TableStats> readStats(string tableName)
+{
+    ifstream f(statsFile(tableName), ios::binary);
+    string magic;
+    if (!getline(f, magic) || magic != STATS_MAGIC)
+        return nullptr;
+
+    TableData schema;
+    if (!readTableSchema(tableName, schema))
+        return nullptr;
+
+    auto text = [&](string& s) {
+        size_t len = 0;
+        if (!(f >> len) || f.get() != ' ')
+            return false;
+        s.resize(len);
+        return f.read(&s[0], len) && f.get() == '\n';
+    };
+    auto stats = make_shared<TableStats>();
+    size_t columns = 0;
+    if (!(f >> stats->rows >> columns) || columns != schema.columns.size())
+        return nullptr;
+    stats->columns.resize(columns);
+    for (size_t c = 0; c < columns; c++)
+    {
+        ColumnStats& s = stats->columns[c];
+        size_t bounds = 0;
+        if (!(f >> s.nulls >> s.distinct >> bounds) || f.get() != '\n' || !text(s.low) || !text(s.high))
+            return nullptr;
+        s.bounds.resize(bounds);
+        for (auto& b : s.bounds)
+            if (!text(b))
+                return nullptr;
+        if (isNumeric(typeCode(schema.types[c]))) {
+            s.lowValue = parseNumber(s.low);
+            s.highValue = parseNumber(s.high);
+            for (auto& b : s.bounds)
+                s.numericBounds.push_back(parseNumber(b));
+        }
+    }
+    return stats;
+}
+
+// Loaded statistics by upper-cased table name; null for tables without any.
+static unordered_map<string, shared_ptr<const TableStats>>& statsCache()
+{
+    static unordered_map<string, shared_ptr<const TableStats>> cache;
+    return cache;
+}
+
+static string statsKey(string tableName)
+{
+    toUpper(tableName);
+    return tableName;
+}
+
+shared_ptr<const TableStats> tableStats(string tableName)
+{
+    auto& cache = statsCache();
+    string key = statsKey(tableName);
+    auto it = cache.find(key);
+    if (it == cache.end())
+        it = cache.emplace(key, readStats(tableName)).first;
+    return it->second;
+}
+
+void dropTableStats(string tableName)
+{
+    remove(statsFile(tableName).c_str());
+    statsCache().erase(statsKey(tableName));
+}
+
+bool analyzeTable(string tableName)
+{
+    TableScanner scan;
+    if (!scan.open(tableName))
+        return false;
+    vector<ColType> types;
+    for (auto& t : scan.schema().types)
+        types.push_back(typeCode(t));
+
+    // Every row goes into the counts and sketches; only every step-th row
+    // of a morsel into the histogram sample.
+    auto stats = make_shared<TableStats>();
+    stats->rows = scan.rowCount();
+    uint64_t step = max<uint64_t>(1, stats->rows / STATS_SAMPLE_ROWS);
+    vector<ColumnSummary> total(types.size());
+    vector<vector<ColumnSummary>> partial(scan.morsels(SCAN_MORSEL_ROWS).size());
+    parallelScan(scan, nullptr,
+        [&](TableScanner& cursor, size_t m) {
+            partial[m].resize(types.size());
+            summarize(cursor, types, step, partial[m]);
+        },
+        [&](size_t m) {
+            for (size_t c = 0; c < types.size(); c++)
+                mergeSummary(total[c], partial[m][c], types[c]);
+            vector<ColumnSummary>().swap(partial[m]);
+        });
+
+    for (size_t c = 0; c < types.size(); c++)
+    {
+        ColumnSummary& s = total[c];
+        ColumnStats out;
+        out.nulls = s.nulls;
+        out.distinct = s.values ? min(s.values, max<uint64_t>(1, s.sketch.estimate())) : 0;
+        out.low = s.low;
+        out.high = s.high;
+        out.lowValue = s.lowValue;
+        out.highValue = s.highValue;
+        if (isNumeric(types[c])) {
+            sort(s.numbers.begin(), s.numbers.end());
+            out.numericBounds = histogramBounds(s.numbers);
+            for (double b : out.numericBounds)
+                out.bounds.push_back(formatNumber(types[c], b));
+        }
+        else {
+            sort(s.strings.begin(), s.strings.end());
+            out.bounds = histogramBounds(s.strings);
+        }
+        stats->columns.push_back(move(out));
+    }
+
+    if (!writeStats(tableName, *stats))
+        return false;
+    statsCache()[statsKey(tableName)] = stats;
+    return true;
+}
+
+// Fraction of a column's values below v, read off the histogram: whole
+// buckets below it, and the part of its own bucket that lies below it.
+static double fractionBelow(const vector<double>& bounds, double v)
+{
+    size_t k = lower_bound(bounds.begin(), bounds.end(), v) - bounds.begin();
+    if (k == 0)
+        return 0;
+    if (k == bounds.size())
+        return 1;
+    double lo = bounds[k - 1], hi = bounds[k];
+    return (k - 1 + (v - lo) / (hi - lo)) / (bounds.size() - 1);
+}
+
+static double fractionBelow(const vector<string>& bounds, const string& v)
+{
+    size_t k = lower_bound(bounds.begin(), bounds.end(), v) - bounds.begin();
+    if (k == 0)
+        return 0;
+    if (k == bounds.size())
+        return 1;
+    return (k - 0.5) / (bounds.size() - 1);
+}
+
+double estimateSelectivity(const TableStats& stats, const TableData& schema, const Predicate& compare)
+{
+    if (stats.rows == 0)
+        return 0;
+    const ColumnStats& s = stats.columns[compare.column()];
+    double nulls = min(1.0, (double)s.nulls / stats.rows);
+    CompareOp op = compare.op();
+    if (compare.operand() == OPERAND_NULL)
+        return op == CMP_EQ ? nulls : op == CMP_NE ? 1 - nulls : 0;
+    if (s.distinct == 0)
+        return 0;
+
+    // Each distinct value is taken to be equally common.
+    double below, equal = 1.0 / s.distinct;
+    if (isNumeric(typeCode(schema.types[compare.column()])))
+    {
+        double v = compare.realValue;
+        below = fractionBelow(s.numericBounds, v);
+        if (v < s.lowValue || v > s.highValue) {
+            equal = 0;
+            below = v < s.lowValue ? 0 : 1;
+        }
+    }
+    else
+    {
+        below = fractionBelow(s.bounds, compare.text);
+        if (compare.text < s.low || compare.text > s.high) {
+            equal = 0;
+            below = compare.text < s.low ? 0 : 1;
+        }
+    }
+
+    double f = 0;
+    switch (op)
+    {
+    case CMP_EQ: f = equal; break;
+    case CMP_NE: f = 1 - equal; break;
+    case CMP_LT: f = below; break;
+    case CMP_LE: f = below + equal; break;
+    case CMP_GT: f = 1 - below - equal; break;
+    case CMP_GE: f = 1 - below; break;
+    }
+    return (1 - nulls) * min(1.0, max(0.0, f));
+}
+
+bool executeAnalyze(const AnalyzeQuery& q)
+{
+    const string& tableName = q.tableName;
+    if (!tableExists(tableName)) {
+        reportMissingTable(tableName);
+        return false;
+    }
+
+    if (!analyzeTable(tableName)) {
+        setColor(12); cout << "Error: Cannot analyze table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+
+    shared_ptr<const TableStats> stats = tableStats(tableName);
+    TableData schema;
+    if (stats && readTableSchema(tableName, schema))
+    {
+        ResultSink sink;
+        sink.header({ "COLUMN", "NULLS", "DISTINCT", "LOW", "HIGH" });
+        for (size_t c = 0; c < stats->columns.size(); c++)
+        {
+            const ColumnStats& s = stats->columns[c];
+            bool any = s.nulls < stats->rows;
+            sink.field(schema.columns[c]);
+            sink.field(to_string(s.nulls));
+            sink.field(to_string(s.distinct));
+            sink.field(any ? s.low : "NULL");
+            sink.field(any ? s.high : "NULL");
+            sink.endRow();
+        }
+    }
+    setColor(10);
+    cout << "Table '" << tableName << "' analyzed: " << (stats ? stats->rows : 0) << " row(s).\n";
+    setColor(15);
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#ifndef STATISTICS_H
+#define STATISTICS_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+#include "predicate.h"
+#include "parser.h"
+using namespace std;
+
+// Column statistics for the planner. ANALYZE table_name reads the table in
+// one parallel scan and records, for each column, the fraction of NULLs,
+// the smallest and largest values, an estimate of the number of distinct
+// values and an equi-depth histogram. The statistics are kept in
+// <table>.stats next to the table and used by later statements to estimate
+// how many rows a comparison lets through: to order the operands of a WHERE
+// condition (see Filter.h), to pick between an index and a scan, and to pick
+// the table a join hashes. Tables that were never analyzed are planned from
+// fixed guesses instead. The statistics are not kept up to date as rows
+// change; ANALYZE again refreshes them.
+//
+// Distinct values are counted with a HyperLogLog sketch of 2^STATS_HLL_BITS
+// registers, which every row is hashed into; its error is about 1.6%. The
+// histogram is built from a sample of about STATS_SAMPLE_ROWS rows taken at
+// even steps through the table and splits it into STATS_HISTOGRAM_BUCKETS
+// buckets holding the same number of values.
+
+const unsigned STATS_HLL_BITS = 12;
+const size_t STATS_SAMPLE_ROWS = 30000;
+const size_t STATS_HISTOGRAM_BUCKETS = 32;
+
+class HyperLogLog
+{
+public:
+    HyperLogLog() : registers(size_t(1) << STATS_HLL_BITS) {}
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);
+    uint64_t estimate() const;
+
+private:
+    vector<uint8_t> registers;
+};
+
+struct ColumnStats
+{
+    uint64_t nulls = 0;
+    uint64_t distinct = 0;          // of the non-NULL values
+    string low, high;               // smallest and largest value, "" when all are NULL
+    double lowValue = 0, highValue = 0; // the same, parsed, for numeric columns
+    vector<string> bounds;          // histogram bucket bounds, lowest first
+    vector<double> numericBounds;
+};
+
+struct TableStats
+{
+    uint64_t rows = 0;
+    vector<ColumnStats> columns;    // by table column
+};
+
+// Scans the table and replaces its statistics.
+bool analyzeTable(string tableName);
+// The statistics of a table, or null when it was never analyzed.
+shared_ptr<const TableStats> tableStats(string tableName);
+void dropTableStats(string tableName);
+
+// Estimated fraction of the table's rows for which compare matches.
+double estimateSelectivity(const TableStats& stats, const TableData& schema, const Predicate& compare);
+
+bool executeAnalyze(const AnalyzeQuery& q);
+
+#endif
@@ -0,0 +1,1835 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include "storage.h"
+#include "utils.h"
+using namespace std;
+
+ColType typeCode(const string& type)
+{
+    string up = type;
+    toUpper(up);
+    if (up == "INT") return COL_INT;
+    if (up == "FLOAT") return COL_FLOAT;
+    if (up == "DOUBLE") return COL_DOUBLE;
+    if (up == "CHAR") return COL_CHAR;
+    return COL_VARCHAR;
+}
+
+static string typeName(ColType type)
+{
+    switch (type)
+    {
+    case COL_INT: return "INT";
+    case COL_FLOAT: return "FLOAT";
+    case COL_DOUBLE: return "DOUBLE";
+    case COL_CHAR: return "CHAR";
+    default: return "VARCHAR";
+    }
+}
+
+size_t columnWidth(ColType type, int length)
+{
+    switch (type)
+    {
+    case COL_INT: return sizeof(int32_t);
+    case COL_FLOAT: return sizeof(float);
+    case COL_DOUBLE: return sizeof(double);
+    case COL_CHAR: return (size_t)max(length, 1);
+    default: return sizeof(uint16_t) + (size_t)max(length, 1);
+    }
+}
+
+static size_t padded(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+size_t bitmapSize(uint32_t rowCount)
+{
+    return padded((rowCount + 7) / 8);
+}
+
+size_t segmentSize(ColType type, int length, uint32_t rowCount)
+{
+    return bitmapSize(rowCount) + padded(columnWidth(type, length) * rowCount);
+}
+
+static const size_t DICTIONARY_HEADER_SIZE = 8;
+
+DictionarySegment dictionarySegment(const char* values, uint32_t slots)
+{
+    DictionarySegment d;
+    memcpy(&d.entries, values, 4);
+    memcpy(&d.codeSize, values + 4, 4);
+    d.codes = values + DICTIONARY_HEADER_SIZE;
+    d.dictionary = d.codes + padded((size_t)d.codeSize * slots);
+    return d;
+}
+
+RunSegment runSegment(const char* values)
+{
+    RunSegment runs;
+    memcpy(&runs.runs, values, 4);
+    runs.ends = values + DICTIONARY_HEADER_SIZE;
+    runs.values = runs.ends + padded((size_t)runs.runs * 4);
+    return runs;
+}
+
+static uint32_t bitWidth(uint64_t v)
+{
+    uint32_t bits = 0;
+    for (; v; v >>= 1)
+        bits++;
+    return bits;
+}
+
+static size_t packedSize(uint32_t bits, uint32_t count)
+{
+    return ((uint64_t)bits * count + 63) / 64 * 8;
+}
+
+// Ors v, which fits in bits bits, into the packed words at bit position at.
+static void packBits(char* words, uint64_t at, uint32_t bits, uint64_t v)
+{
+    if (bits == 0)
+        return;
+    char* p = words + at / 64 * 8;
+    uint32_t shift = at % 64;
+    uint64_t w;
+    memcpy(&w, p, 8);
+    w |= v << shift;
+    memcpy(p, &w, 8);
+    if (shift + bits > 64) {
+        memcpy(&w, p + 8, 8);
+        w |= v >> (64 - shift);
+        memcpy(p + 8, &w, 8);
+    }
+}
+
+static uint64_t unpackBits(const char* words, uint64_t at, uint32_t bits)
+{
+    if (bits == 0)
+        return 0;
+    const char* p = words + at / 64 * 8;
+    uint32_t shift = at % 64;
+    uint64_t w;
+    memcpy(&w, p, 8);
+    uint64_t v = w >> shift;
+    if (shift + bits > 64) {
+        memcpy(&w, p + 8, 8);
+        v |= w << (64 - shift);
+    }
+    return v & ((1ull << bits) - 1);
+}
+
+static size_t deltaGroups(uint32_t slots)
+{
+    return (slots + TBL_DELTA_GROUP - 1) / TBL_DELTA_GROUP;
+}
+
+size_t encodedSize(const char* header, uint32_t encoding, size_t width, uint32_t slots)
+{
+    uint32_t first, second;
+    memcpy(&first, header, 4);
+    memcpy(&second, header + 4, 4);
+    switch (encoding)
+    {
+    case SEG_DICTIONARY: return DICTIONARY_HEADER_SIZE + padded((size_t)second * slots) + (size_t)first * width;
+    case SEG_RLE: return DICTIONARY_HEADER_SIZE + padded((size_t)first * 4) + (size_t)first * width;
+    case SEG_DELTA: return DICTIONARY_HEADER_SIZE + deltaGroups(slots) * 8 + packedSize(first, slots);
+    case SEG_FOR: return DICTIONARY_HEADER_SIZE + packedSize(second, slots);
+    default: return padded(width * slots);
+    }
+}
+
+bool checkSegment(const char* values, size_t space, uint32_t encoding, ColType type, size_t width, uint32_t slots)
+{
+    bool isString = type == COL_CHAR || type == COL_VARCHAR;
+    if (encoding == SEG_PLAIN)
+        return padded(width * slots) <= space;
+    if (space < DICTIONARY_HEADER_SIZE)
+        return false;
+
+    // The header counts are checked before encodedSize trusts them, and the
+    // codes and run ends before a decoder indexes with them.
+    uint32_t first, second;
+    memcpy(&first, values, 4);
+    memcpy(&second, values + 4, 4);
+    switch (encoding)
+    {
+    case SEG_DICTIONARY:
+    {
+        if (!isString || first == 0 || first > TBL_DICTIONARY_MAX || (second != 1 && second != 2)
+            || encodedSize(values, encoding, width, slots) > space)
+            return false;
+        DictionarySegment d = dictionarySegment(values, slots);
+        for (uint32_t r = 0; r < slots; r++)
+            if (d.code(r) >= d.entries)
+                return false;
+        return true;
+    }
+    case SEG_RLE:
+    {
+        if (isString || first == 0 || first > slots || encodedSize(values, encoding, width, slots) > space)
+            return false;
+        RunSegment runs = runSegment(values);
+        for (uint32_t run = 0, previous = 0; run < runs.runs; run++)
+        {
+            uint32_t end = runs.end(run);
+            if (end <= previous || (run + 1 == runs.runs) != (end == slots))
+                return false;
+            previous = end;
+        }
+        return true;
+    }
+    case SEG_DELTA:
+        return type == COL_INT && first <= 32 && encodedSize(values, encoding, width, slots) <= space;
+    case SEG_FOR:
+        return type == COL_INT && second <= 32 && encodedSize(values, encoding, width, slots) <= space;
+    default:
+        return false;
+    }
+}
+
+void decodeSegment(const char* values, uint32_t encoding, size_t width, uint32_t slots, uint32_t begin,
+    uint32_t end, char* out)
+{
+    switch (encoding)
+    {
+    case SEG_DICTIONARY:
+    {
+        DictionarySegment d = dictionarySegment(values, slots);
+        for (uint32_t r = begin; r < end; r++)
+            memcpy(out + (size_t)(r - begin) * width, d.entry(d.code(r), width), width);
+        break;
+    }
+    case SEG_RLE:
+    {
+        RunSegment runs = runSegment(values);
+        uint32_t r = begin;
+        for (uint32_t run = runs.find(begin); r < end; run++)
+            for (uint32_t stop = min(runs.end(run), end); r < stop; r++)
+                memcpy(out + (size_t)(r - begin) * width, runs.value(run, width), width);
+        break;
+    }
+    case SEG_DELTA:
+    {
+        // Each group is summed up from its first row; with no bits every
+        // step is the group's smallest.
+        uint32_t bits;
+        memcpy(&bits, values, 4);
+        const char* groups = values + DICTIONARY_HEADER_SIZE;
+        const char* words = groups + deltaGroups(slots) * 8;
+        for (uint32_t first = begin - begin % TBL_DELTA_GROUP; first < end; first += TBL_DELTA_GROUP)
+        {
+            int32_t group[2];
+            memcpy(group, groups + (size_t)(first / TBL_DELTA_GROUP) * 8, 8);
+            int64_t v = group[0], step = group[1];
+            uint32_t stop = min(end, first + TBL_DELTA_GROUP);
+            if (bits == 0) {
+                for (uint32_t r = max(first, begin); r < stop; r++)
+                {
+                    int32_t x = (int32_t)(v + (int64_t)(r - first) * step);
+                    memcpy(out + (size_t)(r - begin) * 4, &x, 4);
+                }
+                continue;
+            }
+            for (uint32_t r = first; r < stop; r++)
+            {
+                if (r > first)
+                    v += step + (int64_t)unpackBits(words, (uint64_t)r * bits, bits);
+                if (r >= begin) {
+                    int32_t x = (int32_t)v;
+                    memcpy(out + (size_t)(r - begin) * 4, &x, 4);
+                }
+            }
+        }
+        break;
+    }
+    case SEG_FOR:
+    {
+        int32_t reference;
+        uint32_t bits;
+        memcpy(&reference, values, 4);
+        memcpy(&bits, values + 4, 4);
+        const char* words = values + DICTIONARY_HEADER_SIZE;
+        for (uint32_t r = begin; r < end; r++)
+        {
+            int32_t x = (int32_t)(reference + (int64_t)unpackBits(words, (uint64_t)r * bits, bits));
+            memcpy(out + (size_t)(r - begin) * 4, &x, 4);
+        }
+        break;
+    }
+    default:
+        memcpy(out, values + (size_t)begin * width, (size_t)(end - begin) * width);
+    }
+}
+
+bool isNullValue(const string& value)
+{
+    return value.empty() || value == "NULL";
+}
+
+static bool parseInt(const string& s, int32_t& out)
+{
+    const char* b = s.data();
+    const char* e = s.data() + s.size();
+    if (b != e && *b == '+') b++;
+    auto res = from_chars(b, e, out);
+    return b != e && res.ec == errc() && res.ptr == e;
+}
+
+template <typename T>
+static bool parseReal(const string& s, T& out)
+{
+    const char* b = s.data();
+    const char* e = s.data() + s.size();
+    if (b != e && *b == '+') b++;
+    auto res = from_chars(b, e, out);
+    return b != e && res.ec == errc() && res.ptr == e;
+}
+
+bool validateValue(const string& type, int length, const string& value, string& err)
+{
+    if (isNullValue(value))
+        return true;
+
+    ColType ct = typeCode(type);
+    if (ct == COL_INT)
+    {
+        int32_t v;
+        if (!parseInt(value, v)) { err = "Value '" + value + "' is not a valid INT"; return false; }
+    }
+    else if (ct == COL_FLOAT)
+    {
+        float v;
+        if (!parseReal(value, v)) { err = "Value '" + value + "' is not a valid FLOAT"; return false; }
+    }
+    else if (ct == COL_DOUBLE)
+    {
+        double v;
+        if (!parseReal(value, v)) { err = "Value '" + value + "' is not a valid DOUBLE"; return false; }
+    }
+    else if ((int)value.size() > max(length, 1))
+    {
+        err = "Value '" + value + "' exceeds maximum length " + to_string(length);
+        return false;
+    }
+    return true;
+}
+
+static void putU8(string& out, uint8_t v) { out.push_back((char)v); }
+static void putU16(string& out, uint16_t v) { out.append((const char*)&v, sizeof v); }
+static void putU32(string& out, uint32_t v) { out.append((const char*)&v, sizeof v); }
+static void putI32(string& out, int32_t v) { out.append((const char*)&v, sizeof v); }
+static void putU64(string& out, uint64_t v) { out.append((const char*)&v, sizeof v); }
+static void pad8(string& out) { out.resize(padded(out.size()), '\0'); }
+
+void appendTableHeader(const TableData& schema, string& out)
+{
+    out.append(TBL_MAGIC, 4);
+    putU32(out, TBL_VERSION);
+    putU32(out, (uint32_t)schema.columns.size());
+    putI32(out, schema.primaryKeyIndex);
+    putU64(out, schema.walLsn);
+    for (size_t i = 0; i < schema.columns.size(); i++)
+    {
+        putU16(out, (uint16_t)schema.columns[i].size());
+        out += schema.columns[i];
+        putU8(out, typeCode(schema.types[i]));
+        putI32(out, i < schema.lengths.size() ? schema.lengths[i] : -1);
+        putU8(out, i < schema.notNull.size() && schema.notNull[i] ? 1 : 0);
+    }
+    pad8(out);
+}
+
+bool encodeValue(ColType type, int length, const string& value, char* slot, string& err)
+{
+    switch (type)
+    {
+    case COL_INT:
+    {
+        int32_t v;
+        if (!parseInt(value, v)) { err = "Value '" + value + "' is not a valid INT"; return false; }
+        memcpy(slot, &v, sizeof v);
+        return true;
+    }
+    case COL_FLOAT:
+    {
+        float v;
+        if (!parseReal(value, v)) { err = "Value '" + value + "' is not a valid FLOAT"; return false; }
+        memcpy(slot, &v, sizeof v);
+        return true;
+    }
+    case COL_DOUBLE:
+    {
+        double v;
+        if (!parseReal(value, v)) { err = "Value '" + value + "' is not a valid DOUBLE"; return false; }
+        memcpy(slot, &v, sizeof v);
+        return true;
+    }
+    default:
+    {
+        size_t cap = (size_t)max(length, 1);
+        if (value.size() > cap) {
+            err = "Value '" + value + "' exceeds maximum length " + to_string(length);
+            return false;
+        }
+        if (type == COL_VARCHAR) {
+            uint16_t len = (uint16_t)value.size();
+            memcpy(slot, &len, sizeof len);
+            slot += sizeof len;
+        }
+        memcpy(slot, value.data(), value.size());
+        return true;
+    }
+    }
+}
+
+uint64_t stringZoneKey(string_view s)
+{
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; i++)
+        key = key << 8 | (i < s.size() ? (uint8_t)s[i] : 0);
+    return key;
+}
+
+void addToZone(ColumnZone& zone, ColType type, const char* slot, size_t width)
+{
+    bool first = zone.values++ == 0;
+    if (type == COL_INT)
+    {
+        int32_t v;
+        memcpy(&v, slot, sizeof v);
+        int64_t low, high, value = v;
+        memcpy(&low, &zone.low, 8);
+        memcpy(&high, &zone.high, 8);
+        low = first ? value : min(low, value);
+        high = first ? value : max(high, value);
+        memcpy(&zone.low, &low, 8);
+        memcpy(&zone.high, &high, 8);
+    }
+    else if (type == COL_FLOAT || type == COL_DOUBLE)
+    {
+        double value;
+        if (type == COL_FLOAT) {
+            float f;
+            memcpy(&f, slot, sizeof f);
+            value = f;
+        }
+        else
+            memcpy(&value, slot, sizeof value);
+        double low, high;
+        memcpy(&low, &zone.low, 8);
+        memcpy(&high, &zone.high, 8);
+        // A NaN matches no comparison but !=, so it leaves the bounds unknown.
+        if (value != value) {
+            low = -HUGE_VAL;
+            high = HUGE_VAL;
+        }
+        else {
+            low = first ? value : min(low, value);
+            high = first ? value : max(high, value);
+        }
+        memcpy(&zone.low, &low, 8);
+        memcpy(&zone.high, &high, 8);
+    }
+    else
+    {
+        char scratch[TBL_VALUE_SCRATCH];
+        uint64_t key = stringZoneKey(viewValue(type, slot, width, scratch));
+        zone.low = first ? key : min(zone.low, key);
+        zone.high = first ? key : max(zone.high, key);
+    }
+}
+
+// Replaces the plain slots of a packed string segment by codes and a sorted
+// dictionary when that halves their size; returns the segment's encoding.
+static uint32_t encodeDictionary(ColType type, size_t width, uint32_t rowCount, const char* nulls, char* values)
+{
+    // Even with one-byte codes, more entries than this would not pay.
+    size_t plainSize = padded(width * rowCount);
+    size_t fixedSize = DICTIONARY_HEADER_SIZE + padded(rowCount);
+    if (fixedSize * 2 > plainSize)
+        return SEG_PLAIN;
+    size_t maxEntries = min<size_t>(TBL_DICTIONARY_MAX, (plainSize / 2 - fixedSize) / width);
+
+    unordered_map<string_view, uint32_t> seen;
+    vector<string_view> distinct;
+    for (uint32_t r = 0; r < rowCount; r++)
+    {
+        if (nulls[r / 8] & (1 << (r % 8)))
+            continue;
+        string_view slot(values + (size_t)r * width, width);
+        if (seen.emplace(slot, 0).second) {
+            distinct.push_back(slot);
+            if (distinct.size() > maxEntries)
+                return SEG_PLAIN;
+        }
+    }
+    uint32_t codeSize = distinct.size() <= 256 ? 1 : 2;
+    size_t encodedSize = DICTIONARY_HEADER_SIZE + padded((size_t)codeSize * rowCount) + distinct.size() * width;
+    if (distinct.empty() || encodedSize * 2 > plainSize)
+        return SEG_PLAIN;
+
+    char a[TBL_VALUE_SCRATCH], b[TBL_VALUE_SCRATCH];
+    sort(distinct.begin(), distinct.end(), [&](string_view x, string_view y) {
+        return viewValue(type, x.data(), width, a) < viewValue(type, y.data(), width, b);
+    });
+    for (uint32_t i = 0; i < distinct.size(); i++)
+        seen[distinct[i]] = i;
+
+    string encoded(plainSize, '\0');
+    uint32_t entries = (uint32_t)distinct.size();
+    memcpy(&encoded[0], &entries, 4);
+    memcpy(&encoded[4], &codeSize, 4);
+    char* codes = &encoded[DICTIONARY_HEADER_SIZE];
+    for (uint32_t r = 0; r < rowCount; r++)
+    {
+        if (nulls[r / 8] & (1 << (r % 8)))
+            continue;
+        uint16_t code = (uint16_t)seen[string_view(values + (size_t)r * width, width)];
+        memcpy(codes + (size_t)r * codeSize, &code, codeSize);
+    }
+    char* dictionary = codes + padded((size_t)codeSize * rowCount);
+    for (size_t i = 0; i < distinct.size(); i++)
+        memcpy(dictionary + i * width, distinct[i].data(), width);
+    memcpy(values, encoded.data(), plainSize);
+    return SEG_DICTIONARY;
+}
+
+// Picks the smallest encoding of a packed block's number segment that at
+// least halves it (see Storage.h) and rewrites its values in it; returns
+// the encoding.
+static uint32_t encodeNumbers(ColType type, size_t width, uint32_t rowCount, const char* nulls, char* values)
+{
+    // NULL rows take the value before them (the first value for leading
+    // ones), so they do not break runs or steps.
+    size_t plainSize = padded(width * rowCount);
+    string filled(values, plainSize);
+    uint32_t first = 0;
+    while (first < rowCount && (nulls[first / 8] & (1 << (first % 8))))
+        first++;
+    for (uint32_t r = 0; r < rowCount && first < rowCount; r++)
+        if (nulls[r / 8] & (1 << (r % 8)))
+            memcpy(&filled[(size_t)r * width], &filled[(size_t)(r < first ? first : r - 1) * width], width);
+    auto slot = [&](uint32_t r) { return filled.data() + (size_t)r * width; };
+
+    uint32_t runs = 1;
+    for (uint32_t r = 1; r < rowCount; r++)
+        runs += memcmp(slot(r), slot(r - 1), width) != 0;
+    uint32_t encoding = SEG_RLE;
+    size_t best = DICTIONARY_HEADER_SIZE + padded((size_t)runs * 4) + (size_t)runs * width;
+
+    uint32_t forBits = 0, deltaBits = 0;
+    vector<int32_t> v;
+    vector<int64_t> minSteps;
+    if (type == COL_INT)
+    {
+        v.resize(rowCount);
+        memcpy(v.data(), filled.data(), (size_t)rowCount * 4);
+        int32_t low = *min_element(v.begin(), v.end()), high = *max_element(v.begin(), v.end());
+        forBits = bitWidth((uint64_t)((int64_t)high - low));
+        size_t forSize = DICTIONARY_HEADER_SIZE + packedSize(forBits, rowCount);
+        if (forSize < best) {
+            best = forSize;
+            encoding = SEG_FOR;
+        }
+
+        uint64_t widest = 0;
+        bool stepsFit = true;
+        for (uint32_t g = 0; g * TBL_DELTA_GROUP < rowCount; g++)
+        {
+            uint32_t begin = g * TBL_DELTA_GROUP, end = min(rowCount, begin + TBL_DELTA_GROUP);
+            int64_t lo = INT64_MAX, hi = INT64_MIN;
+            for (uint32_t r = begin + 1; r < end; r++) {
+                lo = min(lo, (int64_t)v[r] - v[r - 1]);
+                hi = max(hi, (int64_t)v[r] - v[r - 1]);
+            }
+            minSteps.push_back(end - begin > 1 ? lo : 0);
+            stepsFit = stepsFit && minSteps.back() >= INT32_MIN && minSteps.back() <= INT32_MAX;
+            widest = max<uint64_t>(widest, end - begin > 1 ? (uint64_t)(hi - lo) : 0);
+        }
+        deltaBits = bitWidth(widest);
+        size_t deltaSize = DICTIONARY_HEADER_SIZE + minSteps.size() * 8 + packedSize(deltaBits, rowCount);
+        if (stepsFit && deltaBits <= 32 && deltaSize < best) {
+            best = deltaSize;
+            encoding = SEG_DELTA;
+        }
+    }
+    if (best * 2 > plainSize)
+        return SEG_PLAIN;
+
+    string encoded(plainSize, '\0');
+    char* at = &encoded[DICTIONARY_HEADER_SIZE];
+    if (encoding == SEG_RLE)
+    {
+        memcpy(&encoded[0], &runs, 4);
+        char* runValues = at + padded((size_t)runs * 4);
+        uint32_t run = 0;
+        for (uint32_t r = 1; r <= rowCount; r++)
+        {
+            if (r < rowCount && memcmp(slot(r), slot(r - 1), width) == 0)
+                continue;
+            memcpy(at + (size_t)run * 4, &r, 4);
+            memcpy(runValues + (size_t)run * width, slot(r - 1), width);
+            run++;
+        }
+    }
+    else if (encoding == SEG_FOR)
+    {
+        int32_t reference = *min_element(v.begin(), v.end());
+        memcpy(&encoded[0], &reference, 4);
+        memcpy(&encoded[4], &forBits, 4);
+        for (uint32_t r = 0; r < rowCount; r++)
+            packBits(at, (uint64_t)r * forBits, forBits, (uint64_t)((int64_t)v[r] - reference));
+    }
+    else
+    {
+        memcpy(&encoded[0], &deltaBits, 4);
+        char* words = at + minSteps.size() * 8;
+        for (uint32_t r = 0; r < rowCount; r++)
+        {
+            uint32_t g = r / TBL_DELTA_GROUP;
+            if (r % TBL_DELTA_GROUP == 0) {
+                int32_t group[2] = { v[r], (int32_t)minSteps[g] };
+                memcpy(at + (size_t)g * 8, group, 8);
+            }
+            else
+                packBits(words, (uint64_t)r * deltaBits, deltaBits, (uint64_t)((int64_t)v[r] - v[r - 1] - minSteps[g]));
+        }
+    }
+    memcpy(values, encoded.data(), plainSize);
+    return encoding;
+}
+
+bool appendTableBlock(const TableData& schema, const vector<vector<string>>& rows,
+    size_t begin, size_t end, string& out, string& err, uint32_t capacity)
+{
+    uint32_t rowCount = (uint32_t)(end - begin);
+    uint32_t slots = blockSlots(rowCount, capacity);
+    size_t blockStart = out.size();
+
+    putU32(out, rowCount);
+    putU32(out, slots > rowCount ? slots : 0);
+    putU64(out, 0);
+    putU32(out, 0);
+    putU32(out, 0);
+    out.resize(out.size() + bitmapSize(slots), '\0');
+
+    vector<ColumnZone> zones(schema.columns.size());
+    for (size_t c = 0; c < schema.columns.size(); c++)
+    {
+        ColType type = typeCode(schema.types[c]);
+        int length = c < schema.lengths.size() ? schema.lengths[c] : -1;
+        size_t width = columnWidth(type, length);
+
+        size_t bitmapAt = out.size();
+        out.resize(bitmapAt + bitmapSize(slots), '\0');
+        size_t valuesAt = out.size();
+        out.resize(valuesAt + padded(width * slots), '\0');
+
+        for (uint32_t r = 0; r < rowCount; r++)
+        {
+            static const string missing;
+            const vector<string>& row = rows[begin + r];
+            const string& value = c < row.size() ? row[c] : missing;
+            if (isNullValue(value)) {
+                out[bitmapAt + r / 8] |= (char)(1 << (r % 8));
+                zones[c].nulls++;
+                continue;
+            }
+            if (!encodeValue(type, length, value, &out[valuesAt + r * width], err)) {
+                err += " in column '" + schema.columns[c] + "'";
+                return false;
+            }
+            addToZone(zones[c], type, &out[valuesAt + r * width], width);
+        }
+        if (slots == rowCount && rowCount > 0)
+            zones[c].encoding = type == COL_CHAR || type == COL_VARCHAR
+                ? encodeDictionary(type, width, rowCount, &out[bitmapAt], &out[valuesAt])
+                : encodeNumbers(type, width, rowCount, &out[bitmapAt], &out[valuesAt]);
+        if (zones[c].encoding != SEG_PLAIN)
+            out.resize(valuesAt + padded(encodedSize(&out[valuesAt], zones[c].encoding, width, slots)));
+        zones[c].offset = bitmapAt - blockStart;
+        zones[c].size = out.size() - bitmapAt;
+    }
+    out.append((const char*)zones.data(), zoneMapSize(zones.size()));
+
+    uint64_t byteSize = out.size() - blockStart;
+    memcpy(&out[blockStart + 8], &byteSize, sizeof byteSize);
+    return true;
+}
+
+bool encodeTable(const TableData& t, string& out, string& err, vector<uint64_t>* blockOffsets)
+{
+    appendTableHeader(t, out);
+    for (size_t begin = 0; begin < t.rows.size(); begin += TBL_BLOCK_ROWS)
+    {
+        size_t end = min(t.rows.size(), begin + TBL_BLOCK_ROWS);
+        if (blockOffsets)
+            blockOffsets->push_back(out.size());
+        if (!appendTableBlock(t, t.rows, begin, end, out, err))
+            return false;
+    }
+    return true;
+}
+
+bool decodeTableHeader(const char* data, size_t size, TableData& t, size_t& offset, string& err,
+    uint32_t* version)
+{
+    offset = 0;
+    auto need = [&](size_t n) {
+        if (offset + n > size) { err = "truncated header"; return false; }
+        return true;
+    };
+
+    if (!need(16) || memcmp(data, TBL_MAGIC, 4) != 0) {
+        err = "not a table file";
+        return false;
+    }
+    uint32_t fileVersion, colCount;
+    int32_t pk;
+    memcpy(&fileVersion, data + 4, 4);
+    memcpy(&colCount, data + 8, 4);
+    memcpy(&pk, data + 12, 4);
+    offset = 16;
+    if (fileVersion < 1 || fileVersion > TBL_VERSION) {
+        err = "unsupported version " + to_string(fileVersion);
+        return false;
+    }
+    if (version)
+        *version = fileVersion;
+    if (fileVersion >= 2) {
+        if (!need(8)) return false;
+        memcpy(&t.walLsn, data + offset, 8);
+        offset += 8;
+    }
+
+    t.primaryKeyIndex = pk;
+    for (uint32_t i = 0; i < colCount; i++)
+    {
+        uint16_t nameLen;
+        if (!need(2)) return false;
+        memcpy(&nameLen, data + offset, 2);
+        offset += 2;
+        if (!need(nameLen + 6u)) return false;
+        t.columns.push_back(string(data + offset, nameLen));
+        offset += nameLen;
+        ColType type = (ColType)(uint8_t)data[offset++];
+        int32_t length;
+        memcpy(&length, data + offset, 4);
+        offset += 4;
+        t.types.push_back(typeName(type));
+        t.lengths.push_back(length);
+        t.notNull.push_back(data[offset++] != 0);
+    }
+    offset = padded(offset);
+    return true;
+}
+
+string_view viewValue(ColType type, const char* slot, size_t width, char* scratch)
+{
+    switch (type)
+    {
+    case COL_INT:
+    {
+        int32_t v;
+        memcpy(&v, slot, sizeof v);
+        return string_view(scratch, to_chars(scratch, scratch + TBL_VALUE_SCRATCH, v).ptr - scratch);
+    }
+    case COL_FLOAT:
+    {
+        float v;
+        memcpy(&v, slot, sizeof v);
+        return string_view(scratch, to_chars(scratch, scratch + TBL_VALUE_SCRATCH, v).ptr - scratch);
+    }
+    case COL_DOUBLE:
+    {
+        double v;
+        memcpy(&v, slot, sizeof v);
+        return string_view(scratch, to_chars(scratch, scratch + TBL_VALUE_SCRATCH, v).ptr - scratch);
+    }
+    case COL_CHAR:
+        return string_view(slot, strnlen(slot, width));
+    default:
+    {
+        uint16_t len;
+        memcpy(&len, slot, sizeof len);
+        return string_view(slot + sizeof len, min((size_t)len, width - sizeof len));
+    }
+    }
+}
+
+static string decodeValue(ColType type, const char* slot, size_t width)
+{
+    char buf[TBL_VALUE_SCRATCH];
+    return string(viewValue(type, slot, width, buf));
+}
+
+static bool isDeadRow(const char* deadBitmap, uint32_t r)
+{
+    return deadBitmap && (deadBitmap[r / 8] & (1 << (r % 8)));
+}
+
+// The plain slots of a segment laid out for slots rows: in place, or decoded
+// into buffer.
+static const char* plainValues(const char* segment, uint32_t encoding, size_t width, uint32_t slots, string& buffer)
+{
+    const char* values = segment + bitmapSize(slots);
+    if (encoding == SEG_PLAIN)
+        return values;
+    buffer.resize(padded(width * slots));
+    decodeSegment(values, encoding, width, slots, 0, slots, &buffer[0]);
+    return buffer.data();
+}
+
+static string decodeCell(ColType type, size_t width, const char* nulls, const char* values, uint32_t r)
+{
+    if (nulls[r / 8] & (1 << (r % 8)))
+        return "NULL";
+    return decodeValue(type, values + (size_t)r * width, width);
+}
+
+string canonicalValue(const string& type, const string& value)
+{
+    if (isNullValue(value))
+        return "NULL";
+    ColType ct = typeCode(type);
+    if (ct == COL_CHAR || ct == COL_VARCHAR)
+        return value;
+
+    char slot[sizeof(double)];
+    string err;
+    if (!encodeValue(ct, -1, value, slot, err))
+        return value;
+    return decodeValue(ct, slot, sizeof slot);
+}
+
+bool decodeTable(const char* data, size_t size, TableData& t, string& err, vector<uint64_t>* locations)
+{
+    size_t offset;
+    uint32_t version;
+    if (!decodeTableHeader(data, size, t, offset, err, &version))
+        return false;
+
+    vector<ColType> types;
+    for (auto& ty : t.types)
+        types.push_back(typeCode(ty));
+
+    // Older files are still decoded here so they can be upgraded. Before
+    // version 7 every segment had its plain size, so they follow each other
+    // at fixed offsets.
+    size_t headerSize = version >= 3 ? TBL_BLOCK_HEADER_SIZE : TBL_V2_BLOCK_HEADER_SIZE;
+    size_t zoneSize = version >= 7 ? TBL_ZONE_SIZE : version >= 5 ? TBL_V6_ZONE_SIZE : TBL_V4_ZONE_SIZE;
+    while (offset + headerSize <= size)
+    {
+        uint32_t rowCount, capacity, deadRows = 0;
+        uint64_t byteSize;
+        memcpy(&rowCount, data + offset, 4);
+        memcpy(&capacity, data + offset + 4, 4);
+        memcpy(&byteSize, data + offset + 8, 8);
+        if (version >= 3)
+            memcpy(&deadRows, data + offset + TBL_DEAD_COUNT_OFFSET, 4);
+        uint32_t slots = blockSlots(rowCount, capacity);
+        size_t deadSize = version >= 3 ? bitmapSize(slots) : 0;
+        size_t zoneMapBytes = version >= 4 ? t.columns.size() * zoneSize : 0;
+        if (byteSize < headerSize + deadSize + zoneMapBytes || byteSize > size - offset) {
+            err = "truncated block";
+            return false;
+        }
+
+        // Segments lie between the deleted-row bitmap and the zone map.
+        size_t pos = offset + headerSize;
+        const char* dead = version >= 3 && deadRows > 0 ? data + pos : nullptr;
+        pos += deadSize;
+        size_t segmentsBegin = pos, segmentsEnd = offset + byteSize - zoneMapBytes;
+
+        uint32_t live = 0;
+        for (uint32_t r = 0; r < rowCount; r++)
+            live += isDeadRow(dead, r) ? 0 : 1;
+
+        size_t first = t.rows.size();
+        t.rows.resize(first + live, vector<string>(t.columns.size()));
+        if (locations)
+            for (uint32_t r = 0; r < rowCount; r++)
+                if (!isDeadRow(dead, r))
+                    locations->push_back(makeRowLocation(offset, r));
+        const char* zoneMap = data + segmentsEnd;
+        string buffer;
+        for (size_t c = 0; c < t.columns.size(); c++)
+        {
+            ColumnZone zone;
+            if (version >= 5)
+                memcpy(&zone, zoneMap + c * zoneSize, min(zoneSize, sizeof zone));
+            if (version >= 7)
+                pos = offset + min<uint64_t>(zone.offset, byteSize);
+            else
+                zone.size = segmentSize(types[c], t.lengths[c], slots);
+            size_t width = columnWidth(types[c], t.lengths[c]);
+            if (pos < segmentsBegin || pos > segmentsEnd || zone.size > segmentsEnd - pos
+                || zone.size < bitmapSize(slots)
+                || !checkSegment(data + pos + bitmapSize(slots), zone.size - bitmapSize(slots), zone.encoding,
+                    types[c], width, slots)) {
+                err = "truncated block";
+                return false;
+            }
+            const char* values = plainValues(data + pos, zone.encoding, width, slots, buffer);
+            size_t at = first;
+            for (uint32_t r = 0; r < rowCount; r++)
+                if (!isDeadRow(dead, r))
+                    t.rows[at++][c] = decodeCell(types[c], width, data + pos, values, r);
+            pos += segmentSize(types[c], t.lengths[c], slots);
+        }
+        offset += byteSize;
+    }
+    return true;
+}
+
+// The header is small; grow the read window until it decodes completely.
+static bool readHeader(ifstream& f, TableData& t, size_t& offset, uint32_t* version = nullptr)
+{
+    string buf, err;
+    for (size_t window = 4096;; window *= 2)
+    {
+        buf.resize(window);
+        f.clear();
+        f.seekg(0, ios::beg);
+        f.read(&buf[0], window);
+        buf.resize((size_t)f.gcount());
+
+        t = TableData();
+        if (decodeTableHeader(buf.data(), buf.size(), t, offset, err, version)) {
+            f.clear();
+            return true;
+        }
+        if (buf.size() < window)
+            return false;
+    }
+}
+
+bool readTableSchema(string tableName, TableData& t)
+{
+    ifstream f(tableFile(tableName), ios::binary);
+    size_t offset;
+    return f.good() && readHeader(f, t, offset);
+}
+
+// Reads the bitmap of deleted rows of the block at offset, or clears dead if
+// the block has none.
+static bool readDeadBitmap(istream& f, uint64_t offset, uint32_t deadRows, uint32_t slots, string& dead)
+{
+    dead.clear();
+    if (deadRows == 0)
+        return true;
+    dead.resize(bitmapSize(slots));
+    f.seekg(offset + TBL_BLOCK_HEADER_SIZE);
+    return (bool)f.read(&dead[0], dead.size());
+}
+
+bool readTableColumn(string tableName, const TableData& schema, int col, vector<string>& out,
+    vector<uint64_t>* locations)
+{
+    ifstream f(tableFile(tableName), ios::binary);
+    if (!f.good())
+        return false;
+
+    // The file's own header is decoded, since its size is not known up front.
+    TableData header;
+    size_t headerSize;
+    uint32_t version;
+    if (!readHeader(f, header, headerSize, &version) || version != TBL_VERSION)
+        return false;
+    uint64_t offset = headerSize;
+
+    ColType type = typeCode(schema.types[col]);
+    int length = schema.lengths[col];
+
+    // Only the block headers and the requested column's segments are read.
+    char blockHeader[TBL_BLOCK_HEADER_SIZE];
+    string segment, dead, buffer;
+    size_t width = columnWidth(type, length);
+    while (f.seekg(offset) && f.read(blockHeader, sizeof blockHeader))
+    {
+        uint32_t rowCount, capacity, deadRows;
+        uint64_t byteSize;
+        memcpy(&rowCount, blockHeader, 4);
+        memcpy(&capacity, blockHeader + 4, 4);
+        memcpy(&byteSize, blockHeader + 8, 8);
+        memcpy(&deadRows, blockHeader + TBL_DEAD_COUNT_OFFSET, 4);
+        if (byteSize < TBL_BLOCK_HEADER_SIZE)
+            return false;
+        uint32_t slots = blockSlots(rowCount, capacity);
+        if (!readDeadBitmap(f, offset, deadRows, slots, dead))
+            return false;
+
+        ColumnZone zone;
+        f.seekg(offset + byteSize - zoneMapSize(schema.columns.size()) + col * TBL_ZONE_SIZE);
+        if (!f.read((char*)&zone, sizeof zone))
+            return false;
+        if (zone.size < bitmapSize(slots) || zone.offset > byteSize || zone.size > byteSize - zone.offset)
+            return false;
+        segment.resize(zone.size);
+        f.seekg(offset + zone.offset);
+        if (!f.read(&segment[0], segment.size())
+            || !checkSegment(segment.data() + bitmapSize(slots), segment.size() - bitmapSize(slots), zone.encoding,
+                type, width, slots))
+            return false;
+
+        const char* values = plainValues(segment.data(), zone.encoding, width, slots, buffer);
+        for (uint32_t r = 0; r < rowCount; r++)
+        {
+            if (isDeadRow(dead.empty() ? nullptr : dead.data(), r))
+                continue;
+            out.push_back(decodeCell(type, width, segment.data(), values, r));
+            if (locations)
+                locations->push_back(makeRowLocation(offset, r));
+        }
+
+        offset += byteSize;
+    }
+    return true;
+}
+
+uint64_t tableFileSize(string tableName)
+{
+    ifstream f(tableFile(tableName), ios::binary | ios::ate);
+    return f.good() ? (uint64_t)f.tellg() : 0;
+}
+
+uint32_t tableFileVersion(string tableName)
+{
+    ifstream f(tableFile(tableName), ios::binary);
+    char head[8];
+    uint32_t version = 0;
+    if (f.read(head, sizeof head) && memcmp(head, TBL_MAGIC, 4) == 0)
+        memcpy(&version, head + 4, 4);
+    return version;
+}
+
+bool stampTableLsn(string tableName, uint64_t lsn)
+{
+    // Recovery skips every record up to the stamped LSN, so the rows must
+    // reach the disk before the stamp does, and the stamp before the
+    // statement reports success.
+    string path = tableFile(tableName);
+    if (tableFileVersion(tableName) != TBL_VERSION || !syncFile(path))
+        return false;
+    {
+        fstream f(path, ios::binary | ios::in | ios::out);
+        if (!f.good())
+            return false;
+        f.seekp(TBL_LSN_OFFSET);
+        f.write((const char*)&lsn, 8);
+        f.flush();
+        if (!f.good())
+            return false;
+    }
+    return syncFile(path);
+}
+
+bool readBlockDirectory(string tableName, const TableData& schema, vector<TableBlock>& blocks)
+{
+    ifstream f(tableFile(tableName), ios::binary);
+    if (!f.good())
+        return false;
+
+    TableData header;
+    size_t headerSize;
+    uint32_t version;
+    if (!readHeader(f, header, headerSize, &version) || version != TBL_VERSION)
+        return false;
+    // Callers lay out the blocks' segments from schema.
+    if (header.columns.size() != schema.columns.size())
+        return false;
+    uint64_t offset = headerSize;
+
+    char blockHeader[TBL_BLOCK_HEADER_SIZE];
+    while (f.seekg(offset) && f.read(blockHeader, sizeof blockHeader))
+    {
+        TableBlock b;
+        b.offset = offset;
+        memcpy(&b.rowCount, blockHeader, 4);
+        memcpy(&b.capacity, blockHeader + 4, 4);
+        memcpy(&b.byteSize, blockHeader + 8, 8);
+        memcpy(&b.deadRows, blockHeader + TBL_DEAD_COUNT_OFFSET, 4);
+        if (b.byteSize < TBL_BLOCK_HEADER_SIZE || b.deadRows > b.rowCount)
+            return false;
+        blocks.push_back(b);
+        offset += b.byteSize;
+    }
+    return true;
+}
+
+static uint64_t zoneMapOffset(const TableData& schema, uint64_t blockOffset, uint64_t byteSize)
+{
+    return blockOffset + byteSize - zoneMapSize(schema.columns.size());
+}
+
+// Read-modify-write access to a table file through TBL_PAGE_SIZE pages: reads
+// and patches go to in-memory copies of the pages they touch, and commit()
+// writes each dirty page back once, in file order.
+class PagePatcher
+{
+public:
+    explicit PagePatcher(fstream& f) : file(f) {}
+
+    bool read(uint64_t at, void* out, size_t n)
+    {
+        char* dst = (char*)out;
+        while (n > 0)
+        {
+            Page* p = page(at / TBL_PAGE_SIZE);
+            size_t in = at % TBL_PAGE_SIZE;
+            size_t take = min(n, TBL_PAGE_SIZE - in);
+            if (!p || in + take > p->bytes.size())
+                return false;
+            memcpy(dst, &p->bytes[in], take);
+            dst += take;
+            at += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    bool write(uint64_t at, const void* data, size_t n)
+    {
+        const char* src = (const char*)data;
+        while (n > 0)
+        {
+            Page* p = page(at / TBL_PAGE_SIZE);
+            size_t in = at % TBL_PAGE_SIZE;
+            size_t take = min(n, TBL_PAGE_SIZE - in);
+            if (!p || in + take > p->bytes.size())
+                return false;
+            memcpy(&p->bytes[in], src, take);
+            p->dirty = true;
+            src += take;
+            at += take;
+            n -= take;
+        }
+        return true;
+    }
+
+    bool setBit(uint64_t at, uint32_t bit, bool on)
+    {
+        char byte;
+        if (!read(at, &byte, 1))
+            return false;
+        byte = on ? (char)(byte | (1 << bit)) : (char)(byte & ~(1 << bit));
+        return write(at, &byte, 1);
+    }
+
+    bool commit()
+    {
+        for (auto& kv : pages)
+        {
+            if (!kv.second.dirty)
+                continue;
+            file.seekp(kv.first * TBL_PAGE_SIZE);
+            file.write(kv.second.bytes.data(), kv.second.bytes.size());
+            kv.second.dirty = false;
+        }
+        file.flush();
+        return file.good();
+    }
+
+private:
+    struct Page
+    {
+        string bytes;
+        bool dirty = false;
+    };
+    fstream& file;
+    map<uint64_t, Page> pages;
+
+    Page* page(uint64_t index)
+    {
+        auto it = pages.find(index);
+        if (it != pages.end())
+            return &it->second;
+        Page& p = pages[index];
+        p.bytes.resize(TBL_PAGE_SIZE);
+        file.clear();
+        file.seekg(index * TBL_PAGE_SIZE);
+        file.read(&p.bytes[0], TBL_PAGE_SIZE);
+        p.bytes.resize((size_t)file.gcount());
+        file.clear();
+        return &p;
+    }
+};
+
+// Takes the cell of slot r, whose null bit is at bitAt, out of a zone's counts.
+static bool uncountCell(PagePatcher& pages, uint64_t bitAt, uint32_t r, ColumnZone& zone)
+{
+    char bits;
+    if (!pages.read(bitAt, &bits, 1))
+        return false;
+    uint32_t& count = bits & (1 << (r % 8)) ? zone.nulls : zone.values;
+    count -= count > 0 ? 1 : 0;
+    return true;
+}
+
+// Looks a value, in slot form, up in the dictionary of the encoded segment
+// whose values start at valuesAt; returns its code or -1.
+static int64_t findDictionaryCode(PagePatcher& pages, uint64_t valuesAt, uint32_t slots, ColType type, size_t width,
+    const string& slot)
+{
+    uint32_t header[2];
+    if (!pages.read(valuesAt, header, sizeof header))
+        return -1;
+    uint64_t dictionaryAt = valuesAt + DICTIONARY_HEADER_SIZE + padded((size_t)header[1] * slots);
+    char a[TBL_VALUE_SCRATCH], b[TBL_VALUE_SCRATCH];
+    string_view value = viewValue(type, slot.data(), width, a);
+    string entry(width, '\0');
+    uint32_t lo = 0, hi = header[0];
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!pages.read(dictionaryAt + (uint64_t)mid * width, &entry[0], width))
+            return -1;
+        string_view v = viewValue(type, entry.data(), width, b);
+        if (v == value)
+            return mid;
+        if (v < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+
+// Replaces the bits bits at bit position at of the packed words at wordsAt.
+static bool patchBits(PagePatcher& pages, uint64_t wordsAt, uint64_t at, uint32_t bits, uint64_t v)
+{
+    if (bits == 0)
+        return true;
+    uint64_t words[2] = { 0, 0 };
+    size_t n = at % 64 + bits > 64 ? 16 : 8;
+    uint64_t wordAt = wordsAt + at / 64 * 8;
+    if (!pages.read(wordAt, words, n))
+        return false;
+    uint64_t mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+    uint32_t shift = at % 64;
+    words[0] = (words[0] & ~(mask << shift)) | (v << shift);
+    if (n == 16)
+        words[1] = (words[1] & ~(mask >> (64 - shift))) | (v >> (64 - shift));
+    return pages.write(wordAt, words, n);
+}
+
+// Stores a non-NULL value, in slot form, into row r of an encoded segment
+// when the encoding has room for it; stored says whether it had.
+static bool storeEncoded(PagePatcher& pages, uint64_t valuesAt, uint32_t encoding, ColType type, size_t width,
+    uint32_t slots, uint32_t r, const string& slot, bool& stored)
+{
+    stored = false;
+    if (encoding == SEG_DICTIONARY)
+    {
+        int64_t code = findDictionaryCode(pages, valuesAt, slots, type, width, slot);
+        uint32_t codeSize;
+        if (code < 0)
+            return true;
+        stored = true;
+        return pages.read(valuesAt + 4, &codeSize, 4)
+            && pages.write(valuesAt + DICTIONARY_HEADER_SIZE + (uint64_t)r * codeSize, &code, codeSize);
+    }
+    if (encoding == SEG_FOR)
+    {
+        int32_t header[2], v;
+        memcpy(&v, slot.data(), 4);
+        if (!pages.read(valuesAt, header, 8))
+            return false;
+        uint32_t bits = (uint32_t)header[1];
+        int64_t packed = (int64_t)v - header[0];
+        if (packed < 0 || (uint64_t)packed >> bits != 0)
+            return true;
+        stored = true;
+        return patchBits(pages, valuesAt + DICTIONARY_HEADER_SIZE, (uint64_t)r * bits, bits, (uint64_t)packed);
+    }
+    // A run or a step cannot change without moving the rows after it.
+    return true;
+}
+
+// Reads row r of an encoded segment whose values start at valuesAt into
+// out, in plain slot form.
+static bool readEncodedSlot(PagePatcher& pages, uint64_t valuesAt, uint32_t encoding, size_t width, uint32_t slots,
+    uint32_t r, char* out)
+{
+    uint32_t header[2];
+    if (!pages.read(valuesAt, header, sizeof header))
+        return false;
+    uint64_t at = valuesAt + DICTIONARY_HEADER_SIZE;
+    switch (encoding)
+    {
+    case SEG_DICTIONARY:
+    {
+        uint16_t code = 0;
+        return pages.read(at + (uint64_t)r * header[1], &code, header[1])
+            && pages.read(at + padded((size_t)header[1] * slots) + (uint64_t)code * width, out, width);
+    }
+    case SEG_RLE:
+    {
+        uint32_t lo = 0, hi = header[0];
+        while (lo < hi)
+        {
+            uint32_t mid = lo + (hi - lo) / 2, end;
+            if (!pages.read(at + (uint64_t)mid * 4, &end, 4))
+                return false;
+            if (end <= r)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return pages.read(at + padded((size_t)header[0] * 4) + (uint64_t)lo * width, out, width);
+    }
+    case SEG_FOR:
+    case SEG_DELTA:
+    {
+        // The words holding the packed values from the row's group start
+        // (or the row itself) to the row are read and decoded.
+        bool delta = encoding == SEG_DELTA;
+        uint32_t bits = delta ? header[0] : header[1];
+        uint32_t from = delta ? r - r % TBL_DELTA_GROUP : r;
+        uint64_t wordsAt = at + (delta ? deltaGroups(slots) * 8 : 0);
+        uint64_t firstWord = (uint64_t)from * bits / 64, lastWord = ((uint64_t)(r + 1) * bits + 63) / 64;
+        string words((size_t)(lastWord - firstWord) * 8, '\0');
+        if (!words.empty() && !pages.read(wordsAt + firstWord * 8, &words[0], words.size()))
+            return false;
+        int64_t v;
+        if (delta) {
+            int32_t group[2];
+            if (!pages.read(at + (uint64_t)(r / TBL_DELTA_GROUP) * 8, group, 8))
+                return false;
+            v = group[0];
+            for (uint32_t i = from + 1; i <= r; i++)
+                v += group[1] + (int64_t)unpackBits(words.data(), (uint64_t)i * bits - firstWord * 64, bits);
+        }
+        else
+            v = (int32_t)header[0] + (int64_t)unpackBits(words.data(), (uint64_t)r * bits - firstWord * 64, bits);
+        int32_t x = (int32_t)v;
+        memcpy(out, &x, 4);
+        return true;
+    }
+    default:
+        return pages.read(valuesAt + (uint64_t)r * width, out, width);
+    }
+}
+
+// Values an encoded segment has no code or packed value for, kept until the
+// segment is re-encoded with them; keyed by the file offset of the column's
+// zone map entry.
+struct SegmentEdit
+{
+    uint64_t block = 0;
+    uint32_t slots = 0;
+    size_t col = 0;
+    vector<pair<uint32_t, string>> values;  // slot, value in slot form
+};
+
+// Stores row into slot r of the block at blockOffset, laid out for slots rows,
+// and counts it into the zone map at zoneAt. With replacing, the row that was
+// in the slot is taken out of the counts first. Values an encoded segment has
+// no room for go to edits, and fail the write without it.
+static bool patchRow(PagePatcher& pages, const TableData& schema, uint64_t blockOffset, uint32_t slots, uint32_t r,
+    uint64_t zoneAt, bool replacing, const vector<string>& row, string& slot, map<uint64_t, SegmentEdit>* edits = nullptr)
+{
+    string err;
+    for (size_t c = 0; c < schema.columns.size(); c++)
+    {
+        ColType type = typeCode(schema.types[c]);
+        size_t width = columnWidth(type, schema.lengths[c]);
+        bool isNull = c >= row.size() || isNullValue(row[c]);
+
+        slot.assign(width, '\0');
+        if (!isNull && !encodeValue(type, schema.lengths[c], row[c], &slot[0], err)) {
+            setColor(12); cout << "Error: " << err << " in column '" << schema.columns[c] << "'.\n"; setColor(15);
+            return false;
+        }
+
+        ColumnZone zone;
+        uint64_t zoneCol = zoneAt + c * TBL_ZONE_SIZE;
+        if (!pages.read(zoneCol, &zone, sizeof zone))
+            return false;
+        uint64_t seg = blockOffset + zone.offset;
+        if (replacing && !uncountCell(pages, seg + r / 8, r, zone))
+            return false;
+        if (isNull)
+            zone.nulls++;
+        else
+            addToZone(zone, type, slot.data(), width);
+        if (!pages.setBit(seg + r / 8, r % 8, isNull))
+            return false;
+
+        // An encoded segment takes the value's code or packed value if it has
+        // one. A NULL leaves the encoded value as it is.
+        uint64_t valuesAt = seg + bitmapSize(slots);
+        if (zone.encoding != SEG_PLAIN) {
+            bool stored = isNull;
+            if (!isNull && !storeEncoded(pages, valuesAt, zone.encoding, type, width, slots, r, slot, stored))
+                return false;
+            if (!stored) {
+                if (!edits)
+                    return false;
+                SegmentEdit& edit = (*edits)[zoneCol];
+                edit.block = blockOffset;
+                edit.slots = slots;
+                edit.col = c;
+                edit.values.push_back({ r, slot });
+            }
+        }
+        else if (!pages.write(valuesAt + (uint64_t)r * width, slot.data(), width))
+            return false;
+        if (!pages.write(zoneCol, &zone, sizeof zone))
+            return false;
+    }
+    return true;
+}
+
+// Re-encodes the segment of an edit with its values stored, in the space the
+// segment takes; fits says whether the result had room there.
+static bool reencodeSegment(PagePatcher& pages, const TableData& schema, uint64_t zoneCol, const SegmentEdit& edit,
+    bool& fits)
+{
+    ColType type = typeCode(schema.types[edit.col]);
+    size_t width = columnWidth(type, schema.lengths[edit.col]);
+    ColumnZone zone;
+    if (!pages.read(zoneCol, &zone, sizeof zone))
+        return false;
+    uint64_t bitmapAt = edit.block + zone.offset;
+    string nulls(bitmapSize(edit.slots), '\0');
+    if (zone.size < nulls.size())
+        return false;
+    string encoded(zone.size - nulls.size(), '\0');
+    if (!pages.read(bitmapAt, &nulls[0], nulls.size()) || !pages.read(bitmapAt + nulls.size(), &encoded[0], encoded.size()))
+        return false;
+
+    string plain(padded(width * edit.slots), '\0');
+    decodeSegment(encoded.data(), zone.encoding, width, edit.slots, 0, edit.slots, &plain[0]);
+    for (uint32_t r = 0; r < edit.slots; r++)
+        if (nulls[r / 8] & (1 << (r % 8)))
+            memset(&plain[(size_t)r * width], 0, width);
+    for (auto& v : edit.values)
+        memcpy(&plain[(size_t)v.first * width], v.second.data(), width);
+
+    zone.encoding = type == COL_CHAR || type == COL_VARCHAR
+        ? encodeDictionary(type, width, edit.slots, nulls.data(), &plain[0])
+        : encodeNumbers(type, width, edit.slots, nulls.data(), &plain[0]);
+    size_t needed = zone.encoding == SEG_PLAIN
+        ? plain.size() : padded(encodedSize(plain.data(), zone.encoding, width, edit.slots));
+    fits = needed <= encoded.size();
+    if (!fits)
+        return true;
+    // The encoders leave zeros after the encoded values.
+    plain.resize(encoded.size(), '\0');
+    return pages.write(bitmapAt + nulls.size(), plain.data(), plain.size()) && pages.write(zoneCol, &zone, sizeof zone);
+}
+
+bool readRowsAt(string tableName, const TableData& schema, const vector<uint64_t>& locations, vector<vector<string>>& rows)
+{
+    fstream f(tableFile(tableName), ios::binary | ios::in);
+    if (!f.good())
+        return false;
+
+    rows.assign(locations.size(), vector<string>(schema.columns.size()));
+    string bitmap, values, segment, entry;
+    vector<ColumnZone> zones;
+    PagePatcher pages(f);
+
+    // Locations of the same block are handled together: for every column one
+    // read covers the slot range they span.
+    size_t i = 0;
+    while (i < locations.size())
+    {
+        uint64_t block = locationBlock(locations[i]);
+        size_t j = i;
+        uint32_t lo = locationSlot(locations[i]), hi = lo;
+        while (j < locations.size() && locationBlock(locations[j]) == block) {
+            lo = min(lo, locationSlot(locations[j]));
+            hi = max(hi, locationSlot(locations[j]));
+            j++;
+        }
+
+        uint32_t counts[2];
+        uint64_t byteSize;
+        if (!f.seekg(block) || !f.read((char*)counts, 8) || !f.read((char*)&byteSize, 8) || hi >= counts[0])
+            return false;
+        uint32_t slots = blockSlots(counts[0], counts[1]);
+        zones.resize(schema.columns.size());
+        f.seekg(zoneMapOffset(schema, block, byteSize));
+        if (!f.read((char*)zones.data(), zoneMapSize(zones.size())))
+            return false;
+
+        for (size_t c = 0; c < schema.columns.size(); c++)
+        {
+            ColType type = typeCode(schema.types[c]);
+            size_t width = columnWidth(type, schema.lengths[c]);
+            if (zones[c].size < bitmapSize(slots) || zones[c].offset > byteSize || zones[c].size > byteSize - zones[c].offset)
+                return false;
+            uint64_t seg = block + zones[c].offset;
+            uint64_t valuesAt = seg + bitmapSize(slots);
+
+            bitmap.resize(hi / 8 - lo / 8 + 1);
+            f.seekg(seg + lo / 8);
+            f.read(&bitmap[0], bitmap.size());
+
+            // The rows of an encoded segment are looked up one by one, through
+            // cached pages, without decoding the rest of it, unless they are
+            // dense enough in their slot range that decoding the range is
+            // cheaper.
+            uint32_t encoding = zones[c].encoding;
+            bool encoded = encoding != SEG_PLAIN;
+            if (encoded && (j - i) * 16 >= hi - lo + 1) {
+                segment.resize(zones[c].size - bitmapSize(slots));
+                f.seekg(valuesAt);
+                if (!f.read(&segment[0], segment.size()))
+                    return false;
+                values.resize((size_t)(hi - lo + 1) * width);
+                decodeSegment(segment.data(), encoding, width, slots, lo, hi + 1, &values[0]);
+                encoded = false;
+            }
+            else if (!encoded) {
+                values.resize((size_t)(hi - lo + 1) * width);
+                f.seekg(valuesAt + (uint64_t)lo * width);
+                if (!f.read(&values[0], values.size()))
+                    return false;
+            }
+
+            for (size_t k = i; k < j; k++)
+            {
+                uint32_t r = locationSlot(locations[k]);
+                if (bitmap[r / 8 - lo / 8] & (1 << (r % 8)))
+                    rows[k][c] = "NULL";
+                else if (encoded) {
+                    entry.resize(width);
+                    if (!readEncodedSlot(pages, valuesAt, encoding, width, slots, r, &entry[0]))
+                        return false;
+                    rows[k][c] = decodeValue(type, entry.data(), width);
+                }
+                else
+                    rows[k][c] = decodeValue(type, &values[(r - lo) * width], width);
+            }
+        }
+        i = j;
+    }
+    return true;
+}
+
+bool writeRowsAt(string tableName, const TableData& schema, const vector<uint64_t>& locations, const vector<vector<string>>& rows,
+    bool* rewritten)
+{
+    if (rewritten)
+        *rewritten = false;
+    {
+        fstream f(tableFile(tableName), ios::binary | ios::in | ios::out);
+        if (!f.good())
+            return false;
+
+        // Records are patched in cached pages, so each touched page is read and
+        // written once however many cells of it change. Encoded segments that
+        // lack a code or packed value for some of the rows are re-encoded once,
+        // with all of them.
+        PagePatcher pages(f);
+        map<uint64_t, SegmentEdit> edits;
+        string slot;
+        for (size_t k = 0; k < locations.size(); k++)
+        {
+            uint64_t block = locationBlock(locations[k]);
+            uint32_t r = locationSlot(locations[k]);
+            uint32_t counts[2];
+            uint64_t byteSize;
+            if (!pages.read(block, counts, 8) || r >= counts[0] || !pages.read(block + 8, &byteSize, 8))
+                return false;
+            if (!patchRow(pages, schema, block, blockSlots(counts[0], counts[1]), r, zoneMapOffset(schema, block, byteSize),
+                true, rows[k], slot, &edits))
+                return false;
+        }
+        bool fits = true;
+        for (auto it = edits.begin(); fits && it != edits.end(); ++it)
+            if (!reencodeSegment(pages, schema, it->first, it->second, fits))
+                return false;
+        if (fits)
+            return pages.commit();
+    }
+
+    // Some segment outgrew its space, and the blocks after it cannot move, so
+    // nothing is patched: the table is rewritten with the rows instead.
+    TableData t;
+    vector<uint64_t> at;
+    if (!loadTable(tableName, t, &at))
+        return false;
+    unordered_map<uint64_t, size_t> rowAt;
+    for (size_t i = 0; i < at.size(); i++)
+        rowAt[at[i]] = i;
+    for (size_t k = 0; k < locations.size(); k++)
+    {
+        auto it = rowAt.find(locations[k]);
+        if (it == rowAt.end())
+            return false;
+        t.rows[it->second] = rows[k];
+    }
+    if (!saveTable(tableName, t))
+        return false;
+    if (rewritten)
+        *rewritten = true;
+    return true;
+}
+
+bool deleteRowsAt(string tableName, const TableData& schema, const vector<uint64_t>& locations)
+{
+    fstream f(tableFile(tableName), ios::binary | ios::in | ios::out);
+    if (!f.good())
+        return false;
+
+    // Each block's dead count and zone map are written back with its bitmap
+    // pages. The zone bounds stay as they are; only the counts go down.
+    PagePatcher pages(f);
+    size_t columns = schema.columns.size();
+    map<uint64_t, uint32_t> deadRows;
+    map<uint64_t, vector<ColumnZone>> zones;
+    uint64_t block = UINT64_MAX, byteSize = 0;
+    uint32_t counts[2] = { 0, 0 };
+    for (uint64_t loc : locations)
+    {
+        uint32_t r = locationSlot(loc);
+        char bits;
+        if (locationBlock(loc) != block) {
+            block = locationBlock(loc);
+            if (!pages.read(block, counts, 8) || !pages.read(block + 8, &byteSize, 8))
+                return false;
+        }
+        uint64_t bitAt = block + TBL_BLOCK_HEADER_SIZE + r / 8;
+        if (r >= counts[0] || !pages.read(bitAt, &bits, 1))
+            return false;
+        if (!deadRows.count(block) && !pages.read(block + TBL_DEAD_COUNT_OFFSET, &deadRows[block], 4))
+            return false;
+        if (bits & (1 << (r % 8)))
+            continue;
+
+        vector<ColumnZone>& zone = zones[block];
+        if (zone.empty()) {
+            zone.resize(columns);
+            if (!pages.read(zoneMapOffset(schema, block, byteSize), zone.data(), zoneMapSize(columns)))
+                return false;
+        }
+        for (size_t c = 0; c < columns; c++)
+            if (!uncountCell(pages, block + zone[c].offset + r / 8, r, zone[c]))
+                return false;
+
+        if (!pages.setBit(bitAt, r % 8, true))
+            return false;
+        deadRows[block]++;
+    }
+    for (auto& kv : deadRows)
+        if (!pages.write(kv.first + TBL_DEAD_COUNT_OFFSET, &kv.second, 4))
+            return false;
+    for (auto& kv : zones)
+    {
+        uint64_t size;
+        if (!pages.read(kv.first + 8, &size, 8) || !pages.write(zoneMapOffset(schema, kv.first, size), kv.second.data(), zoneMapSize(columns)))
+            return false;
+    }
+    return pages.commit();
+}
+
+bool readTableTail(string tableName, const TableData& schema, TableBlock& tail)
+{
+    vector<TableBlock> blocks;
+    if (!readBlockDirectory(tableName, schema, blocks))
+        return false;
+    tail = blocks.empty() ? TableBlock() : blocks.back();
+    return true;
+}
+
+bool setBlockRowCount(string tableName, uint64_t blockOffset, uint32_t rowCount)
+{
+    fstream f(tableFile(tableName), ios::binary | ios::in | ios::out);
+    if (!f.good())
+        return false;
+    f.seekp(blockOffset);
+    f.write((const char*)&rowCount, 4);
+    f.flush();
+    return f.good();
+}
+
+bool appendTableRows(string tableName, const TableData& schema, const vector<vector<string>>& rows, vector<uint64_t>* locations)
+{
+    TableBlock tail;
+    if (!readTableTail(tableName, schema, tail)) {
+        setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+
+    // Spare slots of the last block are filled in place first; its row
+    // count is bumped only after the rows themselves are written.
+    uint32_t tailSlots = blockSlots(tail.rowCount, tail.capacity);
+    size_t filled = tail.byteSize ? min(rows.size(), (size_t)(tailSlots - tail.rowCount)) : 0;
+    if (filled > 0)
+    {
+        fstream f(tableFile(tableName), ios::binary | ios::in | ios::out);
+        PagePatcher pages(f);
+        string slot;
+        for (size_t r = 0; r < filled; r++)
+        {
+            uint32_t at = tail.rowCount + (uint32_t)r;
+            if (!f.good() || !patchRow(pages, schema, tail.offset, tailSlots, at,
+                zoneMapOffset(schema, tail.offset, tail.byteSize), false, rows[r], slot))
+                return false;
+            if (locations)
+                locations->push_back(makeRowLocation(tail.offset, at));
+        }
+        uint32_t rowCount = tail.rowCount + (uint32_t)filled;
+        if (!pages.commit() || !pages.write(tail.offset, &rowCount, 4) || !pages.commit()) {
+            setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
+            return false;
+        }
+    }
+    if (filled == rows.size())
+        return true;
+
+    // The rest goes into new blocks, each reserving twice the slots of the
+    // previous appended block.
+    uint64_t base = tableFileSize(tableName);
+    uint32_t capacity = tail.capacity ? tail.capacity : TBL_MIN_CAPACITY / 2;
+    string buf, err;
+    for (size_t begin = filled; begin < rows.size(); begin += TBL_BLOCK_ROWS)
+    {
+        size_t end = min(rows.size(), begin + TBL_BLOCK_ROWS);
+        capacity = (uint32_t)min<size_t>(TBL_BLOCK_ROWS, max<size_t>((size_t)capacity * 2, end - begin));
+        if (locations)
+            for (size_t r = begin; r < end; r++)
+                locations->push_back(makeRowLocation(base + buf.size(), (uint32_t)(r - begin)));
+        if (!appendTableBlock(schema, rows, begin, end, buf, err, capacity)) {
+            setColor(12); cout << "Error: Cannot write to table '" << tableName << "': " << err << ".\n"; setColor(15);
+            return false;
+        }
+    }
+
+    ofstream f(tableFile(tableName), ios::binary | ios::app);
+    if (!f.is_open()) {
+        setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+    f.write(buf.data(), buf.size());
+    return f.good();
+}
+
+TableData readCsvTable(string tableName)
+{
+    TableData t;
+    ifstream f(tableName + ".csv");
+    if (!f.good()) {
+        setColor(12); cout << "Error: Table not found.\n"; setColor(15);
+        return t;
+    }
+
+    string line;
+    if (!getline(f, line)) return t;
+
+    vector<string> colDefs = split(line, ',');//ID:INT:PK , NAME:VARCHAR(50):NN ,   AGE:INT
+    t.primaryKeyIndex = -1;
+    for (int i = 0; i < (int)colDefs.size(); ++i) {
+        string d = trim(colDefs[i]);
+
+        vector<string> parts = split(d, ':');
+        if (parts.size() < 2) continue;
+        string name = trim(parts[0]);
+        string typeDef = trim(parts[1]);
+
+        string baseType = typeDef;
+        int length = -1;
+        size_t p = typeDef.find('(');
+        if (p != string::npos) {
+            size_t q = typeDef.find(')', p);
+            if (q != string::npos) {
+                baseType = typeDef.substr(0, p);
+                string lenStr = typeDef.substr(p + 1, q - p - 1);
+                try { length = stoi(lenStr); }
+                catch (...) { length = -1; }
+            }
+        }
+        for (auto& ch : baseType) ch = toupper(ch);
+
+        bool isNN = false;
+        bool isPK = false;
+        for (size_t k = 2; k < parts.size(); ++k) {
+            string up = parts[k];
+            toUpper(up);
+            if (up == "NN" || up == "NOTNULL" || up == "NOT NULL") isNN = true;
+            if (up == "PK" || up == "PRIMARY" || up == "PRIMARYKEY" || up == "PRIMARY KEY") isPK = true;
+        }
+        t.columns.push_back(name);
+        t.types.push_back(baseType);
+        t.lengths.push_back(length);
+        t.notNull.push_back(isNN);
+        if (isPK) t.primaryKeyIndex = (int)i;
+    }
+
+    while (getline(f, line)) {
+        if (trim(line).empty()) continue;
+        vector<string> vals = split(line, ',');
+        for (auto& v : vals) v = trim(v);
+        vals.resize(t.columns.size());
+        t.rows.push_back(vals);
+    }
+    return t;
+}
+
+bool convertCsvTable(string tableName)
+{
+    if (tableExists(tableName)) {
+        setColor(12); cout << "Error: Table '" << tableName << "' is already in binary format.\n"; setColor(15);
+        return false;
+    }
+
+    TableData t = readCsvTable(tableName);
+    if (t.columns.empty())
+        return false;
+
+    // VARCHAR(n) and CHAR(n) slots need a declared length; old files may lack one.
+    for (size_t c = 0; c < t.columns.size(); c++)
+    {
+        ColType type = typeCode(t.types[c]);
+        if ((type == COL_CHAR || type == COL_VARCHAR) && t.lengths[c] <= 0) {
+            int longest = 1;
+            for (auto& row : t.rows)
+                longest = max(longest, (int)row[c].size());
+            t.lengths[c] = min(longest, TBL_MAX_STRING_LENGTH);
+        }
+    }
+
+    for (size_t r = 0; r < t.rows.size(); r++)
+    {
+        for (size_t c = 0; c < t.columns.size(); c++)
+        {
+            string err;
+            if (!validateValue(t.types[c], t.lengths[c], t.rows[r][c], err)) {
+                setColor(12);
+                cout << "Error: " << err << " for column '" << t.columns[c] << "' (row " << (r + 1) << ").\n";
+                setColor(15);
+                return false;
+            }
+        }
+    }
+
+    if (!saveTable(tableName, t))
+        return false;
+
+    setColor(10);
+    cout << "Table '" << tableName << "' converted to binary format (" << t.rows.size() << " row(s)).\n";
+    setColor(15);
+    return true;
+}
+
+bool executeConvert(const ConvertQuery& q)
+{
+    return convertCsvTable(q.tableName);
+}
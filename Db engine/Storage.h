@@ -0,0 +1,267 @@
+#pragma once
+#ifndef STORAGE_H
+#define STORAGE_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "utils.h"
+#include "parser.h"
+using namespace std;
+
+// Binary table file (<table>.tbl), all integers little-endian:
+//
+//   header : "ITDB", version, column count, primary key index, LSN of the last
+//            write-ahead log record applied to the file (see WriteAheadLog.h),
+//            then per column name length + name, type code, declared length
+//            and NOT NULL flag. Version 1 files have no LSN and read as LSN 0.
+//   blocks : repeated until end of file. Each block starts with its row count,
+//            slot capacity (0 when it equals the row count), total byte size
+//            and count of deleted rows, then a bitmap of the deleted rows,
+//            followed by one segment per column: a null bitmap and then one
+//            fixed-width slot per row slot, and last the block's zone map.
+//            Version 6 files have 32-byte zone map entries and encoded
+//            segments that keep the size of plain ones, version 5 files only
+//            have dictionary-encoded segments, version 4 files have 24-byte
+//            zone map entries and no encoded segments, version 3 files have
+//            no zone maps, and version 2 and older files have 16-byte block
+//            headers and no deleted-row bitmap; they are rewritten in the
+//            current format at startup.
+//
+// A zone map holds one ColumnZone per column: the smallest and largest value
+// and the number of NULL and non-NULL cells among the block's rows, so a scan
+// can pass over a block no row of which can match its condition. Writes only
+// ever widen the bounds and DELETE lowers the counts, so the map may grow
+// loose but never excludes a live row; rewrites of the whole table make it
+// exact again. The entry also says how the column's segment is encoded and
+// where it lies: its offset from the start of the block and its size.
+//
+// Segment encodings: in a block written without spare slots, a column's
+// values may be stored encoded instead of as one slot per row. The encoded
+// values follow the null bitmap in place of the slots and the next segment
+// starts right after them:
+//
+//   SEG_DICTIONARY (CHAR, VARCHAR): entry count (uint32), code size in bytes
+//       (uint32, 1 or 2), padded codes, then the distinct values, sorted, as
+//       slots of the column; a row's code is its value's position
+//   SEG_RLE (any number type): run count (uint32), 0 (uint32), padded run
+//       ends (uint32, the row after the run), then one slot per run
+//   SEG_DELTA (INT): bit width (uint32), 0 (uint32), per group of
+//       TBL_DELTA_GROUP rows its first value and smallest step (int32 each),
+//       then per row its step from the previous row less the group's
+//       smallest step, in bit width bits (0 for the first row of a group)
+//   SEG_FOR (INT): reference, the smallest value (int32), bit width (uint32),
+//       then per row its value less the reference, in bit width bits
+//
+// Bits are packed from the lowest up into 64-bit words. NULL rows encode as
+// the value of the row before them. A block's column takes the smallest
+// encoding that at least halves the bytes a scan of the segment reads, if
+// any. Since dictionary codes order like the values they stand for, a
+// comparison turns into a range of codes. UPDATE writes a code or packed
+// value when the new value has one. Otherwise the block's segment is
+// re-encoded with the new values once the statement's rows are all in, and
+// takes the space it had; when it no longer fits, the whole table is
+// rewritten.
+//
+// Blocks appended by INSERT reserve spare slots, twice as many as the
+// previous appended block up to TBL_BLOCK_ROWS, and later INSERTs fill them
+// in place before a new block is added. Rewrites of the whole table pack
+// blocks without spare slots.
+//
+// DELETE only sets the rows' bits in the deleted-row bitmap, which every
+// reader skips, so row locations stay stable until VACUUM rewrites the table
+// without the dead rows (see Vacuum.h).
+//
+// INT is stored as int32, FLOAT as float, DOUBLE as double, CHAR(n) as n bytes
+// padded with zeros and VARCHAR(n) as a 2-byte length followed by an n-byte slot.
+// Every section is padded to 8 bytes so typed segments stay aligned.
+
+const char TBL_MAGIC[4] = { 'I', 'T', 'D', 'B' };
+const uint32_t TBL_VERSION = 7;
+const size_t TBL_LSN_OFFSET = 16;
+const uint32_t TBL_BLOCK_ROWS = 65536;
+const uint32_t TBL_MIN_CAPACITY = 64;
+const size_t TBL_PAGE_SIZE = 4096;
+const int TBL_MAX_STRING_LENGTH = 65535;
+const size_t TBL_BLOCK_HEADER_SIZE = 24;
+const size_t TBL_V2_BLOCK_HEADER_SIZE = 16;
+const size_t TBL_DEAD_COUNT_OFFSET = 16;   // within the block header
+const size_t TBL_VALUE_SCRATCH = 32;
+const size_t TBL_ZONE_SIZE = 48;            // per column
+const size_t TBL_V6_ZONE_SIZE = 32;
+const size_t TBL_V4_ZONE_SIZE = 24;
+const uint32_t TBL_DICTIONARY_MAX = 65535;  // entries of a block dictionary
+const uint32_t TBL_DELTA_GROUP = 128;
+
+// A row location packs the file offset of its block with the row's slot in it.
+inline uint64_t makeRowLocation(uint64_t blockOffset, uint32_t slot) { return (blockOffset << 16) | slot; }
+inline uint64_t locationBlock(uint64_t location) { return location >> 16; }
+inline uint32_t locationSlot(uint64_t location) { return (uint32_t)(location & 0xFFFF); }
+
+// Slots laid out in a block: segments are sized for these, not the row count.
+inline uint32_t blockSlots(uint32_t rowCount, uint32_t capacity) { return capacity > rowCount ? capacity : rowCount; }
+
+struct TableBlock
+{
+    uint64_t offset = 0;
+    uint64_t byteSize = 0;
+    uint32_t rowCount = 0;
+    uint32_t capacity = 0;
+    uint32_t deadRows = 0;
+};
+
+enum ColType : uint8_t
+{
+    COL_INT = 1,
+    COL_FLOAT = 2,
+    COL_DOUBLE = 3,
+    COL_CHAR = 4,
+    COL_VARCHAR = 5
+};
+
+enum SegmentEncoding : uint32_t
+{
+    SEG_PLAIN = 0,
+    SEG_DICTIONARY = 1,
+    SEG_RLE = 2,
+    SEG_DELTA = 3,
+    SEG_FOR = 4
+};
+
+// Bounds of one column of a block. INT values are kept as int64, FLOAT and
+// DOUBLE as double; strings by their first 8 bytes, big-endian, so that the
+// keys order like the strings. The counts may be high, never low.
+struct ColumnZone
+{
+    uint64_t low = 0;
+    uint64_t high = 0;
+    uint32_t nulls = 0;
+    uint32_t values = 0;
+    uint32_t encoding = SEG_PLAIN;
+    uint32_t reserved = 0;
+    uint64_t offset = 0;        // of the column's segment, from the start of the block
+    uint64_t size = 0;          // of the segment, null bitmap included
+};
+
+// The values of a dictionary-encoded segment, as laid out above.
+struct DictionarySegment
+{
+    uint32_t entries = 0;
+    uint32_t codeSize = 0;
+    const char* codes = nullptr;
+    const char* dictionary = nullptr;
+
+    uint32_t code(uint32_t r) const
+    {
+        if (codeSize == 1)
+            return (uint8_t)codes[r];
+        uint16_t c;
+        memcpy(&c, codes + (size_t)r * 2, 2);
+        return c;
+    }
+    const char* entry(uint32_t code, size_t width) const { return dictionary + (size_t)code * width; }
+};
+
+// The runs of a run-length encoded segment, as laid out above.
+struct RunSegment
+{
+    uint32_t runs = 0;
+    const char* ends = nullptr;
+    const char* values = nullptr;
+
+    uint32_t end(uint32_t run) const
+    {
+        uint32_t e;
+        memcpy(&e, ends + (size_t)run * 4, 4);
+        return e;
+    }
+    // The run row r is in.
+    uint32_t find(uint32_t r) const
+    {
+        uint32_t lo = 0, hi = runs;
+        while (lo < hi)
+        {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (end(mid) <= r)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+    const char* value(uint32_t run, size_t width) const { return values + (size_t)run * width; }
+};
+
+inline size_t zoneMapSize(size_t columns) { return columns * TBL_ZONE_SIZE; }
+inline ColumnZone readZone(const char* zoneMap, size_t col)
+{
+    ColumnZone z;
+    memcpy(&z, zoneMap + col * TBL_ZONE_SIZE, sizeof z);
+    return z;
+}
+uint64_t stringZoneKey(string_view s);
+// Counts a non-NULL value, in its stored slot form, into a zone.
+void addToZone(ColumnZone& zone, ColType type, const char* slot, size_t width);
+
+ColType typeCode(const string& type);
+size_t columnWidth(ColType type, int length);
+size_t bitmapSize(uint32_t rowCount);
+size_t segmentSize(ColType type, int length, uint32_t rowCount);
+// values points just past the segment's null bitmap.
+DictionarySegment dictionarySegment(const char* values, uint32_t slots);
+RunSegment runSegment(const char* values);
+// Decodes rows [begin, end) of a segment laid out for slots rows into plain
+// slots at out, the first at out[0]; values points past its null bitmap.
+void decodeSegment(const char* values, uint32_t encoding, size_t width, uint32_t slots, uint32_t begin,
+    uint32_t end, char* out);
+// Bytes of the values area an encoded segment uses, from its first 8 bytes.
+size_t encodedSize(const char* header, uint32_t encoding, size_t width, uint32_t slots);
+// Whether the values of a segment, space bytes past its null bitmap, are
+// well formed for its encoding and column type and lie within those bytes.
+bool checkSegment(const char* values, size_t space, uint32_t encoding, ColType type, size_t width, uint32_t slots);
+
+bool isNullValue(const string& value);
+bool validateValue(const string& type, int length, const string& value, string& err);
+string canonicalValue(const string& type, const string& value);
+
+void appendTableHeader(const TableData& schema, string& out);
+bool appendTableBlock(const TableData& schema, const vector<vector<string>>& rows,
+    size_t begin, size_t end, string& out, string& err, uint32_t capacity = 0);
+bool encodeValue(ColType type, int length, const string& value, char* slot, string& err);
+// Numbers are formatted into scratch (TBL_VALUE_SCRATCH bytes); strings point into slot.
+string_view viewValue(ColType type, const char* slot, size_t width, char* scratch);
+bool encodeTable(const TableData& t, string& out, string& err, vector<uint64_t>* blockOffsets = nullptr);
+
+bool decodeTableHeader(const char* data, size_t size, TableData& t, size_t& offset, string& err,
+    uint32_t* version = nullptr);
+// With locations, also gives every decoded row's location.
+bool decodeTable(const char* data, size_t size, TableData& t, string& err, vector<uint64_t>* locations = nullptr);
+
+bool readTableSchema(string tableName, TableData& t);
+// Values of one column for every live row, with their locations if asked for.
+bool readTableColumn(string tableName, const TableData& schema, int col, vector<string>& out,
+    vector<uint64_t>* locations = nullptr);
+uint64_t tableFileSize(string tableName);
+uint32_t tableFileVersion(string tableName);
+// Forces the table to disk, then records lsn as reflected in it.
+bool stampTableLsn(string tableName, uint64_t lsn);
+// Fails if the file's columns do not match schema.
+bool readBlockDirectory(string tableName, const TableData& schema, vector<TableBlock>& blocks);
+bool readTableTail(string tableName, const TableData& schema, TableBlock& tail);
+bool setBlockRowCount(string tableName, uint64_t blockOffset, uint32_t rowCount);
+bool readRowsAt(string tableName, const TableData& schema, const vector<uint64_t>& locations, vector<vector<string>>& rows);
+// Sets rewritten when an encoded segment had no room left for the rows and
+// the table was rewritten instead, which also rebuilt its indexes.
+bool writeRowsAt(string tableName, const TableData& schema, const vector<uint64_t>& locations, const vector<vector<string>>& rows,
+    bool* rewritten = nullptr);
+// Marks the rows deleted; rows already marked are left alone.
+bool deleteRowsAt(string tableName, const TableData& schema, const vector<uint64_t>& locations);
+bool appendTableRows(string tableName, const TableData& schema, const vector<vector<string>>& rows,
+    vector<uint64_t>* locations = nullptr);
+
+TableData readCsvTable(string tableName);
+bool convertCsvTable(string tableName);
+bool executeConvert(const ConvertQuery& q);
+
+#endif
@@ -0,0 +1,318 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <Windows.h>
+#include "tablescanner.h"
+#include "storage.h"
+#include "utils.h"
+#include "filterkernels.h"
+using namespace std;
+
+bool TableScanner::open(string tableName)
+{
+    close();
+    HANDLE h = CreateFileA(tableFile(tableName).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) {
+        reportMissingTable(tableName);
+        return false;
+    }
+    file = h;
+
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(h, &fileSize))
+        size = (uint64_t)fileSize.QuadPart;
+    if (size > 0)
+        mapping = CreateFileMappingA(h, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping)
+        base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    size_t offset;
+    uint32_t version = 0;
+    string err = "cannot map file";
+    bool decoded = base && decodeTableHeader(base, size, header, offset, err, &version);
+    if (decoded && version != TBL_VERSION) {
+        decoded = false;
+        err = "version " + to_string(version) + " needs an upgrade";
+    }
+    if (!decoded) {
+        setColor(12); cout << "Error: Table '" << tableName << "' is corrupt (" << err << ").\n"; setColor(15);
+        close();
+        return false;
+    }
+
+    for (size_t c = 0; c < header.columns.size(); c++)
+    {
+        types.push_back(typeCode(header.types[c]));
+        widths.push_back(columnWidth(types[c], header.lengths[c]));
+    }
+    segments.resize(types.size());
+    encodings.resize(types.size());
+    dictionaries.resize(types.size());
+    values.resize(types.size());
+    decodeBuffers.resize(types.size());
+    scratch.resize(types.size() * TBL_VALUE_SCRATCH);
+    dataOffset = nextBlock = offset;
+    return true;
+}
+
+bool TableScanner::openMorsel(const TableScanner& parent, const ScanMorsel& morsel)
+{
+    close();
+    rangeBegin = morsel.begin;
+    rangeEnd = morsel.end;
+    if (!parent.base)
+        return false;
+
+    ownsMapping = false;
+    base = parent.base;
+    size = parent.size;
+    header = parent.header;
+    types = parent.types;
+    widths = parent.widths;
+    segments.resize(types.size());
+    encodings.resize(types.size());
+    dictionaries.resize(types.size());
+    values.resize(types.size());
+    decodeBuffers.resize(types.size());
+    scratch.resize(types.size() * TBL_VALUE_SCRATCH);
+    dataOffset = nextBlock = morsel.blockOffset;
+    endBlock = morsel.blockOffset + 1;
+    return true;
+}
+
+uint64_t TableScanner::rowCount() const
+{
+    uint64_t rows = 0;
+    uint64_t at = dataOffset;
+    while (base && at + TBL_BLOCK_HEADER_SIZE <= size)
+    {
+        uint32_t blockRows, deadRows;
+        uint64_t byteSize;
+        memcpy(&blockRows, base + at, 4);
+        memcpy(&byteSize, base + at + 8, 8);
+        memcpy(&deadRows, base + at + TBL_DEAD_COUNT_OFFSET, 4);
+        if (byteSize < TBL_BLOCK_HEADER_SIZE || at + byteSize > size)
+            break;
+        rows += blockRows - min(deadRows, blockRows);
+        at += byteSize;
+    }
+    return rows;
+}
+
+vector<ScanMorsel> TableScanner::morsels(uint32_t maxRows) const
+{
+    vector<ScanMorsel> out;
+    uint64_t at = dataOffset;
+    while (base && at + TBL_BLOCK_HEADER_SIZE <= size)
+    {
+        uint32_t rowCount, deadRows;
+        uint64_t byteSize;
+        memcpy(&rowCount, base + at, 4);
+        memcpy(&byteSize, base + at + 8, 8);
+        memcpy(&deadRows, base + at + TBL_DEAD_COUNT_OFFSET, 4);
+        if (byteSize < TBL_BLOCK_HEADER_SIZE || at + byteSize > size)
+            break; // the cursor that reaches this block reports the damage
+        if (deadRows < rowCount)
+            for (uint32_t r = 0; r < rowCount; r += maxRows)
+                out.push_back({ at, r, min(r + maxRows, rowCount) });
+        at += byteSize;
+    }
+    // Keep a truncated tail visible to the last cursor so the error surfaces.
+    if (base && at + TBL_BLOCK_HEADER_SIZE <= size)
+        out.push_back({ at, 0, UINT32_MAX });
+    return out;
+}
+
+void TableScanner::close()
+{
+    if (base && ownsMapping)
+        UnmapViewOfFile(base);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file)
+        CloseHandle(file);
+    base = nullptr;
+    mapping = nullptr;
+    file = nullptr;
+    size = 0;
+    ownsMapping = true;
+    dataOffset = 0;
+    header = TableData();
+    types.clear();
+    widths.clear();
+    segments.clear();
+    encodings.clear();
+    dictionaries.clear();
+    values.clear();
+    decodeBuffers.clear();
+    scratch.clear();
+    blockOffset = nextBlock = 0;
+    blockLayout = blockEnd = slot = 0;
+    blockDead = nullptr;
+    endBlock = UINT64_MAX;
+    rangeBegin = 0;
+    rangeEnd = UINT32_MAX;
+    started = false;
+    filter = nullptr;
+}
+
+bool TableScanner::enterBlock()
+{
+    while (nextBlock < endBlock && nextBlock + TBL_BLOCK_HEADER_SIZE <= size)
+    {
+        uint32_t rowCount, capacity, deadRows;
+        uint64_t byteSize;
+        memcpy(&rowCount, base + nextBlock, 4);
+        memcpy(&capacity, base + nextBlock + 4, 4);
+        memcpy(&byteSize, base + nextBlock + 8, 8);
+        memcpy(&deadRows, base + nextBlock + TBL_DEAD_COUNT_OFFSET, 4);
+        if (byteSize < TBL_BLOCK_HEADER_SIZE + bitmapSize(blockSlots(rowCount, capacity)) + zoneMapSize(types.size())
+            || byteSize > size - nextBlock) {
+            setColor(12); cout << "Error: Table file is corrupt (truncated block).\n"; setColor(15);
+            return false;
+        }
+
+        blockOffset = nextBlock;
+        nextBlock += byteSize;
+        if (rowCount == 0 || deadRows >= rowCount)
+            continue;
+        // Blocks whose zone map rules the condition out are never touched.
+        if (filter && !filter->mayMatch(base + nextBlock - zoneMapSize(types.size())))
+            continue;
+
+        blockLayout = blockSlots(rowCount, capacity);
+        const char* zoneMap = base + nextBlock - zoneMapSize(types.size());
+        const char* block = base + blockOffset;
+        blockDead = deadRows > 0 ? block + TBL_BLOCK_HEADER_SIZE : nullptr;
+        for (size_t c = 0; c < types.size(); c++)
+        {
+            ColumnZone zone = readZone(zoneMap, c);
+            const char* at = block + min<uint64_t>(zone.offset, byteSize);
+            if (zone.size < bitmapSize(blockLayout) || zone.offset > byteSize || zone.size > byteSize - zone.offset
+                || !checkSegment(at + bitmapSize(blockLayout), zone.size - bitmapSize(blockLayout), zone.encoding,
+                    types[c], widths[c], blockLayout)) {
+                setColor(12); cout << "Error: Table file is corrupt (truncated block).\n"; setColor(15);
+                return false;
+            }
+            segments[c] = at;
+            encodings[c] = zone.encoding;
+            dictionaries[c] = encodings[c] == SEG_DICTIONARY
+                ? dictionarySegment(at + bitmapSize(blockLayout), blockLayout) : DictionarySegment();
+            values[c] = encodings[c] == SEG_PLAIN ? at + bitmapSize(blockLayout) : nullptr;
+        }
+        blockEnd = min(rowCount, rangeEnd);
+        slot = 0;
+        if (rangeBegin >= blockEnd)
+            continue;
+
+        if (filter || blockDead) {
+            size_t words = selectionWords(blockEnd - rangeBegin);
+            selection.resize(words);
+            if (filter)
+                filter->filterBlock(segments, widths, encodings, blockLayout, rangeBegin, blockEnd, selection.data());
+            else
+                fill(selection.begin(), selection.end(), ~0ull);
+            // rangeBegin is a multiple of 64, so dead rows line up with whole words.
+            for (size_t w = 0; blockDead && w < words; w++)
+            {
+                size_t byte = rangeBegin / 8 + w * 8;
+                uint64_t dead = 0;
+                memcpy(&dead, blockDead + byte, min<size_t>(8, bitmapSize(blockLayout) - byte));
+                selection[w] &= ~dead;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+uint32_t TableScanner::nextSelected(uint32_t from) const
+{
+    from -= rangeBegin;
+    size_t w = from / 64;
+    uint64_t word = selection[w] & (~0ull << (from % 64));
+    while (word == 0)
+    {
+        if (++w >= selection.size())
+            return blockEnd;
+        word = selection[w];
+    }
+    return rangeBegin + (uint32_t)(w * 64 + lowestSetBit(word));
+}
+
+bool TableScanner::next()
+{
+    if (!base)
+        return false;
+
+    uint32_t from = started ? slot + 1 : blockEnd;
+    started = true;
+    while (true)
+    {
+        if (from < blockEnd) {
+            uint32_t s = filter || blockDead ? nextSelected(from) : from;
+            if (s < blockEnd) {
+                slot = s;
+                return true;
+            }
+        }
+        if (!enterBlock())
+            return false;
+        from = rangeBegin;
+    }
+}
+
+string_view TableScanner::field(int col)
+{
+    if (segments[col][slot / 8] & (1 << (slot % 8)))
+        return "NULL";
+    return viewValue(types[col], slotOf(col), widths[col], &scratch[col * TBL_VALUE_SCRATCH]);
+}
+
+// The current row's slot of an encoded column, decoding the cursor's rows of
+// the block first unless the segment is dictionary-encoded.
+const char* TableScanner::encodedSlot(int col) const
+{
+    size_t width = widths[col];
+    const DictionarySegment& d = dictionaries[col];
+    if (d.codes)
+        return d.entry(d.code(slot), width);
+    decodeBuffers[col].resize((size_t)blockLayout * width);
+    char* out = decodeBuffers[col].data();
+    decodeSegment(segments[col] + bitmapSize(blockLayout), encodings[col], width, blockLayout, rangeBegin,
+        blockEnd, out + (size_t)rangeBegin * width);
+    values[col] = out;
+    return values[col] + (size_t)slot * width;
+}
+
+bool TableScanner::isNull(int col) const
+{
+    return (segments[col][slot / 8] & (1 << (slot % 8))) != 0;
+}
+
+int64_t TableScanner::intField(int col) const
+{
+    int32_t v;
+    memcpy(&v, slotOf(col), sizeof v);
+    return v;
+}
+
+double TableScanner::realField(int col) const
+{
+    const char* at = slotOf(col);
+    if (types[col] == COL_INT) {
+        int32_t v;
+        memcpy(&v, at, sizeof v);
+        return v;
+    }
+    if (types[col] == COL_FLOAT) {
+        float v;
+        memcpy(&v, at, sizeof v);
+        return v;
+    }
+    double v;
+    memcpy(&v, at, sizeof v);
+    return v;
+}
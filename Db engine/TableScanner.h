@@ -0,0 +1,120 @@
+#pragma once
+#ifndef TABLESCANNER_H
+#define TABLESCANNER_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "utils.h"
+#include "storage.h"
+#include "filter.h"
+using namespace std;
+
+// Row cursor over a table that hands out fields as string_view, without
+// allocating per cell. The .tbl file is memory-mapped and fields point
+// straight into the mapping (numbers are formatted into a per-column scratch
+// buffer). Views stay valid until the next call to next() or close(). Rows
+// marked deleted are skipped.
+//
+// Run-length, delta and frame-of-reference segments (see Storage.h) are
+// decoded lazily: the rows a cursor covers in a block are decoded the first
+// time a field of the column is read there. Filters work on the encoded
+// segments themselves.
+//
+// For parallel scans the open table is cut into morsels, row ranges that
+// never cross a block, and each worker walks one through its own cursor
+// opened with openMorsel. Such a cursor borrows the parent's mapping, so the
+// parent must stay open until every morsel cursor is closed.
+
+struct ScanMorsel
+{
+    uint64_t blockOffset = 0;   // block in the mapped file
+    uint32_t begin = 0;         // row range within the block
+    uint32_t end = 0;
+};
+
+class TableScanner
+{
+public:
+    TableScanner() = default;
+    TableScanner(const TableScanner&) = delete;
+    TableScanner& operator=(const TableScanner&) = delete;
+    ~TableScanner() { close(); }
+
+    bool open(string tableName);
+    bool openMorsel(const TableScanner& parent, const ScanMorsel& morsel);
+    void close();
+
+    // Splits the open table into morsels of at most maxRows rows (a multiple
+    // of 64), in table order.
+    vector<ScanMorsel> morsels(uint32_t maxRows) const;
+    // Live rows of the open table, from the block headers.
+    uint64_t rowCount() const;
+
+    const TableData& schema() const { return header; }
+    // Restricts next() to rows matching f. Mapped blocks whose zone map
+    // rules f out are skipped; the others are filtered a whole column
+    // segment at a time into a selection bitmap.
+    void setFilter(const Filter* f) { filter = f; }
+    bool next();
+    string_view field(int col);
+    // Typed reads of the current row that skip formatting numbers as text.
+    // intField is for INT columns, realField for any numeric column; neither
+    // is meaningful for a NULL field.
+    bool isNull(int col) const;
+    int64_t intField(int col) const;
+    double realField(int col) const;
+    // The dictionary of col in the current block, null unless the column's
+    // segment is dictionary-encoded, and the current row's code in it. Rows
+    // with equal codes hold equal values.
+    const DictionarySegment* dictionary(int col) const
+    {
+        return dictionaries[col].codes ? &dictionaries[col] : nullptr;
+    }
+    uint32_t code(int col) const { return dictionaries[col].code(slot); }
+
+    uint64_t location() const { return makeRowLocation(blockOffset, slot); }
+
+private:
+    TableData header;
+
+    void* file = nullptr;
+    void* mapping = nullptr;
+    const char* base = nullptr;
+    uint64_t size = 0;
+    bool ownsMapping = true;
+    uint64_t dataOffset = 0;
+
+    vector<ColType> types;
+    vector<size_t> widths;
+    vector<const char*> segments;
+    vector<uint32_t> encodings;
+    vector<DictionarySegment> dictionaries;
+    mutable vector<const char*> values;     // plain slots by slot, null until decoded
+    mutable vector<vector<char>> decodeBuffers;
+    vector<char> scratch;
+    const Filter* filter = nullptr;
+    vector<uint64_t> selection;
+
+    uint64_t blockOffset = 0;
+    uint64_t nextBlock = 0;
+    uint32_t blockLayout = 0;   // slots the block's segments are laid out for
+    const char* blockDead = nullptr;    // deleted-row bitmap, null if none are
+    uint32_t blockEnd = 0;
+    uint32_t slot = 0;
+    uint64_t endBlock = UINT64_MAX;
+    uint32_t rangeBegin = 0;
+    uint32_t rangeEnd = UINT32_MAX;
+    bool started = false;
+
+    bool enterBlock();
+    // The current row's slot of col.
+    const char* slotOf(int col) const
+    {
+        return values[col] ? values[col] + (size_t)slot * widths[col] : encodedSlot(col);
+    }
+    const char* encodedSlot(int col) const;
+    uint32_t nextSelected(uint32_t from) const;
+};
+
+#endif
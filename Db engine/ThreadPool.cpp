@@ -0,0 +1,143 @@
+#include "threadpool.h"
+using namespace std;
+
+unsigned defaultThreadCount()
+{
+    unsigned n = thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool()
+{
+    start(defaultThreadCount());
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+void ThreadPool::start(unsigned threads)
+{
+    if (threads == 0)
+        threads = 1;
+    stopping = false;
+    for (unsigned i = 0; i < threads; i++)
+        queues.push_back(make_unique<Queue>());
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, (size_t)i);
+}
+
+void ThreadPool::stop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers)
+        t.join();
+    workers.clear();
+    queues.clear();
+}
+
+void ThreadPool::resize(unsigned threads)
+{
+    if (threads == size())
+        return;
+    stop();
+    start(threads);
+}
+
+bool ThreadPool::takeTask(size_t self, size_t& task)
+{
+    {
+        Queue& own = *queues[self];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        Queue& victim = *queues[(self + i) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::runTasks(size_t self)
+{
+    size_t task;
+    while (takeTask(self, task))
+    {
+        (*job)(task);
+        if (remaining.fetch_sub(1) == 1) {
+            lock_guard<mutex> guard(lock);
+            finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop(size_t self)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        runTasks(self);
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& task)
+{
+    if (count == 0)
+        return;
+    if (size() == 1 || count == 1) {
+        for (size_t i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+
+    {
+        lock_guard<mutex> guard(lock);
+        job = &task;
+        remaining = count;
+        // Tasks are dealt in contiguous runs, so neighbouring morsels tend to
+        // stay on one thread until stealing evens the load out.
+        size_t per = (count + size() - 1) / size();
+        for (size_t i = 0; i < count; i++)
+        {
+            Queue& q = *queues[i / per];
+            lock_guard<mutex> qguard(q.lock);
+            q.tasks.push_front(i);
+        }
+        generation++;
+    }
+    wake.notify_all();
+
+    runTasks(0);
+
+    unique_lock<mutex> guard(lock);
+    finished.wait(guard, [&]() { return remaining == 0; });
+    job = nullptr;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+using namespace std;
+
+// Work-stealing pool shared by the whole engine. parallelFor splits the task
+// indices into one contiguous run per thread and queues each run on that
+// thread's deque; each thread works through its own run in order and, once
+// that is empty, steals from the far end of the others. The calling thread
+// works too, so a pool of size n runs n-1 background threads.
+
+class ThreadPool
+{
+public:
+    static ThreadPool& instance();
+    ~ThreadPool();
+
+    unsigned size() const { return (unsigned)queues.size(); }
+    void resize(unsigned threads);
+
+    // Runs task(i) for i in [0, count) and returns when all have finished.
+    // Not reentrant: tasks must not call parallelFor themselves.
+    void parallelFor(size_t count, const function<void(size_t)>& task);
+
+private:
+    struct Queue
+    {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues;
+    vector<thread> workers;
+
+    mutex lock;
+    condition_variable wake;
+    condition_variable finished;
+    const function<void(size_t)>* job = nullptr;
+    atomic<size_t> remaining{ 0 };
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    ThreadPool();
+    void start(unsigned threads);
+    void stop();
+    bool takeTask(size_t self, size_t& task);
+    void runTasks(size_t self);
+    void workerLoop(size_t self);
+};
+
+unsigned defaultThreadCount();
+
+#endif
@@ -6,262 +6,196 @@
 #include <algorithm>
 #include "update.h"
 #include "utils.h"
+#include "storage.h"
+#include "index.h"
+#include "tablescanner.h"
+#include "parallelscan.h"
+#include "filter.h"
+#include "writeaheadlog.h"
 using namespace std;
 
-UpdateQuery parseUpdateQuery(const string& query)
+bool planUpdate(const UpdateQuery& uq, UpdatePlan& plan)
 {
-    UpdateQuery uq;
-    uq.hasWhere = false;
-
-    string cmd = query;
-    if (!cmd.empty() && cmd.back() == ';')
-        cmd.pop_back();
-
-    string upper = cmd;
-    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-    upper = trim_Middle(upper);
-    size_t updatePos = upper.find("UPDATE");
-    size_t setPos = upper.find("SET");
-
-    if (updatePos == string::npos || setPos == string::npos)
+    plan = UpdatePlan();
+    plan.tableName = uq.tableName;
+    if (!tableExists(uq.tableName))
     {
         setColor(12);
-        cout << "Error: Invalid UPDATE syntax.\n";
+        cout << "Error: Table doesn't exists.\n";
         setColor(15);
-        return uq;
+        return false;
     }
 
-    uq.tableName = trim(cmd.substr(updatePos + 6, setPos - updatePos - 6));
-
-    size_t wherePos = upper.find("WHERE");
-    size_t setEnd = (wherePos != string::npos) ? wherePos : cmd.length();
-
-    string setClause = trim(cmd.substr(setPos + 3, setEnd - setPos - 3));
-
-    vector<string> assignments = split(setClause, ',');
+    TableData& table = plan.table;
 
-    for (const string& assignment : assignments)
+    if (!readTableSchema(uq.tableName, table) || table.columns.empty())
     {
-        size_t eqPos = assignment.find('=');
-        if (eqPos == string::npos)
-        {
-            setColor(12);
-            cout << "Error: Invalid SET clause.\n";
-            setColor(15);
-            return uq;
-        }
-
-        string colName = trim(assignment.substr(0, eqPos));
-        string colValue = trim(assignment.substr(eqPos + 1));
-
-        if (colValue.size() >= 2 && colValue.front() == '\'' && colValue.back() == '\'')
-            colValue = colValue.substr(1, colValue.length() - 2);
-
-        uq.setValues[colName] = colValue;
+        setColor(12);
+        cout << "Error: Cannot read table structure.\n";
+        setColor(15);
+        return false;
     }
 
-    if (wherePos != string::npos)
+    if (table.primaryKeyIndex != -1)
     {
-        uq.hasWhere = true;
-        string whereClause = trim(cmd.substr(wherePos + 5));
-
-        size_t opPos = string::npos;
-        string ops[] = { ">=", "<=", "!=", "=", ">", "<" };
-
-        for (const string& op : ops)
+        for (const auto& pair : uq.setValues)
         {
-            opPos = whereClause.find(op);
-            if (opPos != string::npos)
+            if (getColumnIndex(table, pair.first) == table.primaryKeyIndex)
             {
-                uq.whereOperator = op;
-                break;
+                setColor(12);
+                cout << "Error: Cannot update PRIMARY KEY column '" << table.columns[table.primaryKeyIndex] << "'.\n";
+                setColor(15);
+                return false;
             }
         }
+    }
 
-        if (opPos == string::npos)
+    for (const auto& pair : uq.setValues)
+    {
+        int col = getColumnIndex(table, pair.first);
+        if (col == -1)
         {
             setColor(12);
-            cout << "Error: Invalid WHERE clause.\n";
+            cout << "Error: Column '" << pair.first << "' does not exist.\n";
             setColor(15);
-            uq.hasWhere = false;
-            return uq;
+            return false;
         }
-
-        uq.whereColumn = trim(whereClause.substr(0, opPos));
-        uq.whereValue = trim(whereClause.substr(opPos + uq.whereOperator.length()));
-
-        if (uq.whereValue.size() >= 2 && uq.whereValue.front() == '\'' && uq.whereValue.back() == '\'')
-            uq.whereValue = uq.whereValue.substr(1, uq.whereValue.length() - 2);
+        plan.sets.push_back({ col, pair.first, pair.second });
     }
 
-    return uq;
+    string err;
+    plan.hasWhere = uq.hasWhere;
+    if (uq.hasWhere && !planWhere(uq.tableName, table, uq.where, plan.where, err))
+    {
+        setColor(12);
+        cout << "Error: " << err << " in WHERE clause.\n";
+        setColor(15);
+        return false;
+    }
+    return true;
 }
 
-bool evaluateCondition(const string& cellValue, const string& op, const string& targetValue)
+// Checks a SET value against its column and puts it into its stored form.
+static bool checkSetValue(const TableData& table, const SetColumn& set, string& stored)
 {
-    if (op == "=")
-        return cellValue == targetValue;
-    else if (op == "!=")
-        return cellValue != targetValue;
-    else if (op == ">")
+    int colIdx = set.column;
+    if (colIdx < (int)table.notNull.size() && table.notNull[colIdx])
     {
-        try { return stod(cellValue) > stod(targetValue); }
-        catch (...) { return false; }
-    }
-    else if (op == "<")
-    {
-        try { return stod(cellValue) < stod(targetValue); }
-        catch (...) { return false; }
+        if (isNullValue(trim(set.value)))
+        {
+            setColor(12);
+            cout << "Error: Column '" << set.name << "' cannot be set to NULL.\n";
+            setColor(15);
+            return false;
+        }
     }
-    else if (op == ">=")
+
+    if (colIdx < (int)table.lengths.size() && table.lengths[colIdx] != -1)
     {
-        try { return stod(cellValue) >= stod(targetValue); }
-        catch (...) { return false; }
+        if ((int)set.value.length() > table.lengths[colIdx])
+        {
+            setColor(12);
+            cout << "Error: Value '" << set.value << "' exceeds maximum length "
+                << table.lengths[colIdx] << " for column '" << set.name << "'.\n";
+            setColor(15);
+            return false;
+        }
     }
-    else if (op == "<=")
+
+    string err;
+    if (!validateValue(table.types[colIdx], table.lengths[colIdx], set.value, err))
     {
-        try { return stod(cellValue) <= stod(targetValue); }
-        catch (...) { return false; }
+        setColor(12);
+        cout << "Error: " << err << " for column '" << set.name << "'.\n";
+        setColor(15);
+        return false;
     }
 
-    return false;
+    stored = canonicalValue(table.types[colIdx], set.value);
+    return true;
 }
 
-bool executeUpdate(const UpdateQuery& uq)
+bool runUpdate(UpdatePlan& plan)
 {
-    ifstream check(uq.tableName + ".csv");
-    if (!check.good())
+    const TableData& table = plan.table;
+    WhereClause& where = plan.where;
+    string err;
+    if (plan.hasWhere && !bindWhere(table, where, err))
     {
         setColor(12);
-        cout << "Error: Table doesn't exists.\n";
+        cout << "Error: " << err << " in WHERE clause.\n";
         setColor(15);
         return false;
     }
 
-    TableData table = readTable(uq.tableName);
+    // Matching rows are found through an index or a scan of the mapped file,
+    // then read, changed and written back in place.
+    vector<uint64_t> locations;
+    vector<vector<string>> rows;
+    bool indexed = plan.hasWhere
+        && fetchWhereRows(plan.tableName, table, where, locations, rows);
 
-    if (table.columns.empty())
-        return false;
-
-    unordered_map<string, int> colIndex;
-    for (size_t i = 0; i < table.columns.size(); i++)
-    {
-        string upperCol = table.columns[i];
-        transform(upperCol.begin(), upperCol.end(), upperCol.begin(), ::toupper);
-        colIndex[upperCol] = i;
-    }
-
-    if (table.primaryKeyIndex != -1)
+    if (!indexed)
     {
-        string pkColName = table.columns[table.primaryKeyIndex];
-        string upperPK = pkColName;
-        transform(upperPK.begin(), upperPK.end(), upperPK.begin(), ::toupper);
-
-        for (const auto& pair : uq.setValues)
-        {
-            string upperSetCol = pair.first;
-            transform(upperSetCol.begin(), upperSetCol.end(), upperSetCol.begin(), ::toupper);
-
-            if (upperSetCol == upperPK)
-            {
-                setColor(12);
-                cout << "Error: Cannot update PRIMARY KEY column '" << pkColName << "'.\n";
-                setColor(15);
-                return false;
-            }
-        }
-    }
-
-    for (const auto& pair : uq.setValues)
-    {
-        string upperSetCol = pair.first;
-        transform(upperSetCol.begin(), upperSetCol.end(), upperSetCol.begin(), ::toupper);
-
-        if (colIndex.find(upperSetCol) == colIndex.end())
+        TableScanner scan;
+        if (!scan.open(plan.tableName))
+            return false;
+        vector<vector<uint64_t>> found(scan.morsels(SCAN_MORSEL_ROWS).size());
+        parallelScan(scan, plan.hasWhere ? &where.filter : nullptr,
+            [&](TableScanner& cursor, size_t m) {
+                while (cursor.next())
+                    found[m].push_back(cursor.location());
+            },
+            [&](size_t m) {
+                locations.insert(locations.end(), found[m].begin(), found[m].end());
+                vector<uint64_t>().swap(found[m]);
+            });
+        scan.close();
+
+        if (!readRowsAt(plan.tableName, table, locations, rows))
         {
             setColor(12);
-            cout << "Error: Column '" << pair.first << "' does not exist.\n";
+            cout << "Error: Cannot read rows of table '" << plan.tableName << "'.\n";
             setColor(15);
             return false;
         }
     }
+    vector<vector<string>> before = rows;
 
-    int whereColIndex = -1;
-    if (uq.hasWhere)
-    {
-        whereColIndex = getColumnIndex(table, uq.whereColumn);
-        if (whereColIndex == -1)
-        {
-            setColor(12);
-            cout << "Error: WHERE column '" << uq.whereColumn << "' not found.\n";
-            setColor(15);
+    // Each value is checked once, and only when some row is to change.
+    vector<string> stored(plan.sets.size());
+    for (size_t i = 0; i < plan.sets.size() && !rows.empty(); i++)
+        if (!checkSetValue(table, plan.sets[i], stored[i]))
             return false;
-        }
-    }
 
     int updatedCount = 0;
 
-    for (auto& row : table.rows)
+    for (auto& row : rows)
     {
-        bool shouldUpdate = true;
-
-        if (uq.hasWhere)
-        {
-            if (whereColIndex >= (int)row.size())
-            {
-                shouldUpdate = false;
-            }
-            else
-            {
-                shouldUpdate = evaluateCondition(
-                    row[whereColIndex],
-                    uq.whereOperator,
-                    uq.whereValue);
-            }
-        }
-
-        if (shouldUpdate)
-        {
-            for (const auto& pair : uq.setValues)
-            {
-                string upperSetCol = pair.first;
-                transform(upperSetCol.begin(), upperSetCol.end(), upperSetCol.begin(), ::toupper);
-
-                int colIdx = colIndex[upperSetCol];
-                if (colIdx < (int)row.size())
-                {
-                    if (colIdx < (int)table.notNull.size() && table.notNull[colIdx])
-                    {
-                        if (trim(pair.second).empty())
-                        {
-                            setColor(12);
-                            cout << "Error: Column '" << pair.first << "' cannot be set to NULL.\n";
-                            setColor(15);
-                            return false;
-                        }
-                    }
-
-                    if (colIdx < (int)table.lengths.size() && table.lengths[colIdx] != -1)
-                    {
-                        if ((int)pair.second.length() > table.lengths[colIdx])
-                        {
-                            setColor(12);
-                            cout << "Error: Value '" << pair.second << "' exceeds maximum length "
-                                << table.lengths[colIdx] << " for column '" << pair.first << "'.\n";
-                            setColor(15);
-                            return false;
-                        }
-                    }
-
-                    row[colIdx] = pair.second;
-                }
-            }
-            updatedCount++;
-        }
+        for (size_t i = 0; i < plan.sets.size(); i++)
+            if (plan.sets[i].column < (int)row.size())
+                row[plan.sets[i].column] = stored[i];
+        updatedCount++;
     }
 
-    if (!writeTable(uq.tableName, table))
+    // The primary key cannot change, so row locations stay valid and only
+    // secondary indexes on changed columns need new entries, unless the
+    // table had to be rewritten, which rebuilt them all.
+    if (!walLogUpdate(plan.tableName, locations, rows))
         return false;
+    bool rewritten;
+    if (!writeRowsAt(plan.tableName, table, locations, rows, &rewritten))
+        return false;
+    bool durable = stampTableLsn(plan.tableName, walLastLsn());
+    if (!rewritten)
+        indexUpdatedRows(plan.tableName, table, locations, before, rows);
+    if (!durable)
+    {
+        setColor(12);
+        cout << "Error: Cannot force table '" << plan.tableName << "' to disk.\n";
+        setColor(15);
+        return false;
+    }
 
     setColor(10);
     cout << updatedCount << " row(s) updated successfully.\n";
@@ -270,6 +204,12 @@ bool executeUpdate(const UpdateQuery& uq)
     return true;
 }
 
+bool executeUpdate(const UpdateQuery& uq)
+{
+    UpdatePlan plan;
+    return planUpdate(uq, plan) && runUpdate(plan);
+}
+
 int getColumnIndex(const TableData& table, const string& columnName)
 {
     string upperCol = columnName;
@@ -285,13 +225,3 @@ int getColumnIndex(const TableData& table, const string& columnName)
     }
     return -1;
 }
-
-void handleUpdate(const string& query)
-{
-    UpdateQuery uq = parseUpdateQuery(query);
-
-    if (uq.tableName.empty())
-        return;
-
-    executeUpdate(uq);
-}
\ No newline at end of file
@@ -4,23 +4,30 @@
 #include <string>
 #include <unordered_map>
 #include "utils.h"
+#include "parser.h"
+#include "filter.h"
 
+struct SetColumn
+{
+    int column;
+    string name;        // as written in the statement
+    string value;
+};
 
-struct UpdateQuery
+// An UPDATE with its table, columns, condition and index access resolved,
+// so it can run again with other values (see Prepare.h).
+struct UpdatePlan
 {
     string tableName;
-    unordered_map<string, string> setValues;
-    string whereColumn;
-    string whereOperator;
-    string whereValue;
-    bool hasWhere;
+    TableData table;
+    vector<SetColumn> sets;
+    bool hasWhere = false;
+    WhereClause where;
 };
 
-// Main handler
-UpdateQuery parseUpdateQuery(const string& query);
-bool evaluateCondition(const string& cellValue, const string& op, const string& targetValue);
+bool planUpdate(const UpdateQuery& uq, UpdatePlan& plan);
+bool runUpdate(UpdatePlan& plan);
 bool executeUpdate(const UpdateQuery& uq);
-void handleUpdate(const string& query);
 int getColumnIndex(const TableData& table, const string& columnName);
 
 #endif
\ No newline at end of file
@@ -2,9 +2,13 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
+#include <cstring>
 #include <Windows.h>
 #include <sstream>
 #include "utils.h"
+#include "storage.h"
+#include "index.h"
+#include "writeaheadlog.h"
 using namespace std;
 
 
@@ -59,99 +63,101 @@ vector<string> split( string s, char delimiter)
     return tokens;
 }
 
-TableData readTable(string tableName)
+string tableFile(string tableName)
 {
-    TableData t;
-    ifstream f(tableName + ".csv");
-    if (!f.good()) {
-        setColor(12); cout << "Error: Table not found.\n"; setColor(15);
-        return t;
-    }
+    return tableName + ".tbl";
+}
 
-    string line;
-    if (!getline(f, line)) return t;
-
-	vector<string> colDefs = split(line, ',');//ID:INT:PK , NAME:VARCHAR(50):NN ,   AGE:INT 
-    t.primaryKeyIndex = -1;
-    for (int i = 0; i <(int) colDefs.size(); ++i) {
-        string d = trim(colDefs[i]);
-
-        vector<string> parts = split(d, ':');
-        if (parts.size() < 2) continue;
-        string name = trim(parts[0]);
-        string typeDef = trim(parts[1]);
-
-        string baseType = typeDef;
-        int length = -1;
-        size_t p = typeDef.find('(');
-        if (p != string::npos) {
-            size_t q = typeDef.find(')', p);
-            if (q != string::npos) {
-                baseType = typeDef.substr(0, p);
-                string lenStr = typeDef.substr(p + 1, q - p - 1);
-                try { length = stoi(lenStr); }
-                catch (...) { length = -1; }
-            }
-        }
-        for (auto& ch : baseType) ch = toupper(ch);
-
-        bool isNN = false;
-        bool isPK = false;
-        for (size_t k = 2; k < parts.size(); ++k) {
-            string tok = parts[k];
-            string up = tok; transform(up.begin(), up.end(), up.begin(), ::toupper);
-            if (up == "NN" || up == "NOTNULL" || up == "NOT NULL") isNN = true;
-            if (up == "PK" || up == "PRIMARY" || up == "PRIMARYKEY" || up == "PRIMARY KEY") isPK = true;
-            if (up == "PK") isPK = true;
-            if (up == "NN") isNN = true;
-        }
-        t.columns.push_back(name);
-        t.types.push_back(baseType);
-        t.lengths.push_back(length);
-        t.notNull.push_back(isNN);
-        if (isPK) t.primaryKeyIndex = (int)i;
+bool tableExists(string tableName)
+{
+    ifstream check(tableFile(tableName));
+    return check.good();
+}
+
+void reportMissingTable(string tableName)
+{
+    ifstream legacy(tableName + ".csv");
+    setColor(12);
+    if (legacy.good())
+        cout << "Error: Table '" << tableName << "' is stored as CSV. Run CONVERT TABLE " << tableName << " first.\n";
+    else
+        cout << "Error: Table not found.\n";
+    setColor(15);
+}
+
+bool loadTable(string tableName, TableData& t, vector<uint64_t>* locations)
+{
+    ifstream f(tableFile(tableName), ios::binary);
+    if (!f.good()) {
+        reportMissingTable(tableName);
+        return false;
     }
 
+    f.seekg(0, ios::end);
+    string buf((size_t)f.tellg(), '\0');
+    f.seekg(0, ios::beg);
+    f.read(&buf[0], buf.size());
 
-    while (getline(f, line)) {
-        if (trim(line).empty()) continue;
-        vector<string> vals = split(line, ',');
-        for (auto& v : vals) v = trim(v);
-        t.rows.push_back(vals);
+    string err;
+    if (!decodeTable(buf.data(), buf.size(), t, err, locations)) {
+        setColor(12); cout << "Error: Table '" << tableName << "' is corrupt (" << err << ").\n"; setColor(15);
+        t = TableData();
+        return false;
     }
-    return t;
+    return true;
 }
 
-bool writeTable(string tableName, TableData data)
+bool saveTable(string tableName, const TableData& data)
 {
-    ofstream f(tableName + ".csv", ios::trunc);
+    string buf, err;
+    vector<uint64_t> blockOffsets;
+    if (!encodeTable(data, buf, err, &blockOffsets)) {
+        setColor(12); cout << "Error: Cannot write to table '" << tableName << "': " << err << ".\n"; setColor(15);
+        return false;
+    }
+    // The file will reflect every change logged so far.
+    uint64_t lsn = max(data.walLsn, walLastLsn());
+    memcpy(&buf[TBL_LSN_OFFSET], &lsn, 8);
+
+    // Write a temporary file and rename it over the table, so a crash
+    // leaves either the old or the new version, never a torn one.
+    string path = tableFile(tableName);
+    string temp = path + ".tmp";
+    ofstream f(temp, ios::binary | ios::trunc);
     if (!f.is_open()) {
         setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
         return false;
     }
-
-
-    for (int i = 0; i <(int) data.columns.size(); ++i) {
-        f << data.columns[i] << ":" << data.types[i];
-        if (data.lengths.size() > i && data.lengths[i] != -1) {
-            f << "(" << data.lengths[i] << ")";
-        }
-
-        if (data.primaryKeyIndex == (int)i) f << ":PK";
-        if (data.notNull.size() > i && data.notNull[i]) f << ":NN";
-        if (i + 1 < data.columns.size()) f << ",";
+    f.write(buf.data(), buf.size());
+    f.flush();
+    bool written = f.good();
+    f.close();
+    if (!written || !syncFile(temp) || !replaceFile(temp, path)) {
+        remove(temp.c_str());
+        setColor(12); cout << "Error: Cannot write to table '" << tableName << "'.\n"; setColor(15);
+        return false;
     }
-    f << "\n";
 
+    // Every row may have moved, so the table's indexes are rebuilt from scratch.
+    vector<uint64_t> locations;
+    locations.reserve(data.rows.size());
+    for (size_t r = 0; r < data.rows.size(); r++)
+        locations.push_back(makeRowLocation(blockOffsets[r / TBL_BLOCK_ROWS], (uint32_t)(r % TBL_BLOCK_ROWS)));
+    return rebuildTableIndexes(tableName, data, locations);
+}
 
-    for (auto& row : data.rows) {
-        for (int j = 0; j < row.size(); ++j) {
-            f << trim(row[j]);
-            if (j + 1 < row.size()) f << ",";
-        }
-        f << "\n";
-    }
-    f.flush();
-    f.close();
-    return true;
-}
\ No newline at end of file
+bool syncFile(string path)
+{
+    HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = FlushFileBuffers(h) != 0;
+    CloseHandle(h);
+    return ok;
+}
+
+bool replaceFile(string from, string to)
+{
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
@@ -5,6 +5,7 @@
 #include <string>
 #include <fstream>
 #include <vector> 
+#include <cstdint>
 using namespace std;
 
 struct Column
@@ -45,6 +46,7 @@ struct TableData {
     vector<int> lengths;
     vector<bool> notNull;
     int primaryKeyIndex = -1;
+    uint64_t walLsn = 0;    // last write-ahead log record reflected in the file
     vector<vector<string>> rows;
 };
 
@@ -57,8 +59,21 @@ void toUpper(string& s);
 
 vector<string> split(string s, char delimiter);
 
-TableData readTable(string tableName);
+string tableFile(string tableName);
 
-bool writeTable(string tableName, TableData data);
+bool tableExists(string tableName);
+
+void reportMissingTable(string tableName);
+
+// With locations, also gives every row's location in the file.
+bool loadTable(string tableName, TableData& t, vector<uint64_t>* locations = nullptr);
+
+bool saveTable(string tableName, const TableData& data);
+
+// Durability helpers: syncFile forces a file's data to disk, replaceFile
+// atomically renames a fully written temporary file over its target.
+bool syncFile(string path);
+
+bool replaceFile(string from, string to);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include "vacuum.h"
+#include "storage.h"
+#include "utils.h"
+using namespace std;
+
+static map<string, string> touchedTables;     // upper-cased name -> name
+static unsigned thresholdPercent = VACUUM_DEFAULT_THRESHOLD;
+
+static bool countDeadRows(string tableName, uint64_t& rows, uint64_t& dead)
+{
+    TableData schema;
+    vector<TableBlock> blocks;
+    if (!readTableSchema(tableName, schema) || !readBlockDirectory(tableName, schema, blocks))
+        return false;
+    rows = dead = 0;
+    for (auto& b : blocks)
+    {
+        rows += b.rowCount;
+        dead += b.deadRows;
+    }
+    return true;
+}
+
+bool vacuumTable(string tableName, uint64_t* reclaimed)
+{
+    // Loading skips the deleted rows and saving packs the rest into full
+    // blocks.
+    uint64_t rows, dead;
+    TableData t;
+    if (!countDeadRows(tableName, rows, dead) || !loadTable(tableName, t))
+        return false;
+    if (!saveTable(tableName, t))
+        return false;
+
+    string key = tableName;
+    toUpper(key);
+    touchedTables.erase(key);
+    if (reclaimed)
+        *reclaimed = dead;
+    return true;
+}
+
+void noteDeletedRows(string tableName)
+{
+    string key = tableName;
+    toUpper(key);
+    touchedTables[key] = tableName;
+}
+
+bool compactSparseTables()
+{
+    map<string, string> pending;
+    pending.swap(touchedTables);
+    if (thresholdPercent == 0)
+        return true;
+
+    bool ok = true;
+    for (auto& kv : pending)
+    {
+        uint64_t rows, dead;
+        if (!tableExists(kv.second) || !countDeadRows(kv.second, rows, dead))
+            continue;
+        if (dead > 0 && dead * 100 >= rows * thresholdPercent)
+            ok = vacuumTable(kv.second) && ok;
+    }
+    return ok;
+}
+
+unsigned vacuumThreshold()
+{
+    return thresholdPercent;
+}
+
+void setVacuumThreshold(unsigned percent)
+{
+    thresholdPercent = percent;
+}
+
+bool executeVacuum(const VacuumQuery& q)
+{
+    const string& tableName = q.tableName;
+    if (!tableExists(tableName)) {
+        reportMissingTable(tableName);
+        return false;
+    }
+
+    uint64_t reclaimed = 0;
+    if (!vacuumTable(tableName, &reclaimed)) {
+        setColor(12); cout << "Error: Cannot vacuum table '" << tableName << "'.\n"; setColor(15);
+        return false;
+    }
+    setColor(10);
+    cout << "Table '" << tableName << "' vacuumed: " << reclaimed << " deleted row(s) reclaimed.\n";
+    setColor(15);
+    return true;
+}
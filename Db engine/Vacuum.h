@@ -0,0 +1,29 @@
+#pragma once
+#ifndef VACUUM_H
+#define VACUUM_H
+#include <string>
+#include <cstdint>
+#include "parser.h"
+using namespace std;
+
+// DELETE leaves its rows in the table file, marked in each block's
+// deleted-row bitmap (see Storage.h). VACUUM table_name rewrites the table
+// without them, packs its blocks and rebuilds its indexes.
+//
+// Tables DELETE touched are also compacted automatically between statements
+// once their deleted rows reach the VACUUM_THRESHOLD percentage of the rows
+// in the file, so purging a few rows costs only those rows and the rewrite is
+// paid once per that many deletions.
+
+const unsigned VACUUM_DEFAULT_THRESHOLD = 50;
+
+bool vacuumTable(string tableName, uint64_t* reclaimed = nullptr);
+void noteDeletedRows(string tableName);
+bool compactSparseTables();
+
+unsigned vacuumThreshold();
+void setVacuumThreshold(unsigned percent);
+
+bool executeVacuum(const VacuumQuery& q);
+
+#endif
@@ -0,0 +1,547 @@
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <filesystem>
+#include <system_error>
+#include <cstring>
+#include <Windows.h>
+#include "writeaheadlog.h"
+#include "hashindex.h"
+#include "storage.h"
+#include "utils.h"
+using namespace std;
+
+struct LogRecord
+{
+    uint64_t lsn = 0;
+    uint8_t type = 0;
+    string tableName;
+    uint64_t tableBytes = 0;
+    uint32_t tailRows = 0;
+    bool allRows = false;
+    vector<uint64_t> positions;     // UPDATE or DELETE row locations
+    vector<vector<string>> rows;
+};
+
+static HANDLE logFile = INVALID_HANDLE_VALUE;
+static uint64_t logBytes = 0;           // end of the last record
+static uint64_t lastLsn = 0;
+static set<string> unsyncedTables;      // written in place since the last checkpoint
+static WalSyncMode syncMode = WAL_SYNC_FULL;
+static bool deferCommits = false;       // batch mode: forced at COMMIT instead
+
+// Group commit: each commit asks the flusher thread to force the log up to its
+// LSN and waits until a flush covering it has finished, so commits waiting at
+// the same time share one flush.
+static thread flusher;
+static mutex syncLock;
+static condition_variable syncWake;     // the flusher: a commit is waiting
+static condition_variable syncDone;     // the commits: a flush finished
+static uint64_t syncRequested = 0;      // highest LSN waiting for a flush
+static uint64_t syncedLsn = 0;          // highest LSN forced to disk
+static uint64_t syncFailedLsn = 0;      // highest LSN whose flush failed
+static unsigned syncWaiters = 0;
+static bool flusherStopping = false;
+static unsigned groupMs = WAL_GROUP_DEFAULT_MS;
+
+static void putU8(string& out, uint8_t v) { out.push_back((char)v); }
+static void putU32(string& out, uint32_t v) { out.append((const char*)&v, sizeof v); }
+static void putU64(string& out, uint64_t v) { out.append((const char*)&v, sizeof v); }
+static void putString(string& out, const string& s)
+{
+    putU32(out, (uint32_t)s.size());
+    out += s;
+}
+static void putRow(string& out, const vector<string>& row)
+{
+    putU32(out, (uint32_t)row.size());
+    for (auto& v : row)
+        putString(out, v);
+}
+
+// Bounds-checked reader over one record payload.
+struct PayloadReader
+{
+    const char* at;
+    size_t left;
+    bool ok = true;
+
+    bool take(void* out, size_t n)
+    {
+        if (!ok || n > left)
+            return ok = false;
+        memcpy(out, at, n);
+        at += n;
+        left -= n;
+        return true;
+    }
+    uint32_t u32() { uint32_t v = 0; take(&v, 4); return v; }
+    uint64_t u64() { uint64_t v = 0; take(&v, 8); return v; }
+    string str()
+    {
+        uint32_t n = u32();
+        if (!ok || n > left) {
+            ok = false;
+            return string();
+        }
+        string s(at, n);
+        at += n;
+        left -= n;
+        return s;
+    }
+    vector<string> row()
+    {
+        uint32_t n = u32();
+        vector<string> r;
+        for (uint32_t i = 0; i < n && ok; i++)
+            r.push_back(str());
+        return r;
+    }
+};
+
+static uint32_t recordChecksum(const char* body, size_t size)
+{
+    return (uint32_t)hashValue(string(body, size));
+}
+
+static bool writeAt(HANDLE h, const char* data, size_t size, uint64_t at)
+{
+    LARGE_INTEGER pos;
+    pos.QuadPart = (long long)at;
+    if (!SetFilePointerEx(h, pos, nullptr, FILE_BEGIN))
+        return false;
+    while (size > 0)
+    {
+        DWORD done = 0;
+        DWORD chunk = (DWORD)min<size_t>(size, 1u << 30);
+        if (!WriteFile(h, data, chunk, &done, nullptr) || done == 0)
+            return false;
+        data += done;
+        size -= done;
+    }
+    return true;
+}
+
+static bool resetLog()
+{
+    string header(WAL_MAGIC, 4);
+    putU32(header, WAL_VERSION);
+    putU64(header, lastLsn);
+
+    LARGE_INTEGER end;
+    end.QuadPart = (long long)WAL_HEADER_SIZE;
+    if (!writeAt(logFile, header.data(), header.size(), 0)
+        || !SetFilePointerEx(logFile, end, nullptr, FILE_BEGIN) || !SetEndOfFile(logFile)
+        || !FlushFileBuffers(logFile))
+        return false;
+    logBytes = WAL_HEADER_SIZE;
+    return true;
+}
+
+static void flusherLoop()
+{
+    unique_lock<mutex> guard(syncLock);
+    while (true)
+    {
+        syncWake.wait(guard, []() { return flusherStopping || syncRequested > max(syncedLsn, syncFailedLsn); });
+        if (flusherStopping)
+            return;
+        // With several commits waiting, let the group fill up for one
+        // interval, then force it to disk in one go.
+        if (syncWaiters > 1)
+            syncWake.wait_for(guard, chrono::milliseconds(groupMs), []() { return flusherStopping; });
+        uint64_t target = syncRequested;
+        guard.unlock();
+        bool ok = FlushFileBuffers(logFile) != 0;
+        guard.lock();
+        if (ok)
+            syncedLsn = max(syncedLsn, target);
+        else
+            syncFailedLsn = max(syncFailedLsn, target);
+        syncDone.notify_all();
+    }
+}
+
+// Returns once the record with this LSN is as durable as the sync mode asks.
+static bool commitLog(uint64_t lsn)
+{
+    if (deferCommits)
+        return true;
+    if (syncMode == WAL_SYNC_FULL)
+        return FlushFileBuffers(logFile) != 0;
+    if (syncMode == WAL_SYNC_GROUP)
+    {
+        unique_lock<mutex> guard(syncLock);
+        if (!flusher.joinable()) {
+            flusherStopping = false;
+            flusher = thread(flusherLoop);
+        }
+        syncRequested = max(syncRequested, lsn);
+        syncWaiters++;
+        syncWake.notify_all();
+        syncDone.wait(guard, [lsn]() { return syncedLsn >= lsn || syncFailedLsn >= lsn; });
+        syncWaiters--;
+        return syncedLsn >= lsn;
+    }
+    return true;
+}
+
+static bool appendRecord(WalRecordType type, const string& tableName, const string& payload)
+{
+    string body;
+    putU64(body, lastLsn + 1);
+    putU8(body, type);
+    putString(body, tableName);
+    body += payload;
+
+    string record;
+    record.reserve(8 + body.size());
+    putU32(record, (uint32_t)(body.size() - (WAL_RECORD_HEADER_SIZE - 8)));
+    putU32(record, recordChecksum(body.data(), body.size()));
+    record += body;
+
+    if (logFile == INVALID_HANDLE_VALUE || !writeAt(logFile, record.data(), record.size(), logBytes)
+        || !commitLog(lastLsn + 1)) {
+        setColor(12); cout << "Error: Cannot write to the write-ahead log.\n"; setColor(15);
+        return false;
+    }
+    logBytes += record.size();
+    lastLsn++;
+    return true;
+}
+
+static bool readRecord(const string& log, size_t& at, LogRecord& rec)
+{
+    if (at + WAL_RECORD_HEADER_SIZE > log.size())
+        return false;
+    uint32_t payloadSize, checksum;
+    memcpy(&payloadSize, log.data() + at, 4);
+    memcpy(&checksum, log.data() + at + 4, 4);
+    if (payloadSize > log.size() - at - WAL_RECORD_HEADER_SIZE)
+        return false;
+    const char* body = log.data() + at + 8;
+    size_t bodySize = WAL_RECORD_HEADER_SIZE - 8 + payloadSize;
+    if (recordChecksum(body, bodySize) != checksum)
+        return false;
+
+    memcpy(&rec.lsn, body, 8);
+    rec.type = (uint8_t)body[8];
+    PayloadReader in{ body + 9, payloadSize };
+    rec.tableName = in.str();
+    if (rec.type == WAL_INSERT)
+    {
+        rec.tableBytes = in.u64();
+        rec.tailRows = in.u32();
+        uint32_t count = in.u32();
+        for (uint32_t i = 0; i < count && in.ok; i++)
+            rec.rows.push_back(in.row());
+    }
+    else if (rec.type == WAL_UPDATE)
+    {
+        uint32_t count = in.u32();
+        for (uint32_t i = 0; i < count && in.ok; i++) {
+            rec.positions.push_back(in.u64());
+            rec.rows.push_back(in.row());
+        }
+    }
+    else if (rec.type == WAL_DELETE)
+    {
+        uint8_t all = 0;
+        in.take(&all, 1);
+        rec.allRows = all != 0;
+        uint32_t count = in.u32();
+        for (uint32_t i = 0; i < count && in.ok; i++)
+            rec.positions.push_back(in.u64());
+    }
+    else
+        return false;
+
+    at += WAL_RECORD_HEADER_SIZE + payloadSize;
+    return in.ok;
+}
+
+// Returns 1 if the record was applied, 0 if its table already reflects it
+// (or no longer exists) and -1 on failure.
+static int replayRecord(const LogRecord& rec)
+{
+    TableData schema;
+    if (!readTableSchema(rec.tableName, schema) || rec.lsn <= schema.walLsn)
+        return 0;
+
+    if (rec.type == WAL_INSERT)
+    {
+        // Drop whatever part of the append made it to disk, then redo it.
+        error_code ec;
+        TableBlock tail;
+        if (tableFileSize(rec.tableName) < rec.tableBytes)
+            return -1;
+        filesystem::resize_file(tableFile(rec.tableName), rec.tableBytes, ec);
+        if (ec || !readTableTail(rec.tableName, schema, tail))
+            return -1;
+        if (tail.byteSize && !setBlockRowCount(rec.tableName, tail.offset, rec.tailRows))
+            return -1;
+        if (!appendTableRows(rec.tableName, schema, rec.rows))
+            return -1;
+    }
+    else if (rec.type == WAL_UPDATE)
+    {
+        if (!writeRowsAt(rec.tableName, schema, rec.positions, rec.rows))
+            return -1;
+    }
+    else if (rec.allRows)
+    {
+        schema.rows.clear();
+        return saveTable(rec.tableName, schema) ? 1 : -1;
+    }
+    else
+    {
+        if (!deleteRowsAt(rec.tableName, schema, rec.positions))
+            return -1;
+    }
+    return stampTableLsn(rec.tableName, rec.lsn) ? 1 : -1;
+}
+
+// Rewrites tables written in an older format in the current one, so every
+// table has room for an LSN and deleted-row bitmaps, and returns the newest
+// LSN found.
+static bool upgradeTables(uint64_t& highest)
+{
+    highest = 0;
+    error_code ec;
+    for (auto& entry : filesystem::directory_iterator(filesystem::current_path(), ec))
+    {
+        if (entry.path().extension() != ".tbl")
+            continue;
+        string name = entry.path().stem().string();
+        TableData t;
+        if (tableFileVersion(name) < TBL_VERSION && (!loadTable(name, t) || !saveTable(name, t)))
+            return false;
+        if (readTableSchema(name, t))
+            highest = max(highest, t.walLsn);
+    }
+    return true;
+}
+
+bool recoverDatabase()
+{
+    string log;
+    {
+        ifstream f(WAL_FILE, ios::binary);
+        if (f.good())
+            log.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+    }
+
+    uint64_t highest;
+    if (!upgradeTables(highest))
+        return false;
+
+    uint32_t version = 0;
+    if (log.size() >= WAL_HEADER_SIZE)
+        memcpy(&version, log.data() + 4, 4);
+    bool valid = log.size() >= WAL_HEADER_SIZE && memcmp(log.data(), WAL_MAGIC, 4) == 0 && version == WAL_VERSION;
+
+    int replayed = 0;
+    if (valid)
+    {
+        memcpy(&lastLsn, log.data() + 8, 8);
+
+        // Replay up to the first torn or corrupt record; nothing after it
+        // was ever reported as committed.
+        set<string> touched;
+        size_t at = WAL_HEADER_SIZE;
+        LogRecord rec;
+        while (readRecord(log, at, rec) && rec.lsn == lastLsn + 1)
+        {
+            lastLsn = rec.lsn;
+            touched.insert(rec.tableName);
+            int result = replayRecord(rec);
+            if (result < 0) {
+                setColor(12); cout << "Error: Cannot replay the write-ahead log for table '" << rec.tableName << "'.\n"; setColor(15);
+                return false;
+            }
+            replayed += result;
+            rec = LogRecord();
+        }
+
+        // Indexes are not logged; rebuild them for every table the log touched.
+        for (auto& name : touched)
+        {
+            TableData t;
+            if (tableExists(name) && (!loadTable(name, t) || !saveTable(name, t)))
+                return false;
+        }
+    }
+    else
+        lastLsn = highest; // without a usable log, continue after the newest table
+
+    logFile = CreateFileA(WAL_FILE, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (logFile == INVALID_HANDLE_VALUE || !resetLog()) {
+        setColor(12); cout << "Error: Cannot open the write-ahead log '" << WAL_FILE << "'.\n"; setColor(15);
+        return false;
+    }
+
+    if (replayed > 0) {
+        setColor(14); cout << "Recovered " << replayed << " change(s) from the write-ahead log.\n\n"; setColor(15);
+    }
+    return true;
+}
+
+void closeDatabase()
+{
+    {
+        lock_guard<mutex> guard(syncLock);
+        flusherStopping = true;
+    }
+    syncWake.notify_all();
+    if (flusher.joinable())
+        flusher.join();
+    if (logFile != INVALID_HANDLE_VALUE)
+        CloseHandle(logFile);
+    logFile = INVALID_HANDLE_VALUE;
+}
+
+uint64_t walLastLsn()
+{
+    return lastLsn;
+}
+
+bool walLogInsert(string tableName, uint64_t tableBytesBefore, uint32_t tailRowsBefore,
+    const vector<vector<string>>& rows)
+{
+    string payload;
+    putU64(payload, tableBytesBefore);
+    putU32(payload, tailRowsBefore);
+    putU32(payload, (uint32_t)rows.size());
+    for (auto& row : rows)
+        putRow(payload, row);
+    if (!appendRecord(WAL_INSERT, tableName, payload))
+        return false;
+    unsyncedTables.insert(tableName);
+    return true;
+}
+
+bool walLogUpdate(string tableName, const vector<uint64_t>& locations, const vector<vector<string>>& rows)
+{
+    string payload;
+    putU32(payload, (uint32_t)locations.size());
+    for (size_t k = 0; k < locations.size(); k++)
+    {
+        putU64(payload, locations[k]);
+        putRow(payload, rows[k]);
+    }
+    if (!appendRecord(WAL_UPDATE, tableName, payload))
+        return false;
+    unsyncedTables.insert(tableName);
+    return true;
+}
+
+bool walLogDelete(string tableName, const vector<uint64_t>& locations, bool allRows)
+{
+    string payload;
+    putU8(payload, allRows ? 1 : 0);
+    putU32(payload, allRows ? 0 : (uint32_t)locations.size());
+    if (!allRows)
+        for (uint64_t loc : locations)
+            putU64(payload, loc);
+    if (!appendRecord(WAL_DELETE, tableName, payload))
+        return false;
+    unsyncedTables.insert(tableName);
+    return true;
+}
+
+bool checkpointDatabase(int* written)
+{
+    int count = 0;
+    for (auto& name : unsyncedTables)
+    {
+        if (!tableExists(name))
+            continue;
+        if (!syncFile(tableFile(name)))
+            return false;
+        count++;
+    }
+    unsyncedTables.clear();
+    if (written)
+        *written = count;
+    return logFile == INVALID_HANDLE_VALUE || resetLog();
+}
+
+bool checkpointIfLogFull()
+{
+    return logBytes <= WAL_CHECKPOINT_BYTES || checkpointDatabase();
+}
+
+WalSyncMode walSyncMode()
+{
+    return syncMode;
+}
+
+void setWalSyncMode(WalSyncMode mode)
+{
+    // Commits still waiting for the group flush are forced now.
+    if (syncMode != WAL_SYNC_FULL && logFile != INVALID_HANDLE_VALUE)
+        FlushFileBuffers(logFile);
+    syncMode = mode;
+}
+
+void setWalDeferredCommits(bool deferred)
+{
+    if (deferCommits && !deferred && logFile != INVALID_HANDLE_VALUE)
+        FlushFileBuffers(logFile);
+    deferCommits = deferred;
+}
+
+const char* walSyncModeName(WalSyncMode mode)
+{
+    switch (mode)
+    {
+    case WAL_SYNC_FULL: return "FULL";
+    case WAL_SYNC_GROUP: return "GROUP";
+    default: return "OFF";
+    }
+}
+
+unsigned walGroupInterval()
+{
+    return groupMs;
+}
+
+void setWalGroupInterval(unsigned ms)
+{
+    lock_guard<mutex> guard(syncLock);
+    groupMs = ms;
+}
+
+bool executeCheckpoint()
+{
+    int written = 0;
+    if (!checkpointDatabase(&written)) {
+        setColor(12); cout << "Error: Some tables could not be written to disk.\n"; setColor(15);
+        return false;
+    }
+    setColor(10);
+    cout << "Checkpoint complete: " << written << " table(s) forced to disk.\n";
+    setColor(15);
+    return true;
+}
+
+bool executeCommit()
+{
+    // A checkpoint forces the tables to disk before it empties the log, which
+    // also covers the commits deferred since the last COMMIT.
+    if (!checkpointDatabase()) {
+        setColor(12); cout << "Error: Some tables could not be written to disk.\n"; setColor(15);
+        return false;
+    }
+    setColor(10);
+    cout << "Commit complete.\n";
+    setColor(15);
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+#include <string>
+#include <vector>
+#include <cstdint>
+using namespace std;
+
+// Write-ahead log (db.wal) shared by every table in the working directory.
+//
+//   header  : "ITWL", version, LSN of the last checkpoint
+//   records : payload size, checksum, LSN, type, then the table name and
+//               INSERT  table file size and row count of the last block
+//                       before the append, the new rows
+//               UPDATE  row locations and the rows written there
+//               DELETE  "every row" flag, locations of the deleted rows
+//
+// Statements log their change before touching a table. INSERT and UPDATE then
+// write the .tbl file in place, force it to disk, stamp the record's LSN into
+// the table header and force that too, so a stamped LSN never covers rows
+// that did not arrive. DELETE marks its rows deleted in place the same way;
+// deleting every row rewrites the table as an empty one. A checkpoint forces
+// every table written since the last one to disk and empties the log. It runs on CHECKPOINT, on exit and after any
+// statement that leaves the log larger than WAL_CHECKPOINT_BYTES.
+//
+// recoverDatabase replays, at startup, every record newer than the LSN in its
+// table's header, rebuilds the indexes of the tables involved and checkpoints.
+//
+// A commit reaches the disk according to the sync mode:
+//   FULL   forced to disk before the statement reports success
+//   GROUP  forced to disk by a background thread before the statement reports
+//          success; while several commits wait, those arriving within the
+//          group interval share one flush
+//   OFF    left to the operating system
+// In batch mode (see Batch.h) commits are deferred regardless of the sync
+// mode: nothing is forced to disk until COMMIT, which checkpoints.
+
+const char WAL_FILE[] = "db.wal";
+const char WAL_MAGIC[4] = { 'I', 'T', 'W', 'L' };
+const uint32_t WAL_VERSION = 3;
+const size_t WAL_HEADER_SIZE = 16;
+const size_t WAL_RECORD_HEADER_SIZE = 17;
+const uint64_t WAL_CHECKPOINT_BYTES = 64ull << 20;
+const unsigned WAL_GROUP_DEFAULT_MS = 10;
+
+enum WalRecordType : uint8_t
+{
+    WAL_INSERT = 1,
+    WAL_UPDATE = 2,
+    WAL_DELETE = 3
+};
+
+enum WalSyncMode
+{
+    WAL_SYNC_OFF,
+    WAL_SYNC_GROUP,
+    WAL_SYNC_FULL
+};
+
+bool recoverDatabase();
+void closeDatabase();
+
+uint64_t walLastLsn();
+bool walLogInsert(string tableName, uint64_t tableBytesBefore, uint32_t tailRowsBefore,
+    const vector<vector<string>>& rows);
+bool walLogUpdate(string tableName, const vector<uint64_t>& locations, const vector<vector<string>>& rows);
+bool walLogDelete(string tableName, const vector<uint64_t>& locations, bool allRows);
+
+bool checkpointDatabase(int* written = nullptr);
+bool checkpointIfLogFull();
+
+WalSyncMode walSyncMode();
+void setWalSyncMode(WalSyncMode mode);
+void setWalDeferredCommits(bool deferred);
+const char* walSyncModeName(WalSyncMode mode);
+unsigned walGroupInterval();
+void setWalGroupInterval(unsigned ms);
+
+bool executeCheckpoint();
+bool executeCommit();
+
+#endif